@@ -0,0 +1,59 @@
+// include/action_dispatcher.h
+#ifndef ACTION_DISPATCHER_H
+#define ACTION_DISPATCHER_H
+
+#include "action_manager.h"
+
+/*
+ * 异步动作分发器
+ *
+ * 目标处理动作按目标设备（设备类型，设备ID）归入串行队列（strand），
+ * 同一设备的动作按提交顺序逐个执行。有待执行动作的strand作为任务放入
+ * 工作线程的双端队列：所有者从底部取（后进先出），空闲线程从其他队列
+ * 顶部窃取（先进先出）。同一strand任一时刻只在一个线程上执行。
+ */
+
+// 分发器工作线程数上限
+#define ACTION_DISPATCHER_MAX_WORKERS 64
+
+// 目标处理动作执行函数
+typedef int (*action_execute_fn_t)(action_target_t* target, device_manager_t* dm);
+
+typedef struct action_dispatcher action_dispatcher_t;
+
+/**
+ * 创建分发器并启动工作线程
+ *
+ * @param worker_count 工作线程数（1..ACTION_DISPATCHER_MAX_WORKERS）
+ * @param execute 目标处理动作执行函数
+ * @return 分发器，失败返回NULL
+ */
+action_dispatcher_t* action_dispatcher_create(int worker_count, action_execute_fn_t execute);
+
+// 等待所有动作执行完成后停止工作线程并销毁分发器
+void action_dispatcher_destroy(action_dispatcher_t* dispatcher);
+
+/**
+ * 提交一个目标处理动作（复制target），成功返回0
+ *
+ * target->binding不复制：工作线程直接使用并更新提交者的绑定单元，
+ * 绑定单元必须在动作执行完成之前有效（见action_manager_flush）。
+ */
+int action_dispatcher_submit(action_dispatcher_t* dispatcher, const action_target_t* target, device_manager_t* dm);
+
+/**
+ * 等待已提交的动作（包括执行期间级联提交的动作）全部完成
+ *
+ * 不能在工作线程中调用。
+ *
+ * @return 成功返回0，在工作线程中调用返回-1
+ */
+int action_dispatcher_flush(action_dispatcher_t* dispatcher);
+
+// 当前的strand数：strand在队列清空后释放，所有动作完成后为0
+int action_dispatcher_strand_count(action_dispatcher_t* dispatcher);
+
+// 当前线程是否为分发器工作线程
+int action_dispatcher_in_worker(void);
+
+#endif /* ACTION_DISPATCHER_H */
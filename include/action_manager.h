@@ -20,6 +20,18 @@ typedef enum {
 // 动作回调函数类型
 typedef void (*action_callback_t)(void* data);
 
+/*
+ * 目标绑定
+ * 
+ * 记录目标处理动作解析到的设备实例。拓扑代号（device_manager_topology_generation）
+ * 与绑定时不同时绑定失效，下次执行时重新解析。绑定单元由规则的持有者分配，
+ * 目标动作的副本共享同一个单元。
+ */
+typedef struct action_binding {
+    device_instance_t* device;    // 解析到的设备实例
+    uint32_t generation;          // 解析时的拓扑代号，0表示未绑定
+} action_binding_t;
+
 // 目标处理动作结构
 typedef struct action_target {
     action_type_t type;           // 动作类型
@@ -30,6 +42,7 @@ typedef struct action_target {
     uint32_t target_mask;         // 目标掩码
     action_callback_t callback;   // 回调函数
     void* callback_data;          // 回调数据
+    action_binding_t* binding;    // 目标绑定，NULL时每次执行都查找目标设备
 } action_target_t;
 
 // 目标动作数组结构
@@ -38,19 +51,89 @@ typedef struct action_target_array {
     int count;                                  // 数组中的目标数量
 } action_target_array_t;
 
+/*
+ * 共享目标池
+ * 
+ * 规则表项和设备规则的目标动作存放在进程内共享的只增目标池中，规则只保存
+ * （偏移，数量）。内容相同的目标序列只存一份。池按块分配，已分配的目标
+ * 地址不会移动，可以按只读引用直接执行。
+ */
+typedef struct {
+    uint32_t offset;              // 在目标池中的起始位置
+    uint32_t count;               // 目标数量
+} action_target_ref_t;
+
+/**
+ * 把目标序列放入目标池
+ * 
+ * @param targets 目标动作
+ * @param count 目标数量（0..MAX_ACTION_TARGETS）
+ * @param ref 输出引用
+ * @return 成功返回0，失败返回-1
+ */
+int action_target_pool_intern(const action_target_t* targets, int count, action_target_ref_t* ref);
+
+// 按引用取目标序列，数量为0时返回NULL
+const action_target_t* action_target_pool_get(action_target_ref_t ref);
+
+// 规则表示的内存占用报告
+typedef struct {
+    size_t embedded_rule_bytes;   // 内嵌目标数组的规则表项大小（旧表示）
+    size_t compact_rule_bytes;    // 引用目标池的规则表项大小
+    size_t target_bytes;          // 单个目标动作大小
+    uint64_t interned;            // 放入目标池的目标序列数
+    uint64_t deduplicated;        // 其中复用已有序列的次数
+    size_t pool_targets;          // 目标池中的目标数
+    size_t pool_bytes;            // 目标池已分配的字节数
+} action_memory_report_t;
+
+// 获取规则表示的内存占用
+void action_manager_get_memory_report(action_memory_report_t* report);
+
+// 打印每条规则的内存占用（旧表示与目标池表示对比）
+void action_manager_print_memory_report(void);
+
+// 规则触发方式
+typedef enum {
+    RULE_TRIGGER_LEVEL = 0,       // 电平：每次写入后掩码值匹配就触发
+    RULE_TRIGGER_RISING,          // 上升沿：掩码值从不匹配变为匹配时触发
+    RULE_TRIGGER_CHANGE           // 变化：掩码值与上次观察到的值不同时触发（不要求匹配）
+} rule_trigger_mode_t;
+
 // 规则触发条件
 typedef struct {
     uint32_t trigger_addr;        // 触发地址
     uint32_t expected_value;      // 期望值
     uint32_t expected_mask;       // 期望掩码
+    rule_trigger_mode_t mode;     // 触发方式，默认电平触发
+    uint32_t range_end;           // 范围触发的结束地址（不含），不大于trigger_addr时为单字触发
 } rule_trigger_t;
 
+/*
+ * 范围触发
+ * 
+ * range_end大于trigger_addr时规则监视 [trigger_addr, range_end)：写入与范围重叠时，
+ * 重叠部分中完整位于区域内的每个32位字按期望值/掩码比较，任一字满足即触发一次。
+ * 范围触发按电平方式判断，不使用mode。
+ */
+static inline int rule_trigger_is_range(const rule_trigger_t* trigger) {
+    return trigger->range_end > trigger->trigger_addr;
+}
+
+// 规则触发合并策略，全部为0表示不合并（原子访问，可在运行时修改）
+typedef struct {
+    uint32_t every_writes;        // 每N次触发最多执行一次，0或1表示不按次数合并
+    uint32_t window_us;           // 每T微秒最多执行一次，0表示不按时间合并
+} rule_coalesce_t;
+
 // 规则表项结构
 typedef struct rule_table_entry {
     const char* name;             // 规则名称
     rule_trigger_t trigger;       // 触发条件
-    action_target_array_t targets; // 目标处理动作数组（直接包含，不是指针）
+    action_target_ref_t targets;  // 目标处理动作（目标池引用）
     int priority;                 // 优先级
+    device_type_id_t device_type; // 触发设备类型（规则索引键的一部分）
+    rule_coalesce_t coalesce;     // 触发合并策略
 } rule_table_entry_t;
 
 // 动作规则结构
@@ -60,8 +143,72 @@ typedef struct action_rule {
     rule_trigger_t trigger;       // 触发条件
     action_target_array_t targets; // 目标处理动作数组（直接包含，不是指针）
     int priority;                 // 优先级
+    device_type_id_t device_type; // 触发设备类型（规则索引键的一部分）
+    int device_id;                // 触发设备ID，0表示未知（用于级联循环检测）
 } action_rule_t;
 
+/*
+ * 规则索引
+ * 
+ * 以（触发设备类型，触发字地址）为键的哈希表（uthash），值为规则在所属数组中的位置。
+ * 触发字按4字节对齐归并；未对齐的触发地址同时登记在它覆盖的两个字下。
+ * 规则数组变化后需要重建索引。
+ */
+typedef struct rule_index rule_index_t;
+
+// 创建空的规则索引
+rule_index_t* rule_index_create(void);
+
+// 销毁规则索引
+void rule_index_destroy(rule_index_t* index);
+
+// 清空规则索引
+void rule_index_clear(rule_index_t* index);
+
+// 登记一条规则：position为规则在所属数组中的位置
+int rule_index_add(rule_index_t* index, device_type_id_t device_type, uint32_t trigger_addr, int position);
+
+/**
+ * 查找触发字覆盖addr所在4字节字的规则
+ * 
+ * @param positions 输出规则位置数组（按登记顺序），在索引变化前有效
+ * @return 规则数量，没有规则返回0
+ */
+int rule_index_lookup(const rule_index_t* index, device_type_id_t device_type, uint32_t addr, 
+                      const int** positions);
+
+/*
+ * 范围规则索引
+ * 
+ * 每个触发设备类型一棵区间树：区间按起始地址排序存放，隐式平衡二叉树的每个
+ * 节点记录子树内最大的结束地址。查找与 [start, end) 重叠的区间为O(log n + k)。
+ * 登记只追加，全部登记后调用rule_range_index_build一次排序建树（O(n log n)），
+ * 之后登记的区间在下一次建树前查询不到。
+ */
+typedef struct rule_range_index rule_range_index_t;
+
+// 创建空的范围规则索引
+rule_range_index_t* rule_range_index_create(void);
+
+// 销毁范围规则索引
+void rule_range_index_destroy(rule_range_index_t* index);
+
+// 登记一条范围规则 [start, end)：position为规则在所属数组中的位置
+int rule_range_index_add(rule_range_index_t* index, device_type_id_t device_type, 
+                         uint32_t start, uint32_t end, int position);
+
+// 为登记的区间排序并建立区间树，成功返回0
+int rule_range_index_build(rule_range_index_t* index);
+
+/**
+ * 查找与 [start, end) 重叠的范围规则
+ * 
+ * @param positions 输出规则位置（按起始地址排序），最多max_positions个
+ * @return 重叠的规则总数（可能大于max_positions）
+ */
+int rule_range_index_query(const rule_range_index_t* index, device_type_id_t device_type, 
+                           uint64_t start, uint64_t end, int* positions, int max_positions);
+
 // 规则提供者接口
 typedef struct {
     const char* provider_name;
@@ -69,11 +216,29 @@ typedef struct {
     int (*get_rule_count)(void);
 } rule_provider_t;
 
-// 动作管理器
-typedef struct {
-    pthread_mutex_t mutex;        // 互斥锁
+/*
+ * 规则表快照
+ * 
+ * 发布后不再修改。增删规则时更新者复制当前规则表，修改副本并重建索引后原子地
+ * 替换发布指针；旧规则表在宽限期结束（替换前进入的读者全部退出）后释放。
+ * 读者不加锁，在action_manager_read_begin/read_end之间使用快照。
+ */
+typedef struct action_rule_table {
     action_rule_t* rules;         // 规则数组
     int rule_count;               // 规则数量
+    rule_index_t* index;          // 规则索引（单字触发）
+    rule_range_index_t* ranges;   // 范围规则索引
+    uint64_t version;             // 版本号，每次替换加1
+} action_rule_table_t;
+
+// 动作管理器
+typedef struct {
+    pthread_mutex_t mutex;        // 更新者互斥锁，读者不使用
+    action_rule_table_t* table;   // 当前发布的规则表（原子访问）
+    uint32_t read_epoch;          // 读者纪元，每个宽限期加1（原子访问）
+    uint32_t readers[2];          // 按纪元奇偶分组的读者数（原子访问）
+    uint64_t grace_periods;       // 已完成的宽限期数（原子访问）
+    struct action_dispatcher* dispatcher; // 异步分发器，NULL时同步执行目标处理动作
 } action_manager_t;
 
 // 创建目标处理动作
@@ -87,6 +252,9 @@ void action_target_add_to_array(action_target_array_t* array, const action_targe
 // 创建规则触发条件
 rule_trigger_t rule_trigger_create(uint32_t addr, uint32_t value, uint32_t mask);
 
+// 创建范围触发条件 [start, end)
+rule_trigger_t rule_trigger_create_range(uint32_t start, uint32_t end, uint32_t value, uint32_t mask);
+
 // 创建规则表项
 rule_table_entry_t* rule_table_entry_create(const char* name, rule_trigger_t trigger, 
                                           const action_target_array_t* targets, int priority);
@@ -121,6 +289,144 @@ int action_manager_add_rule(action_manager_t* am, action_rule_t* rule);
 // 移除规则
 void action_manager_remove_rule(action_manager_t* am, int rule_id);
 
+/**
+ * 整体替换规则集（热加载）
+ * 
+ * 新规则表构建完成后一次性发布，读者看到的要么是旧规则集要么是新规则集。
+ * 
+ * @param rules 新规则（复制，rule_id保留）
+ * @param count 规则数量，0表示清空
+ * @return 成功返回0，失败返回-1（原规则集不变）
+ */
+int action_manager_replace_rules(action_manager_t* am, const action_rule_t* rules, int count);
+
+/**
+ * 进入读侧临界区
+ * 
+ * 不加锁，可以嵌套和并发。临界区内不能增删或替换规则（会等待自己退出）。
+ * 
+ * @return 读者令牌，传给action_manager_read_end
+ */
+int action_manager_read_begin(action_manager_t* am);
+
+// 退出读侧临界区
+void action_manager_read_end(action_manager_t* am, int token);
+
+// 当前发布的规则表，只在读侧临界区内有效
+const action_rule_table_t* action_manager_rules(action_manager_t* am);
+
+/**
+ * 查找触发字覆盖addr所在4字节字的规则，以及范围与该字重叠的范围规则（排在后面）
+ * 
+ * @param rule_ids 输出规则ID
+ * @param max_rules rule_ids数组容量
+ * @return 匹配的规则总数（可能大于max_rules），失败返回-1
+ */
+int action_manager_find_rules(action_manager_t* am, device_type_id_t device_type, uint32_t addr,
+                              int* rule_ids, int max_rules);
+
+/*
+ * 延迟执行
+ * 
+ * 设备插件在获取设备锁之前调用action_manager_defer_begin()，释放锁之后调用
+ * action_manager_defer_end()。期间匹配的规则放入当前线程的待执行队列，最外层
+ * defer_end时按匹配顺序执行，规则动作不会在持有设备锁时进入其他设备。
+ * 执行队列时新匹配的规则追加到队尾，同一个线程上不会递归执行。
+ */
+
+// 开始延迟执行（可以嵌套）
+void action_manager_defer_begin(void);
+
+// 结束延迟执行，最外层时执行当前线程的待执行规则
+void action_manager_defer_end(void);
+
+/**
+ * 等待其他线程的待执行队列清空
+ * 
+ * 待执行的触发按引用使用目标动作和绑定单元，释放它们之前调用。只等待调用时
+ * 已经非空的队列；队列执行时提交给分发器的动作另由action_manager_flush等待。
+ * 
+ * @return 成功返回0；当前线程自己的队列非空（无法等待自己）时返回-1
+ */
+int action_manager_defer_wait(void);
+
+// 提交规则：延迟执行期间放入待执行队列并返回0，否则立即执行（级联规则迭代执行）
+int action_manager_submit_rule(action_manager_t* am, const action_rule_t* rule, device_manager_t* dm);
+
+/*
+ * 规则级联
+ * 
+ * 执行待执行队列中的规则时，目标写入再匹配到的规则是它的级联，追加到同一个
+ * 队列中迭代执行，不会递归。级联深度超过上限，或者同一触发设备上的同一规则
+ * 在级联链上再次出现（循环）时，这条级联规则被丢弃并打印从起点开始的规则链。
+ * 经过异步分发器或写入事件队列的写入在其他线程上开始新的级联。
+ */
+
+// 默认级联深度上限
+#define ACTION_CASCADE_DEFAULT_MAX_DEPTH  16
+
+// 截断报告最多打印的规则数
+#define ACTION_CASCADE_REPORT_MAX  32
+
+// 级联统计
+typedef struct {
+    uint64_t cascades;            // 级联起点数
+    uint64_t max_depth;           // 观察到的最大级联深度
+    uint64_t depth_truncated;     // 因超过深度上限被截断的次数
+    uint64_t cycle_truncated;     // 因循环被截断的次数
+} action_cascade_stats_t;
+
+// 设置级联深度上限（0表示不执行任何级联规则），成功返回0
+int action_manager_set_cascade_limit(int max_depth);
+
+// 获取级联统计
+void action_manager_get_cascade_stats(action_cascade_stats_t* stats);
+
+/*
+ * 异步执行
+ * 
+ * 开启后action_manager_execute_rule把目标处理动作交给分发器的工作线程执行并立即返回，
+ * 同一目标设备的动作按提交顺序执行。开启和关闭不能与规则执行并发。
+ */
+
+/**
+ * 开启异步执行
+ * 
+ * @param worker_count 工作线程数
+ * @return 成功返回0（已开启时也返回0），失败返回-1
+ */
+int action_manager_start_async(action_manager_t* am, int worker_count);
+
+// 等待已提交的动作全部完成后关闭异步执行
+void action_manager_stop_async(action_manager_t* am);
+
+// 等待已提交的动作（包括级联动作）全部完成，同步模式下直接返回0
+int action_manager_flush(action_manager_t* am);
+
+/*
+ * 规则触发
+ * 
+ * 一次规则触发的只读描述，按引用使用目标动作，不复制规则。设备内存匹配到
+ * 规则表项时直接以目标池中的目标构造触发。
+ */
+typedef struct action_firing {
+    int rule_id;                  // 规则ID
+    const char* name;             // 规则名称
+    rule_trigger_t trigger;       // 触发条件
+    device_type_id_t device_type; // 触发设备类型
+    int device_id;                // 触发设备ID
+    const action_target_t* targets; // 目标动作（只读，执行期间必须有效）
+    int target_count;             // 目标数量
+    action_binding_t* bindings;   // 与targets一一对应的绑定单元，NULL时使用目标自身的binding
+    int inherit_device;           // 目标未指定设备类型或ID时使用触发设备（规则表语义）
+} action_firing_t;
+
+// 提交规则触发：与action_manager_submit_rule相同，但不复制目标动作
+int action_manager_submit_firing(action_manager_t* am, const action_firing_t* firing, device_manager_t* dm);
+
+// 执行规则触发
+int action_manager_execute_firing(action_manager_t* am, const action_firing_t* firing, device_manager_t* dm);
+
 // 执行规则
 int action_manager_execute_rule(action_manager_t* am, action_rule_t* rule, device_manager_t* dm);
 
@@ -3,7 +3,9 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <pthread.h>
 #include "device_types.h"
+#include "write_event_queue.h"
 
 // 内存区域结构体 - 四元组结构
 typedef struct {
@@ -13,12 +15,70 @@ typedef struct {
     uint8_t* data;            // 数据指针
     uint32_t device_type;     // 设备类型
     uint32_t device_id;       // 设备ID
+    uint32_t flags;           // 区域标志（MEMORY_REGION_*）
+    uint8_t fill_value;       // 未写入数据的填充值
+    uint8_t** pages;          // 稀疏区域的页指针数组（data为NULL），未分配的页为NULL
+    size_t resident_pages;    // 稀疏区域已分配的页数
+    const char* backing_file; // 文件映射区域的文件路径（data指向映射地址）
+    uint64_t* snap_touched;   // 普通区域在最近一次快照/恢复后写入过的页位图
+    uint8_t** snap_pages;     // 普通区域最近一次快照/恢复的页（与快照共享），下次快照复用未写入的页
+    uint64_t* dirty;          // 脏页位图，每位对应一页，由所有写入路径原子置位
+    uint64_t* triggers;       // 触发字位图，每位对应一个32位字；区域内没有任何触发地址时为NULL（属于当前规则状态，原子发布）
 } memory_region_t;
 
+// 页表解码参数：每页4KB
+#define DEVICE_MEMORY_PAGE_SHIFT   12
+#define DEVICE_MEMORY_PAGE_SIZE    (1u << DEVICE_MEMORY_PAGE_SHIFT)
+
+// 页表最多页数，超过后回退到二分查找（定义为0可完全禁用页表）
+#ifndef DEVICE_MEMORY_PAGE_TABLE_MAX_PAGES
+#define DEVICE_MEMORY_PAGE_TABLE_MAX_PAGES  (1u << 16)
+#endif
+
+// 页表最低密度：页表项数不超过已映射页数的该倍数，否则视为过于稀疏
+#ifndef DEVICE_MEMORY_PAGE_TABLE_SPARSITY
+#define DEVICE_MEMORY_PAGE_TABLE_SPARSITY   4
+#endif
+
+// 页表项特殊值
+#define PAGE_ENTRY_UNMAPPED  (-1)  // 页内没有任何区域
+#define PAGE_ENTRY_SHARED    (-2)  // 页内有多个区域，需要回退到查找
+
+// 分散/聚集访问时在栈上解析的最大段数，超过后分配堆内存
+#define DEVICE_MEMORY_IOV_STACK  16
+
+// slab中各部分的对齐粒度（缓存行大小）
+#ifndef DEVICE_MEMORY_SLAB_ALIGN
+#define DEVICE_MEMORY_SLAB_ALIGN  64
+#endif
+
+// 区域地址范围（按基地址排序，用于快速查找）
+typedef struct {
+    uint32_t base_addr;       // 基地址
+    uint32_t last_addr;       // 最后一个字节的地址（包含）
+} memory_region_span_t;
+
 // 设备内存结构
 struct device_memory {
-    memory_region_t* regions;     // 内存区域数组
+    memory_region_t* regions;     // 内存区域数组（按基地址升序排列）
     int region_count;             // 区域数量
+    memory_region_span_t* spans;  // 区域地址范围索引，与regions一一对应
+    int last_hit;                 // 最近一次命中的区域索引
+    int16_t* page_table;          // 页表：页号 -> 区域索引，NULL表示未启用
+    uint32_t page_base;           // 页表覆盖的起始地址（页对齐）
+    uint32_t page_count;          // 页表项数量
+    uint64_t snapshot_gen;        // snap_touched位图所对应的快照代号，0表示无
+    uint32_t write_begin;         // 顺序锁：已开始的写入次数（原子访问）
+    uint32_t write_end;           // 顺序锁：已完成的写入次数，与write_begin相等时没有写入在进行
+    void* slab;                   // 整个设备内存所在的slab（本结构位于其中，销毁时一次释放）
+    size_t slab_size;             // slab字节数（不含对齐余量）
+    void* export_base;            // memfd共享映射地址，NULL表示未导出
+    size_t export_size;           // memfd大小
+    int export_fd;                // memfd文件描述符（export_base不为NULL时有效）
+    struct device_rule_state* rule_state; // 当前规则表代次的触发位图、目标绑定、触发和合并状态（原子发布）
+    pthread_mutex_t rule_state_lock; // 串行化规则状态的重建
+    pthread_mutex_t coalesce_lock; // 保护各规则状态中的合并状态
+    uint64_t coalesce_flushed;    // 由device_memory_flush_coalesced补发的触发次数
     void* monitor;                // 监视器指针（类型已改为void*）
     uint32_t device_type;         // 设备类型
     uint32_t device_id;           // 设备ID
@@ -48,13 +108,274 @@ int device_memory_read_byte(device_memory_t* mem, uint32_t addr, uint8_t* value)
 // 写入字节
 int device_memory_write_byte(device_memory_t* mem, uint32_t addr, uint8_t value);
 
-// 批量读取内存
+// 批量读取内存：可以跨越首尾相接的多个区域，范围内有空洞时不读取任何数据
 int device_memory_read_buffer(device_memory_t* mem, uint32_t addr, uint8_t* buffer, size_t length);
 
-// 批量写入内存
+// 批量写入内存：可以跨越首尾相接的多个区域，范围内有空洞时不写入任何数据（从不检查规则，也不产生写入事件）
 int device_memory_write_buffer(device_memory_t* mem, uint32_t addr, const uint8_t* buffer, size_t length);
 
-// 查找地址所在的内存区域
+/**
+ * 根据设备类型的规则表重建各区域的触发字位图和规则目标绑定单元
+ * 
+ * 创建设备内存时自动调用；规则表代次变化后写入路径在下一次规则检查时
+ * 自动重建，新规则从未观察开始。显式调用时以当前内容作为新规则边沿/变化
+ * 触发的初始值。写入只在位图中有对应位时才进入规则检查。规则目标在第一次
+ * 触发时绑定到设备实例，之后触发不再查找目标设备。可以与写入并发调用。
+ * 
+ * @return 成功返回0，内存不足返回-1（此时所有区域都回退为逐条检查规则）
+ */
+int device_memory_rebuild_triggers(device_memory_t* mem);
+
+/**
+ * 查找 [addr, addr+length) 范围内的第一个空洞（不属于任何区域的地址）
+ * 
+ * @param hole_addr 输出空洞起始地址，可以为NULL
+ * @param hole_length 输出空洞在范围内的字节数，可以为NULL
+ * @return 没有空洞返回0，有空洞返回1，参数无效返回-1
+ */
+int device_memory_find_hole(device_memory_t* mem, uint32_t addr, size_t length, 
+                            uint32_t* hole_addr, size_t* hole_length);
+
+// 分散读取：先解析所有段的区域，任一段无效则不读取任何数据
+int device_memory_readv(device_memory_t* mem, const device_iovec_t* iov, int iovcnt);
+
+// 聚集写入：先解析所有段的区域，任一段无效则不写入任何数据（与批量写入一样从不检查规则）
+int device_memory_writev(device_memory_t* mem, const device_iovec_t* iov, int iovcnt);
+
+// 按宽度读取内存（width为1/2/4/8字节，小端存储）
+int device_memory_read_width(device_memory_t* mem, uint32_t addr, unsigned int width, uint64_t* value);
+
+// 按宽度写入内存（width为1/2/4/8字节），写入后检查触发字与写入范围重叠的规则
+int device_memory_write_width(device_memory_t* mem, uint32_t addr, unsigned int width, uint64_t value);
+
+// 读写16位
+int device_memory_read16(device_memory_t* mem, uint32_t addr, uint16_t* value);
+int device_memory_write16(device_memory_t* mem, uint32_t addr, uint16_t value);
+
+// 读写64位
+int device_memory_read64(device_memory_t* mem, uint32_t addr, uint64_t* value);
+int device_memory_write64(device_memory_t* mem, uint32_t addr, uint64_t value);
+
+/*
+ * 无锁寄存器访问
+ * 
+ * 只适用于MEMORY_REGION_LOCKFREE普通区域内4字节对齐的地址，不满足条件时
+ * 返回-1且不打印信息，调用者可回退到加锁的device_memory_read/write。
+ * 这些操作不检查规则。设备可能被configure_memory替换内存时，不持有设备锁的
+ * 调用者需在宽限期读侧（见下文）内加载内存指针并完成访问。
+ */
+
+// 读取32位寄存器（acquire语义）
+int device_memory_atomic_load32(device_memory_t* mem, uint32_t addr, uint32_t* value);
+
+// 写入32位寄存器（release语义）
+int device_memory_atomic_store32(device_memory_t* mem, uint32_t addr, uint32_t value);
+
+// 原子置位，old_value不为NULL时返回原值
+int device_memory_atomic_fetch_or32(device_memory_t* mem, uint32_t addr, uint32_t bits, uint32_t* old_value);
+
+// 原子清位（value &= mask），old_value不为NULL时返回原值
+int device_memory_atomic_fetch_and32(device_memory_t* mem, uint32_t addr, uint32_t mask, uint32_t* old_value);
+
+// 原子比较并交换：成功返回0；当前值不等于*expected时返回1并把当前值写入*expected
+int device_memory_atomic_cas32(device_memory_t* mem, uint32_t addr, uint32_t* expected, uint32_t desired);
+
+/*
+ * 内存指针的宽限期
+ * 
+ * 设备插件的无锁快速路径在grace_enter/grace_exit之间以acquire方式加载设备内存指针；
+ * configure_memory以release方式发布新内存后调用device_memory_grace_wait，等待发布前
+ * 进入的读者全部退出，再销毁旧内存。读者按纪元奇偶分组计数，与规则表的读侧相同。
+ */
+typedef struct {
+    uint32_t epoch;               // 读者纪元，每个宽限期加1（原子访问）
+    uint32_t readers[2];          // 按纪元奇偶分组的读者数（原子访问）
+} device_memory_grace_t;
+
+// 进入读侧，返回传给device_memory_grace_exit的令牌
+int device_memory_grace_enter(device_memory_grace_t* grace);
+
+// 退出读侧
+void device_memory_grace_exit(device_memory_grace_t* grace, int token);
+
+// 等待调用前进入的读者全部退出（替换者之间需互斥，通常持有设备锁）
+void device_memory_grace_wait(device_memory_grace_t* grace);
+
+/**
+ * 一致性读取多个32位寄存器（顺序锁）
+ * 
+ * 不加锁乐观地读取所有地址，期间如有写入则重试，得到的是某一时刻的一致视图，
+ * 不会阻塞写入者，也不会阻塞其他读取者。地址必须4字节对齐且位于普通（非稀疏）区域内。
+ * 
+ * @param addrs 寄存器地址数组
+ * @param values 输出寄存器值数组
+ * @param count 寄存器个数
+ * @return 成功返回0，地址无效返回-1
+ */
+int device_memory_read_consistent(device_memory_t* mem, const uint32_t* addrs, uint32_t* values, int count);
+
+/**
+ * 一致性写入多个32位寄存器
+ * 
+ * 所有寄存器在同一个写入区间内更新，device_memory_read_consistent不会看到只写了一部分的结果；
+ * 全部写入后按顺序检查规则。地址要求与一致性读取相同，任一地址无效时不写入任何数据。
+ * 
+ * @return 成功返回0，地址无效返回-1
+ */
+int device_memory_write_consistent(device_memory_t* mem, const uint32_t* addrs, const uint32_t* values, int count);
+
+/*
+ * 写入事件
+ * 
+ * 开启后每次写入（write/write_width/write_consistent）只向全局写入事件队列发布
+ * {设备类型, 设备ID, 地址, 旧值, 新值}，规则检查在队列的消费者线程中进行。
+ * 队列满时写入者回退为同步检查规则并计入溢出次数。
+ * 开启和关闭不能与写入并发；设备内存销毁前会等待已发布的事件处理完成。
+ */
+
+/**
+ * 开启写入事件队列
+ * 
+ * @param capacity 队列容量
+ * @param tap 事件观察函数（如跟踪），在消费者线程中先于规则检查调用，可以为NULL
+ * @param tap_context 观察函数上下文
+ * @return 成功返回0（已开启时也返回0），失败返回-1
+ */
+int device_memory_events_start(size_t capacity, write_event_handler_t tap, void* tap_context);
+
+// 处理完已发布的事件后关闭写入事件队列，恢复同步检查规则
+void device_memory_events_stop(void);
+
+// 等待已发布的写入事件处理完成，未开启时直接返回0
+int device_memory_events_flush(void);
+
+// 获取写入事件队列统计，未开启时返回-1
+int device_memory_events_stats(write_event_queue_stats_t* stats);
+
+/*
+ * 规则触发合并
+ * 
+ * 规则表项设置了合并策略（见set_device_rule_coalescing）时，满足触发条件的写入
+ * 在窗口内只执行一次处理动作，其余计为被合并。被合并的触发以最后一次写入后的值
+ * 为准，由device_memory_flush_coalesced在窗口结束后补发一次。
+ */
+
+// 规则合并统计（只统计设置了合并策略的规则）
+typedef struct {
+    uint64_t fired;               // 执行的触发次数（包括补发）
+    uint64_t suppressed;          // 被合并的触发次数
+    uint64_t flushed;             // 补发的触发次数
+    int pending;                  // 当前等待补发的规则数
+} device_memory_coalesce_stats_t;
+
+// 时钟函数，返回微秒
+typedef uint64_t (*device_memory_clock_t)(void);
+
+// 设置规则合并使用的时钟（如虚拟时间），NULL恢复为单调时钟
+void device_memory_set_clock(device_memory_clock_t clock);
+
+/**
+ * 补发被合并的触发
+ * 
+ * 只补发按最后一次写入后的值仍然满足触发条件的规则（变化触发总是补发）。
+ * 
+ * @param force 非0时忽略时间窗口立即补发
+ * @return 补发的规则数，失败返回-1
+ */
+int device_memory_flush_coalesced(device_memory_t* mem, int force);
+
+// 获取规则合并统计
+int device_memory_coalesce_stats(device_memory_t* mem, device_memory_coalesce_stats_t* stats);
+
+// 同步方式
+#define DEVICE_MEMORY_SYNC_ASYNC  0  // 只调度写回，不等待完成
+#define DEVICE_MEMORY_SYNC_WAIT   1  // 等待写回完成
+
+// 将所有MAP_SHARED文件映射区域写回文件
+int device_memory_sync(device_memory_t* mem, int mode);
+
+// 将 [addr, addr+length) 范围内的MAP_SHARED文件映射数据写回文件
+int device_memory_sync_range(device_memory_t* mem, uint32_t addr, size_t length, int mode);
+
+/**
+ * 创建设备内存快照
+ * 
+ * 稀疏区域与快照按页共享数据，之后的写入对共享页做写时复制；
+ * 普通区域只复制上次快照（或恢复）之后写入过的页，其余页与上次的快照共享。
+ * 调用者负责与读写操作互斥（通常持有设备锁）。
+ * 
+ * @param mem 设备内存
+ * @return 快照，失败返回NULL
+ */
+device_memory_snapshot_t* device_memory_snapshot(device_memory_t* mem);
+
+/**
+ * 恢复设备内存到快照状态
+ * 
+ * 稀疏区域替换页指针；普通区域跳过上次快照（或恢复）之后没有写入、
+ * 且与这个快照共享的页，只复制其余的页。快照可以多次恢复。
+ * 
+ * @param mem 设备内存（区域布局必须与快照一致）
+ * @param snap 快照
+ * @return 成功返回0，失败返回-1
+ */
+int device_memory_restore(device_memory_t* mem, const device_memory_snapshot_t* snap);
+
+// 销毁设备内存快照
+void device_memory_snapshot_destroy(device_memory_snapshot_t* snap);
+
+// 导出区域布局描述
+struct device_memory_export_region {
+    uint32_t base_addr;           // 区域基地址
+    uint32_t flags;               // 区域标志（MEMORY_REGION_*）
+    uint64_t size;                // 区域字节数
+    uint64_t offset;              // 区域数据在memfd中的偏移（按页对齐，可直接作为mmap偏移）
+};
+
+/**
+ * 把设备内存的普通区域改为由memfd承载，并返回memfd和布局描述
+ * 
+ * 首次调用时创建memfd，复制当前数据并把区域数据指针切换到memfd的共享映射，
+ * 之后所有写入直接落在memfd中；再次调用返回同一个memfd。稀疏区域和文件映射区域不导出。
+ * memfd封住了大小，并在内核支持时禁止新的可写映射，同一主机上的其他进程
+ * （通过SCM_RIGHTS或/proc/<pid>/fd获得fd）只能只读映射，读取时没有复制也没有系统调用。
+ * 
+ * memfd属于设备内存，销毁设备内存时关闭；需要长期持有的调用者应dup()。
+ * 首次导出与所有访问（包括无锁访问）互斥，通常持有设备锁。
+ * 
+ * @param mem 设备内存
+ * @param layout 输出导出区域的布局（按基地址升序），可以为NULL
+ * @param max_regions layout数组容量
+ * @param region_count 输出导出的区域总数（可能大于max_regions），可以为NULL
+ * @return memfd，失败返回-1
+ */
+int device_memory_export(device_memory_t* mem, device_memory_export_region_t* layout, 
+                         int max_regions, int* region_count);
+
+// 获取区域脏页位图的字数（每位对应DEVICE_MEMORY_PAGE_SIZE字节）
+size_t device_memory_dirty_words(const memory_region_t* region);
+
+/**
+ * 获取并清除区域的脏页位图
+ * 
+ * 每个字以原子交换取走，可以与写入并发调用；取走之后的写入会在
+ * 下一次调用时返回。检查点只需保存返回位图中置位的页。
+ * 
+ * @param mem 设备内存
+ * @param region_index 区域索引（按基地址排序后的顺序）
+ * @param bitmap 输出位图，为NULL时只清除
+ * @param words 位图缓冲区字数，不小于device_memory_dirty_words()
+ * @return 脏页数量，失败返回-1
+ */
+int device_memory_fetch_clear_dirty(device_memory_t* mem, int region_index, uint64_t* bitmap, size_t words);
+
+// 获取区域实际占用的数据字节数（稀疏区域只统计已分配的页）
+size_t device_memory_region_resident_bytes(const memory_region_t* region);
+
+// 获取设备内存实际占用的数据字节数
+size_t device_memory_resident_bytes(const device_memory_t* mem);
+
+// 查找地址所在的内存区域（页表 + 最近命中缓存 + 二分查找）
 memory_region_t* device_memory_find_region(device_memory_t* mem, uint32_t addr);
 
 #endif /* DEVICE_MEMORY_H */ 
\ No newline at end of file
@@ -18,6 +18,8 @@ typedef struct {
     uint32_t target_mask;           // 目标掩码
     action_callback_t callback;     // 回调函数
     void* callback_data;            // 回调数据
+    rule_trigger_mode_t trigger_mode; // 触发方式，未指定时为电平触发
+    uint32_t addr_end;              // 范围触发的结束地址（不含），未指定时只监控addr处的字
 } device_rule_config_t;
 
 // Flash设备规则配置
@@ -38,9 +40,95 @@ action_target_t create_action_target_from_config(const device_rule_config_t* con
 // 从配置创建规则
 device_rule_t create_device_rule_from_config(const device_rule_config_t* config);
 
-// 获取设备规则配置
+/**
+ * 获取设备规则配置（打印规则表）
+ * 
+ * 不在规则读侧临界区内调用时，返回的规则表只在规则表下一次修改之前有效。
+ */
 const rule_table_entry_t* get_device_rules(device_type_id_t device_type, int* count);
 
+/*
+ * 规则表读侧临界区
+ * 
+ * 规则表以快照发布，修改时复制出新快照，等待修改前进入的读者全部退出后释放旧快照。
+ * 以下查询返回的规则表在取得它的临界区退出前有效。临界区可以嵌套，不能在临界区内
+ * 修改规则表。
+ */
+
+// 进入规则表读侧临界区，返回传给device_rules_read_end的令牌
+int device_rules_read_begin(void);
+
+// 退出规则表读侧临界区
+void device_rules_read_end(int token);
+
+/**
+ * 获取设备类型的规则表及规则表代次（不打印信息）
+ * 
+ * 增删规则或修改合并策略后代次递增；同一代次内规则在规则表中的位置不变。
+ * 
+ * @param count 输出规则数
+ * @param generation 输出规则表代次，可以为NULL
+ */
+const rule_table_entry_t* get_device_rule_table(device_type_id_t device_type, int* count, uint64_t* generation);
+
+// 获取规则表代次（所有设备类型共用，不需要进入读侧临界区）
+uint64_t device_rules_generation(void);
+
+/**
+ * 按触发字查找设备规则（哈希索引，不打印信息）
+ * 
+ * @param addr 地址，查找触发字覆盖其所在4字节字的规则
+ * @param positions 输出候选规则在规则表中的位置
+ * @param count 输出候选规则数量
+ * @return 设备类型的规则表，没有候选规则时返回NULL
+ */
+const rule_table_entry_t* get_device_rules_at(device_type_id_t device_type, uint32_t addr, 
+                                              const int** positions, int* count);
+
+/**
+ * 设置设备类型规则的触发合并策略（不修改规则配置）
+ * 
+ * 同时设置次数和时间时两个限制都生效。调用限制与add_device_rule相同。
+ * 
+ * @param trigger_addr 触发地址，设置该设备类型所有以此为触发地址的规则
+ * @param every_writes 每N次触发最多执行一次，0或1表示不按次数合并
+ * @param window_us 每window_us微秒最多执行一次，0表示不按时间合并
+ * @return 设置的规则数，没有匹配的规则返回0
+ */
+int set_device_rule_coalescing(device_type_id_t device_type, uint32_t trigger_addr, 
+                               uint32_t every_writes, uint32_t window_us);
+
+/**
+ * 查找与 [start, end) 重叠的设备范围规则（区间树，不打印信息）
+ * 
+ * @param positions 输出规则在规则表中的位置（按起始地址排序），最多max_positions个
+ * @param count 输出重叠的规则总数（可能大于max_positions）
+ * @return 设备类型的规则表，没有重叠的规则时返回NULL
+ */
+const rule_table_entry_t* get_device_range_rules(device_type_id_t device_type, uint32_t start, uint64_t end, 
+                                                 int* positions, int max_positions, int* count);
+
+/**
+ * 运行时向设备类型规则表追加规则（单字或范围触发）
+ * 
+ * 复制规则表并发布新快照，规则表容量不受限制。可以与写入并发调用，但不能在
+ * 规则读侧临界区内（例如规则动作的回调中）调用。已创建的设备内存在下一次
+ * 规则检查时按新的规则表代次重建触发状态。
+ * 
+ * @return 规则在规则表中的位置，失败返回-1
+ */
+int add_device_rule(device_type_id_t device_type, const char* name, rule_trigger_t trigger, 
+                    const action_target_array_t* targets, int priority);
+
+/**
+ * 运行时从设备类型规则表删除第一条名为name的规则
+ * 
+ * 调用限制与add_device_rule相同；之后的规则在规则表中的位置前移。
+ * 
+ * @return 成功返回0，没有该规则或失败返回-1
+ */
+int remove_device_rule(device_type_id_t device_type, const char* name);
+
 // 根据设备类型设置规则
 int setup_device_rules(struct device_rule_manager* manager, device_type_id_t device_type);
 
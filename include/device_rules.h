@@ -3,17 +3,14 @@
 
 #include <stdint.h>
 #include <pthread.h>
-
-// 前向声明
-struct action_target_array;
-typedef struct action_target_array action_target_array_t;
+#include "action_manager.h"
 
 // 设备规则结构
 typedef struct device_rule {
     uint32_t addr;                  // 监控地址
     uint32_t expected_value;        // 期望值
     uint32_t expected_mask;         // 掩码
-    action_target_array_t* targets; // 目标动作数组（指针）
+    action_target_ref_t targets;    // 目标动作（目标池引用）
     int active;                     // 规则是否激活
 } device_rule_t;
 
@@ -36,6 +33,11 @@ int device_rule_add(device_rule_manager_t* manager, uint32_t addr,
                    uint32_t expected_value, uint32_t expected_mask, 
                    const action_target_array_t* targets);
 
+// 添加设备规则，目标动作已在目标池中
+int device_rule_add_ref(device_rule_manager_t* manager, uint32_t addr, 
+                       uint32_t expected_value, uint32_t expected_mask, 
+                       action_target_ref_t targets);
+
 // 检查值是否匹配规则条件
 static inline int device_rule_check_match(uint32_t value, uint32_t expected_value, uint32_t expected_mask) {
     return (value & expected_mask) == (expected_value & expected_mask);
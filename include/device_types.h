@@ -11,14 +11,36 @@ struct device_rule;
 typedef struct device_rule device_rule_t;
 struct device_memory;
 typedef struct device_memory device_memory_t;
+struct device_memory_snapshot;
+typedef struct device_memory_snapshot device_memory_snapshot_t;
+struct device_memory_export_region;
+typedef struct device_memory_export_region device_memory_export_region_t;
+
+// 内存区域标志
+#define MEMORY_REGION_SPARSE       (1u << 0)  // 稀疏区域：按页在首次写入时分配
+#define MEMORY_REGION_FILE_SHARED  (1u << 1)  // 以MAP_SHARED映射backing_file，写入持久化到文件
+#define MEMORY_REGION_FILE_PRIVATE (1u << 2)  // 以MAP_PRIVATE映射backing_file，写时复制，不修改文件
+#define MEMORY_REGION_FILE_MASK    (MEMORY_REGION_FILE_SHARED | MEMORY_REGION_FILE_PRIVATE)
+#define MEMORY_REGION_STRICT_WIDTH (1u << 3)  // 按宽度访问时要求宽度等于unit_size且地址按unit_size对齐
+#define MEMORY_REGION_LOCKFREE     (1u << 4)  // 寄存器区域：对齐访问使用原子操作，允许不加锁读写32位寄存器
 
 // 从device_memory.h引入memory_region_config_t结构体
 typedef struct memory_region_config {
     uint32_t base_addr;       // 基地址
     size_t unit_size;         // 单位大小（字节）
     size_t length;            // 区域长度（单位数量）
+    uint32_t flags;           // 区域标志（MEMORY_REGION_*）
+    uint8_t fill_value;       // 未写入数据的填充值（如Flash擦除值0xFF）
+    const char* backing_file; // 文件映射区域的文件路径（需设置MEMORY_REGION_FILE_*标志）
 } memory_region_config_t;
 
+// 分散/聚集访问的段描述（读时buffer为输出，写时buffer为输入）
+typedef struct device_iovec {
+    uint32_t addr;            // 段起始地址
+    uint8_t* buffer;          // 段数据缓冲区
+    size_t length;            // 段长度（字节）
+} device_iovec_t;
+
 // 设备类型ID定义
 typedef enum {
     DEVICE_TYPE_FLASH = 0,
@@ -63,6 +85,14 @@ typedef struct {
     struct device_memory* (*get_memory)(device_instance_t* instance);
     
     int (*configure_memory)(device_instance_t* instance, memory_region_config_t* configs, int config_count);
+    
+    // 按宽度访问（可选，width为1/2/4/8字节），未实现时调用者需拆分为32位访问
+    int (*read_width)(device_instance_t* instance, uint32_t addr, unsigned int width, uint64_t* value);
+    int (*write_width)(device_instance_t* instance, uint32_t addr, unsigned int width, uint64_t value);
+    
+    // 分散/聚集访问（可选），所有段在一次加锁内完成
+    int (*readv)(device_instance_t* instance, const device_iovec_t* iov, int iovcnt);
+    int (*writev)(device_instance_t* instance, const device_iovec_t* iov, int iovcnt);
 } device_ops_t;
 
 // 设备类型结构
@@ -78,6 +108,7 @@ typedef struct {
 typedef struct {
     device_type_t types[MAX_DEVICE_TYPES];  // 设备类型数组
     pthread_mutex_t mutex;                   // 类型数组互斥锁
+    uint32_t topology_gen;                   // 拓扑代号：创建/销毁设备实例时递增（原子访问），从1开始
 } device_manager_t;
 
 // API函数声明
@@ -98,4 +129,18 @@ device_instance_t* device_create_with_config(device_manager_t* dm, device_type_i
 void device_destroy(device_manager_t* dm, device_type_id_t type_id, int dev_id);
 device_instance_t* device_get(device_manager_t* dm, device_type_id_t type_id, int dev_id);
 
+// 获取拓扑代号，预解析的动作目标绑定在代号变化后失效
+uint32_t device_manager_topology_generation(device_manager_t* dm);
+
+// 在设备锁内创建设备内存快照（设备类型需要实现get_memory）
+device_memory_snapshot_t* device_snapshot(device_manager_t* dm, device_type_id_t type_id, int dev_id);
+
+// 在设备锁内恢复设备内存快照，用于代替销毁并重新创建设备
+int device_restore(device_manager_t* dm, device_type_id_t type_id, int dev_id, 
+                  const device_memory_snapshot_t* snap);
+
+// 在设备锁内把设备内存导出到memfd，返回值和参数与device_memory_export相同
+int device_export_memory(device_manager_t* dm, device_type_id_t type_id, int dev_id,
+                         device_memory_export_region_t* layout, int max_regions, int* region_count);
+
 #endif
\ No newline at end of file
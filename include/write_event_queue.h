@@ -0,0 +1,73 @@
+// include/write_event_queue.h
+#ifndef WRITE_EVENT_QUEUE_H
+#define WRITE_EVENT_QUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * 写入事件队列
+ *
+ * 有界多生产者单消费者环形队列。生产者（设备内存写入路径）不加锁发布事件：
+ * 用CAS领取槽位，写入事件后发布槽位序号；消费者线程按发布顺序取出事件并
+ * 调用处理函数。同一生产者线程发布的事件按发布顺序处理。
+ * 队列满时发布失败并计入溢出次数，由调用者决定回退方式。
+ */
+
+// 写入事件
+typedef struct {
+    uint32_t device_type;         // 设备类型
+    uint32_t device_id;           // 设备ID
+    uint32_t addr;                // 写入地址
+    uint32_t width;               // 写入宽度（字节）
+    uint64_t old_value;           // 写入前的值
+    uint64_t new_value;           // 写入的值
+    void* source;                 // 发布者（设备内存）
+    void* region;                 // 发布者内部的区域指针
+} write_event_t;
+
+// 事件处理函数，在消费者线程中调用
+typedef void (*write_event_handler_t)(const write_event_t* event, void* context);
+
+// 队列统计
+typedef struct {
+    size_t capacity;              // 队列容量
+    uint64_t published;           // 已发布的事件数
+    uint64_t consumed;            // 已处理的事件数
+    uint64_t overflows;           // 队列满导致发布失败的次数
+    uint64_t high_watermark;      // 消费者观察到的最大积压深度
+    uint64_t wakeups;             // 消费者被生产者唤醒的次数
+} write_event_queue_stats_t;
+
+typedef struct write_event_queue write_event_queue_t;
+
+/**
+ * 创建队列并启动消费者线程
+ *
+ * @param capacity 容量，向上取整为2的幂
+ * @param handler 事件处理函数
+ * @param context 处理函数上下文
+ * @return 队列，失败返回NULL
+ */
+write_event_queue_t* write_event_queue_create(size_t capacity, write_event_handler_t handler, void* context);
+
+// 处理完已发布的事件后停止消费者线程并销毁队列
+void write_event_queue_destroy(write_event_queue_t* queue);
+
+// 发布事件（不加锁），成功返回0，队列满返回-1
+int write_event_queue_publish(write_event_queue_t* queue, const write_event_t* event);
+
+/**
+ * 等待调用前已发布的事件全部处理完成
+ *
+ * @return 成功返回0，在消费者线程中调用返回-1
+ */
+int write_event_queue_flush(write_event_queue_t* queue);
+
+// 当前线程是否为某个队列的消费者线程
+int write_event_queue_in_consumer(void);
+
+// 获取统计信息
+void write_event_queue_get_stats(write_event_queue_t* queue, write_event_queue_stats_t* stats);
+
+#endif /* WRITE_EVENT_QUEUE_H */
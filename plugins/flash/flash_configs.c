@@ -10,16 +10,19 @@ const memory_region_t flash_memory_regions[] = {
         .length = 8,     // 8个寄存器
         .data = NULL,    // 初始化时分配
         .device_type = DEVICE_TYPE_FLASH,
-        .device_id = 0    // 默认ID为0，实际使用时会被覆盖
+        .device_id = 0,    // 默认ID为0，实际使用时会被覆盖
+        .flags = MEMORY_REGION_LOCKFREE  // 寄存器允许无锁读取
     },
-    // 数据区域
+    // 数据区域（稀疏：只有写入过的页才占用内存）
     {
         .base_addr = FLASH_DATA_START,
         .unit_size = 4,  // 4字节单位
         .length = (FLASH_MEM_SIZE - FLASH_DATA_START) / 4,  // 剩余空间
         .data = NULL,    // 初始化时分配
         .device_type = DEVICE_TYPE_FLASH,
-        .device_id = 0    // 默认ID为0，实际使用时会被覆盖
+        .device_id = 0,   // 默认ID为0，实际使用时会被覆盖
+        .flags = MEMORY_REGION_SPARSE,
+        .fill_value = 0x00
     }
 };
 const int flash_region_count = sizeof(flash_memory_regions) / sizeof(flash_memory_regions[0]);
@@ -35,24 +38,28 @@ int flash_configure_memory(device_instance_t* instance, memory_region_config_t*
         return -1;
     }
     
-    // 销毁现有的内存
-    if (dev_data->memory) {
-        device_memory_destroy(dev_data->memory);
-        dev_data->memory = NULL;
-    }
-    
-    // 创建新的内存
-    dev_data->memory = device_memory_create_from_config(configs, config_count, NULL, DEVICE_TYPE_FLASH, instance->dev_id);
-    if (!dev_data->memory) {
+    // 先创建并初始化新的内存（包括区域索引和页表），再整体替换
+    device_memory_t* memory = device_memory_create_from_config(configs, config_count, NULL, DEVICE_TYPE_FLASH, instance->dev_id);
+    if (!memory) {
         return -1;
     }
     
     // 初始化寄存器
-    device_memory_write(dev_data->memory, FLASH_REG_STATUS, FLASH_STATUS_READY);
-    device_memory_write(dev_data->memory, FLASH_REG_CONFIG, 0);
-    device_memory_write(dev_data->memory, FLASH_REG_ADDRESS, 0);
-    device_memory_write(dev_data->memory, FLASH_REG_DATA, 0);
-    device_memory_write(dev_data->memory, FLASH_REG_SIZE, FLASH_MEM_SIZE);
+    device_memory_write(memory, FLASH_REG_STATUS, FLASH_STATUS_READY);
+    device_memory_write(memory, FLASH_REG_CONFIG, 0);
+    device_memory_write(memory, FLASH_REG_ADDRESS, 0);
+    device_memory_write(memory, FLASH_REG_DATA, 0);
+    device_memory_write(memory, FLASH_REG_SIZE, FLASH_MEM_SIZE);
+    
+    // 在设备锁内切换内存布局，读写方不会看到中间状态
+    pthread_mutex_lock(&dev_data->mutex);
+    device_memory_t* old_memory = dev_data->memory;
+    __atomic_store_n(&dev_data->memory, memory, __ATOMIC_RELEASE);
+    // 无锁读者不获取设备锁，持锁等待它们退出同时使并发的替换互斥
+    device_memory_grace_wait(&dev_data->grace);
+    pthread_mutex_unlock(&dev_data->mutex);
+    
+    device_memory_destroy(old_memory);
     
     return 0;
 } 
\ No newline at end of file
@@ -18,10 +18,15 @@ REGISTER_DEVICE(DEVICE_TYPE_FLASH, "FLASH", get_flash_device_ops);
 static int flash_init(device_instance_t* instance);
 static int flash_read(device_instance_t* instance, uint32_t addr, uint32_t* value);
 static int flash_write(device_instance_t* instance, uint32_t addr, uint32_t value);
+static int flash_read_width(device_instance_t* instance, uint32_t addr, unsigned int width, uint64_t* value);
+static int flash_write_width(device_instance_t* instance, uint32_t addr, unsigned int width, uint64_t value);
+static int flash_readv(device_instance_t* instance, const device_iovec_t* iov, int iovcnt);
+static int flash_writev(device_instance_t* instance, const device_iovec_t* iov, int iovcnt);
 static int flash_reset(device_instance_t* instance);
 static void flash_destroy(device_instance_t* instance);
 static pthread_mutex_t* flash_get_mutex(device_instance_t* instance);
 static struct device_rule_manager* flash_get_rule_manager(device_instance_t* instance);
+static device_memory_t* flash_get_memory(device_instance_t* instance);
 static int flash_configure_memory(device_instance_t* instance, memory_region_config_t* configs, int config_count);
 
 // FLASH设备操作接口实现
@@ -33,7 +38,12 @@ static device_ops_t flash_ops = {
     .destroy = flash_destroy,
     .get_mutex = flash_get_mutex,
     .get_rule_manager = (struct device_rule_manager* (*)(device_instance_t*))flash_get_rule_manager,
-    .configure_memory = flash_configure_memory
+    .get_memory = flash_get_memory,
+    .configure_memory = flash_configure_memory,
+    .read_width = flash_read_width,
+    .write_width = flash_write_width,
+    .readv = flash_readv,
+    .writev = flash_writev
 };
 
 // 获取FLASH设备操作接口
@@ -110,7 +120,15 @@ static int flash_read(device_instance_t* instance, uint32_t addr, uint32_t* valu
     if (!instance || !value) return -1;
     
     flash_device_t* dev_data = (flash_device_t*)instance->priv_data;
-    if (!dev_data || !dev_data->memory) return -1;
+    if (!dev_data || !__atomic_load_n(&dev_data->memory, __ATOMIC_ACQUIRE)) return -1;
+    
+    // 寄存器区域的对齐读取不需要加锁，宽限期内内存不会被configure_memory销毁
+    int token = device_memory_grace_enter(&dev_data->grace);
+    int fast = device_memory_atomic_load32(__atomic_load_n(&dev_data->memory, __ATOMIC_ACQUIRE), addr, value);
+    device_memory_grace_exit(&dev_data->grace, token);
+    if (fast == 0) {
+        return 0;
+    }
     
     pthread_mutex_lock(&dev_data->mutex);
     
@@ -126,8 +144,9 @@ static int flash_write(device_instance_t* instance, uint32_t addr, uint32_t valu
     if (!instance) return -1;
     
     flash_device_t* dev_data = (flash_device_t*)instance->priv_data;
-    if (!dev_data || !dev_data->memory) return -1;
+    if (!dev_data || !__atomic_load_n(&dev_data->memory, __ATOMIC_ACQUIRE)) return -1;
     
+    action_manager_defer_begin();
     pthread_mutex_lock(&dev_data->mutex);
     
     // 处理特殊寄存器
@@ -150,10 +169,73 @@ static int flash_write(device_instance_t* instance, uint32_t addr, uint32_t valu
     // 直接写入内存
     int ret = device_memory_write(dev_data->memory, addr, value);
     
+    pthread_mutex_unlock(&dev_data->mutex);
+    action_manager_defer_end();
+    return ret;
+}
+
+// 按宽度读取FLASH寄存器或数据
+static int flash_read_width(device_instance_t* instance, uint32_t addr, unsigned int width, uint64_t* value) {
+    if (!instance || !value) return -1;
+    
+    flash_device_t* dev_data = (flash_device_t*)instance->priv_data;
+    if (!dev_data || !__atomic_load_n(&dev_data->memory, __ATOMIC_ACQUIRE)) return -1;
+    
+    pthread_mutex_lock(&dev_data->mutex);
+    int ret = device_memory_read_width(dev_data->memory, addr, width, value);
     pthread_mutex_unlock(&dev_data->mutex);
     return ret;
 }
 
+// 按宽度写入FLASH寄存器或数据
+static int flash_write_width(device_instance_t* instance, uint32_t addr, unsigned int width, uint64_t value) {
+    if (!instance) return -1;
+    
+    // 控制寄存器的命令处理只定义了32位写入
+    if (width == sizeof(uint32_t)) {
+        return flash_write(instance, addr, (uint32_t)value);
+    }
+    
+    flash_device_t* dev_data = (flash_device_t*)instance->priv_data;
+    if (!dev_data || !__atomic_load_n(&dev_data->memory, __ATOMIC_ACQUIRE)) return -1;
+    
+    action_manager_defer_begin();
+    pthread_mutex_lock(&dev_data->mutex);
+    int ret = device_memory_write_width(dev_data->memory, addr, width, value);
+    pthread_mutex_unlock(&dev_data->mutex);
+    action_manager_defer_end();
+    return ret;
+}
+
+// 分散读取多个地址段
+static int flash_readv(device_instance_t* instance, const device_iovec_t* iov, int iovcnt) {
+    if (!instance) return -1;
+    
+    flash_device_t* dev_data = (flash_device_t*)instance->priv_data;
+    if (!dev_data || !__atomic_load_n(&dev_data->memory, __ATOMIC_ACQUIRE)) return -1;
+    
+    pthread_mutex_lock(&dev_data->mutex);
+    int ret = device_memory_readv(dev_data->memory, iov, iovcnt);
+    pthread_mutex_unlock(&dev_data->mutex);
+    return ret;
+}
+
+// 聚集写入多个地址段（与批量写入一样不处理控制寄存器命令）
+static int flash_writev(device_instance_t* instance, const device_iovec_t* iov, int iovcnt) {
+    if (!instance) return -1;
+    
+    flash_device_t* dev_data = (flash_device_t*)instance->priv_data;
+    if (!dev_data || !__atomic_load_n(&dev_data->memory, __ATOMIC_ACQUIRE)) return -1;
+    
+    // 与其他写入路径一致：持锁期间匹配的规则在释放锁之后执行
+    action_manager_defer_begin();
+    pthread_mutex_lock(&dev_data->mutex);
+    int ret = device_memory_writev(dev_data->memory, iov, iovcnt);
+    pthread_mutex_unlock(&dev_data->mutex);
+    action_manager_defer_end();
+    return ret;
+}
+
 // 复位FLASH设备
 static int flash_reset(device_instance_t* instance) {
     // 不执行任何操作，保持接口兼容性
@@ -168,13 +250,7 @@ static void flash_destroy(device_instance_t* instance) {
     flash_device_t* dev_data = (flash_device_t*)instance->priv_data;
     if (!dev_data) return;
     
-    // 清理设备规则
-    for (int i = 0; i < dev_data->rule_count; i++) {
-        if (dev_data->device_rules[i].targets) {
-            free(dev_data->device_rules[i].targets);
-            dev_data->device_rules[i].targets = NULL;
-        }
-    }
+    // 设备规则的目标动作位于共享目标池中，不需要释放
     
     // 销毁互斥锁
     pthread_mutex_destroy(&dev_data->mutex);
@@ -195,6 +271,14 @@ static pthread_mutex_t* flash_get_mutex(device_instance_t* instance) {
     return &dev_data->mutex;
 }
 
+// 获取FLASH设备内存
+static device_memory_t* flash_get_memory(device_instance_t* instance) {
+    if (!instance || !instance->priv_data) return NULL;
+    
+    flash_device_t* dev_data = (flash_device_t*)instance->priv_data;
+    return dev_data->memory;
+}
+
 // 获取Flash设备规则管理器
 static struct device_rule_manager* flash_get_rule_manager(device_instance_t* instance) {
     printf("获取Flash设备规则管理器...\n");
@@ -257,24 +341,28 @@ static int flash_configure_memory(device_instance_t* instance, memory_region_con
         return -1;
     }
     
-    // 销毁现有的内存
-    if (dev_data->memory) {
-        device_memory_destroy(dev_data->memory);
-        dev_data->memory = NULL;
-    }
-    
-    // 创建新的内存
-    dev_data->memory = device_memory_create_from_config(configs, config_count, NULL, DEVICE_TYPE_FLASH, instance->dev_id);
-    if (!dev_data->memory) {
+    // 先创建并初始化新的内存（包括区域索引和页表），再整体替换
+    device_memory_t* memory = device_memory_create_from_config(configs, config_count, NULL, DEVICE_TYPE_FLASH, instance->dev_id);
+    if (!memory) {
         return -1;
     }
     
     // 初始化寄存器
-    device_memory_write(dev_data->memory, FLASH_REG_STATUS, FLASH_STATUS_READY);
-    device_memory_write(dev_data->memory, FLASH_REG_CONFIG, 0);
-    device_memory_write(dev_data->memory, FLASH_REG_ADDRESS, 0);
-    device_memory_write(dev_data->memory, FLASH_REG_DATA, 0);
-    device_memory_write(dev_data->memory, FLASH_REG_SIZE, FLASH_MEM_SIZE);
+    device_memory_write(memory, FLASH_REG_STATUS, FLASH_STATUS_READY);
+    device_memory_write(memory, FLASH_REG_CONFIG, 0);
+    device_memory_write(memory, FLASH_REG_ADDRESS, 0);
+    device_memory_write(memory, FLASH_REG_DATA, 0);
+    device_memory_write(memory, FLASH_REG_SIZE, FLASH_MEM_SIZE);
+    
+    // 在设备锁内切换内存布局，读写方不会看到中间状态
+    pthread_mutex_lock(&dev_data->mutex);
+    device_memory_t* old_memory = dev_data->memory;
+    __atomic_store_n(&dev_data->memory, memory, __ATOMIC_RELEASE);
+    // 无锁读者不获取设备锁，持锁等待它们退出同时使并发的替换互斥
+    device_memory_grace_wait(&dev_data->grace);
+    pthread_mutex_unlock(&dev_data->mutex);
+    
+    device_memory_destroy(old_memory);
     
     return 0;
 }
@@ -49,6 +49,7 @@ typedef struct {
     uint32_t address;             // 当前地址
     uint32_t size;                // 设备大小
     pthread_mutex_t mutex;        // 互斥锁
+    device_memory_grace_t grace;  // 无锁读取内存指针的宽限期
     
     // 设备特定规则
     device_rule_t device_rules[8];    // 支持最多8个内置规则
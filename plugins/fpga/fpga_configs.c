@@ -14,7 +14,8 @@ const memory_region_t fpga_memory_regions[] = {
         .length = 16,    // 16个寄存器
         .data = NULL,    // 初始化时分配
         .device_type = DEVICE_TYPE_FPGA,
-        .device_id = 0    // 默认ID为0，实际使用时会被覆盖
+        .device_id = 0,    // 默认ID为0，实际使用时会被覆盖
+        .flags = MEMORY_REGION_LOCKFREE  // 寄存器允许无锁读取
     },
     // 配置区域
     {
@@ -46,7 +46,8 @@ static const memory_region_t fpga_memory_regions[] = {
         .length = 16,    // 16个寄存器
         .data = NULL,    // 初始化时分配
         .device_type = DEVICE_TYPE_FPGA,
-        .device_id = 0   // 默认ID为0，实际使用时会被覆盖
+        .device_id = 0,   // 默认ID为0，实际使用时会被覆盖
+        .flags = MEMORY_REGION_LOCKFREE  // 寄存器允许无锁读取
     },
     // 配置区域
     {
@@ -91,6 +92,14 @@ struct device_rule_manager* fpga_get_rule_manager(device_instance_t* instance) {
     return &dev_data->rule_manager;
 }
 
+// 获取FPGA设备内存
+device_memory_t* fpga_get_memory(device_instance_t* instance) {
+    if (!instance || !instance->priv_data) return NULL;
+    
+    fpga_device_t* dev_data = (fpga_device_t*)instance->priv_data;
+    return dev_data->memory;
+}
+
 // 获取FPGA设备操作接口
 device_ops_t* get_fpga_device_ops(void) {
     static device_ops_t ops = {
@@ -103,7 +112,12 @@ device_ops_t* get_fpga_device_ops(void) {
         .reset = fpga_device_reset,
         .get_mutex = fpga_get_mutex,
         .get_rule_manager = fpga_get_rule_manager,
-        .configure_memory = fpga_configure_memory
+        .get_memory = fpga_get_memory,
+        .configure_memory = fpga_configure_memory,
+        .read_width = fpga_device_read_width,
+        .write_width = fpga_device_write_width,
+        .readv = fpga_device_readv,
+        .writev = fpga_device_writev
     };
     return &ops;
 }
@@ -173,7 +187,15 @@ int fpga_device_read(device_instance_t* instance, uint32_t addr, uint32_t* value
     if (!instance || !value) return -1;
     
     fpga_device_t* dev_data = (fpga_device_t*)instance->priv_data;
-    if (!dev_data || !dev_data->memory) return -1;
+    if (!dev_data || !__atomic_load_n(&dev_data->memory, __ATOMIC_ACQUIRE)) return -1;
+    
+    // 寄存器区域的对齐读取不需要加锁，宽限期内内存不会被configure_memory销毁
+    int token = device_memory_grace_enter(&dev_data->grace);
+    int fast = device_memory_atomic_load32(__atomic_load_n(&dev_data->memory, __ATOMIC_ACQUIRE), addr, value);
+    device_memory_grace_exit(&dev_data->grace, token);
+    if (fast == 0) {
+        return 0;
+    }
     
     pthread_mutex_lock(&dev_data->mutex);
     
@@ -189,34 +211,88 @@ int fpga_device_write(device_instance_t* instance, uint32_t addr, uint32_t value
     if (!instance) return -1;
     
     fpga_device_t* dev_data = (fpga_device_t*)instance->priv_data;
-    if (!dev_data || !dev_data->memory) return -1;
+    if (!dev_data || !__atomic_load_n(&dev_data->memory, __ATOMIC_ACQUIRE)) return -1;
     
+    action_manager_defer_begin();
     pthread_mutex_lock(&dev_data->mutex);
     
     // 直接写入内存，不再处理特殊寄存器
     int ret = device_memory_write(dev_data->memory, addr, value);
     
+    pthread_mutex_unlock(&dev_data->mutex);
+    action_manager_defer_end();
+    return ret;
+}
+
+// 按宽度读取FPGA寄存器或数据（一次加锁完成8/16/64位访问）
+int fpga_device_read_width(device_instance_t* instance, uint32_t addr, unsigned int width, uint64_t* value) {
+    if (!instance || !value) return -1;
+    
+    fpga_device_t* dev_data = (fpga_device_t*)instance->priv_data;
+    if (!dev_data || !__atomic_load_n(&dev_data->memory, __ATOMIC_ACQUIRE)) return -1;
+    
+    pthread_mutex_lock(&dev_data->mutex);
+    int ret = device_memory_read_width(dev_data->memory, addr, width, value);
     pthread_mutex_unlock(&dev_data->mutex);
     return ret;
 }
 
+// 按宽度写入FPGA寄存器或数据
+int fpga_device_write_width(device_instance_t* instance, uint32_t addr, unsigned int width, uint64_t value) {
+    if (!instance) return -1;
+    
+    fpga_device_t* dev_data = (fpga_device_t*)instance->priv_data;
+    if (!dev_data || !__atomic_load_n(&dev_data->memory, __ATOMIC_ACQUIRE)) return -1;
+    
+    action_manager_defer_begin();
+    pthread_mutex_lock(&dev_data->mutex);
+    int ret = device_memory_write_width(dev_data->memory, addr, width, value);
+    pthread_mutex_unlock(&dev_data->mutex);
+    action_manager_defer_end();
+    return ret;
+}
+
+// 分散读取多个地址段
+int fpga_device_readv(device_instance_t* instance, const device_iovec_t* iov, int iovcnt) {
+    if (!instance) return -1;
+    
+    fpga_device_t* dev_data = (fpga_device_t*)instance->priv_data;
+    if (!dev_data || !__atomic_load_n(&dev_data->memory, __ATOMIC_ACQUIRE)) return -1;
+    
+    pthread_mutex_lock(&dev_data->mutex);
+    int ret = device_memory_readv(dev_data->memory, iov, iovcnt);
+    pthread_mutex_unlock(&dev_data->mutex);
+    return ret;
+}
+
+// 聚集写入多个地址段
+int fpga_device_writev(device_instance_t* instance, const device_iovec_t* iov, int iovcnt) {
+    if (!instance) return -1;
+    
+    fpga_device_t* dev_data = (fpga_device_t*)instance->priv_data;
+    if (!dev_data || !__atomic_load_n(&dev_data->memory, __ATOMIC_ACQUIRE)) return -1;
+    
+    // 与其他写入路径一致：持锁期间匹配的规则在释放锁之后执行
+    action_manager_defer_begin();
+    pthread_mutex_lock(&dev_data->mutex);
+    int ret = device_memory_writev(dev_data->memory, iov, iovcnt);
+    pthread_mutex_unlock(&dev_data->mutex);
+    action_manager_defer_end();
+    return ret;
+}
+
 // 读取缓冲区
 int fpga_device_read_buffer(device_instance_t* instance, uint32_t addr, uint8_t* buffer, size_t length) {
     if (!instance || !buffer) return -1;
     
     fpga_device_t* dev_data = (fpga_device_t*)instance->priv_data;
-    if (!dev_data || !dev_data->memory) return -1;
-    
-    // 简单实现，每次读取一个字节
-    for (size_t i = 0; i < length; i++) {
-        uint32_t value;
-        if (fpga_device_read(instance, addr + i, &value) != 0) {
-            return -1;
-        }
-        buffer[i] = (uint8_t)value;
-    }
+    if (!dev_data || !__atomic_load_n(&dev_data->memory, __ATOMIC_ACQUIRE)) return -1;
     
-    return 0;
+    // 一次加锁完成整段读取，可以跨越配置区和数据区
+    pthread_mutex_lock(&dev_data->mutex);
+    int ret = device_memory_read_buffer(dev_data->memory, addr, buffer, length);
+    pthread_mutex_unlock(&dev_data->mutex);
+    return ret;
 }
 
 // 写入缓冲区
@@ -224,16 +300,20 @@ int fpga_device_write_buffer(device_instance_t* instance, uint32_t addr, const u
     if (!instance || !buffer) return -1;
     
     fpga_device_t* dev_data = (fpga_device_t*)instance->priv_data;
-    if (!dev_data || !dev_data->memory) return -1;
+    if (!dev_data || !__atomic_load_n(&dev_data->memory, __ATOMIC_ACQUIRE)) return -1;
     
-    // 简单实现，每次写入一个字节
+    // 简单实现，每次写入一个字节；各字节匹配的规则在整段写完后按顺序执行
+    int ret = 0;
+    action_manager_defer_begin();
     for (size_t i = 0; i < length; i++) {
         if (fpga_device_write(instance, addr + i, buffer[i]) != 0) {
-            return -1;
+            ret = -1;
+            break;
         }
     }
+    action_manager_defer_end();
     
-    return 0;
+    return ret;
 }
 
 // 复位FPGA设备
@@ -241,8 +321,9 @@ int fpga_device_reset(device_instance_t* instance) {
     if (!instance) return -1;
     
     fpga_device_t* dev_data = (fpga_device_t*)instance->priv_data;
-    if (!dev_data || !dev_data->memory) return -1;
+    if (!dev_data || !__atomic_load_n(&dev_data->memory, __ATOMIC_ACQUIRE)) return -1;
     
+    action_manager_defer_begin();
     pthread_mutex_lock(&dev_data->mutex);
     
     // 写入复位命令到配置寄存器
@@ -250,6 +331,7 @@ int fpga_device_reset(device_instance_t* instance) {
     int ret = device_memory_write(dev_data->memory, FPGA_CONFIG_REG, config);
     
     pthread_mutex_unlock(&dev_data->mutex);
+    action_manager_defer_end();
     return ret;
 }
 
@@ -278,9 +360,6 @@ int fpga_configure_memory(device_instance_t* instance, memory_region_config_t* c
     fpga_device_t* dev_data = (fpga_device_t*)instance->priv_data;
     if (!dev_data) return -1;
     
-    // 重新配置内存区域
-    device_memory_destroy(dev_data->memory);
-    
     // 转换配置为内存区域
     memory_region_t* regions = (memory_region_t*)malloc(config_count * sizeof(memory_region_t));
     if (!regions) return -1;
@@ -292,9 +371,15 @@ int fpga_configure_memory(device_instance_t* instance, memory_region_config_t* c
         regions[i].data = NULL;
         regions[i].device_type = DEVICE_TYPE_FPGA;
         regions[i].device_id = instance->dev_id;
+        regions[i].flags = configs[i].flags;
+        regions[i].fill_value = configs[i].fill_value;
+        regions[i].pages = NULL;
+        regions[i].resident_pages = 0;
+        regions[i].backing_file = configs[i].backing_file;
     }
     
-    dev_data->memory = device_memory_create(
+    // 先创建新的内存（包括区域索引和页表），再整体替换
+    device_memory_t* memory = device_memory_create(
         regions, 
         config_count, 
         NULL, 
@@ -303,7 +388,18 @@ int fpga_configure_memory(device_instance_t* instance, memory_region_config_t* c
     );
     
     free(regions);
-    return dev_data->memory ? 0 : -1;
+    if (!memory) return -1;
+    
+    // 在设备锁内切换内存布局，读写方不会看到中间状态
+    pthread_mutex_lock(&dev_data->mutex);
+    device_memory_t* old_memory = dev_data->memory;
+    __atomic_store_n(&dev_data->memory, memory, __ATOMIC_RELEASE);
+    // 无锁读者不获取设备锁，持锁等待它们退出同时使并发的替换互斥
+    device_memory_grace_wait(&dev_data->grace);
+    pthread_mutex_unlock(&dev_data->mutex);
+    
+    device_memory_destroy(old_memory);
+    return 0;
 }
 
 // 向FPGA设备添加规则
@@ -45,6 +45,7 @@ typedef struct {
     device_instance_t base;       // 基础设备实例
     device_memory_t* memory;      // 设备内存
     pthread_mutex_t mutex;        // 互斥锁
+    device_memory_grace_t grace;  // 无锁读取内存指针的宽限期
     pthread_t worker_thread;      // 工作线程
     int running;                  // 线程运行标志
     
@@ -67,10 +68,15 @@ int fpga_device_init(device_instance_t* instance);
 void fpga_device_destroy(device_instance_t* instance);
 int fpga_device_read(device_instance_t* instance, uint32_t addr, uint32_t* value);
 int fpga_device_write(device_instance_t* instance, uint32_t addr, uint32_t value);
+int fpga_device_read_width(device_instance_t* instance, uint32_t addr, unsigned int width, uint64_t* value);
+int fpga_device_write_width(device_instance_t* instance, uint32_t addr, unsigned int width, uint64_t value);
+int fpga_device_readv(device_instance_t* instance, const device_iovec_t* iov, int iovcnt);
+int fpga_device_writev(device_instance_t* instance, const device_iovec_t* iov, int iovcnt);
 int fpga_device_read_buffer(device_instance_t* instance, uint32_t addr, uint8_t* buffer, size_t length);
 int fpga_device_write_buffer(device_instance_t* instance, uint32_t addr, const uint8_t* buffer, size_t length);
 int fpga_device_reset(device_instance_t* instance);
 struct device_rule_manager* fpga_get_rule_manager(device_instance_t* instance);
+device_memory_t* fpga_get_memory(device_instance_t* instance);
 int fpga_configure_memory(device_instance_t* instance, memory_region_config_t* configs, int config_count);
 
 // 回调函数
@@ -174,11 +174,21 @@ int temp_sensor_read(device_instance_t* instance, uint32_t addr, uint32_t* value
         return -1;
     }
     
-    if (!dev_data->memory) {
+    if (!__atomic_load_n(&dev_data->memory, __ATOMIC_ACQUIRE)) {
         printf("DEBUG: temp_sensor_read - 无效设备内存: memory为NULL\n");
         return -1;
     }
     
+    // 寄存器区域的对齐读取不需要加锁，宽限期内内存不会被configure_memory销毁
+    int token = device_memory_grace_enter(&dev_data->grace);
+    int fast = device_memory_atomic_load32(__atomic_load_n(&dev_data->memory, __ATOMIC_ACQUIRE), addr, value);
+    device_memory_grace_exit(&dev_data->grace, token);
+    if (fast == 0) {
+        return 0;
+    }
+    
+    pthread_mutex_lock(&dev_data->mutex);
+    
     printf("DEBUG: temp_sensor_read - 温度传感器设备: ID=%d, memory=%p, region_count=%d\n",
            instance->dev_id, dev_data->memory, dev_data->memory->region_count);
     
@@ -186,6 +196,7 @@ int temp_sensor_read(device_instance_t* instance, uint32_t addr, uint32_t* value
     if (dev_data->memory->region_count <= 0 || !dev_data->memory->regions) {
         printf("严重错误: temp_sensor_read - 内存区域无效: region_count=%d, regions=%p\n",
               dev_data->memory->region_count, (void*)dev_data->memory->regions);
+        pthread_mutex_unlock(&dev_data->mutex);
         return -1;
     }
     
@@ -195,9 +206,10 @@ int temp_sensor_read(device_instance_t* instance, uint32_t addr, uint32_t* value
         printf("DEBUG: temp_sensor_read - 区域[%d]: 基址=0x%08X, 单位大小=%zu, 长度=%zu, 数据指针=%p\n",
                i, region->base_addr, region->unit_size, region->length, region->data);
         
-        // 检查数据指针有效性
-        if (!region->data) {
+        // 检查数据指针有效性（稀疏区域使用页指针数组）
+        if (!region->data && !region->pages) {
             printf("严重错误: temp_sensor_read - 区域[%d]的数据指针为NULL\n", i);
+            pthread_mutex_unlock(&dev_data->mutex);
             return -1;
         }
         
@@ -207,8 +219,6 @@ int temp_sensor_read(device_instance_t* instance, uint32_t addr, uint32_t* value
         }
     }
     
-    pthread_mutex_lock(&dev_data->mutex);
-    
     // 直接从内存读取数据
     printf("DEBUG: temp_sensor_read - 准备读取地址 0x%08X\n", addr);
     int ret = device_memory_read(dev_data->memory, addr, value);
@@ -229,12 +239,14 @@ int temp_sensor_write(device_instance_t* instance, uint32_t addr, uint32_t value
     }
     
     temp_sensor_device_t* dev_data = (temp_sensor_device_t*)instance->priv_data;
-    if (!dev_data || !dev_data->memory) {
-        printf("DEBUG: temp_sensor_write - 无效设备数据: dev_data=%p, memory=%p\n", 
-               dev_data, dev_data ? dev_data->memory : NULL);
+    if (!dev_data || !__atomic_load_n(&dev_data->memory, __ATOMIC_ACQUIRE)) {
+        printf("DEBUG: temp_sensor_write - 无效设备数据: dev_data=%p\n", dev_data);
         return -1;
     }
     
+    action_manager_defer_begin();
+    pthread_mutex_lock(&dev_data->mutex);
+    
     printf("DEBUG: temp_sensor_write - 温度传感器设备: ID=%d, memory=%p, region_count=%d\n",
            instance->dev_id, dev_data->memory, dev_data->memory->region_count);
            
@@ -242,6 +254,8 @@ int temp_sensor_write(device_instance_t* instance, uint32_t addr, uint32_t value
     if (dev_data->memory->region_count <= 0 || !dev_data->memory->regions) {
         printf("严重错误: temp_sensor_write - 内存区域无效: region_count=%d, regions=%p\n",
               dev_data->memory->region_count, (void*)dev_data->memory->regions);
+        pthread_mutex_unlock(&dev_data->mutex);
+        action_manager_defer_end();
         return -1;
     }
     
@@ -251,9 +265,11 @@ int temp_sensor_write(device_instance_t* instance, uint32_t addr, uint32_t value
         printf("DEBUG: temp_sensor_write - 区域[%d]: 基址=0x%08X, 单位大小=%zu, 长度=%zu, 数据指针=%p\n",
                i, region->base_addr, region->unit_size, region->length, region->data);
         
-        // 检查数据指针有效性
-        if (!region->data) {
+        // 检查数据指针有效性（稀疏区域使用页指针数组）
+        if (!region->data && !region->pages) {
             printf("严重错误: temp_sensor_write - 区域[%d]的数据指针为NULL\n", i);
+            pthread_mutex_unlock(&dev_data->mutex);
+            action_manager_defer_end();
             return -1;
         }
         
@@ -263,8 +279,6 @@ int temp_sensor_write(device_instance_t* instance, uint32_t addr, uint32_t value
         }
     }
     
-    pthread_mutex_lock(&dev_data->mutex);
-    
     // 写入设备内存
     printf("DEBUG: temp_sensor_write - 开始写入地址 0x%08X, 值=0x%08X, 内存指针=%p\n", 
            addr, value, dev_data->memory);
@@ -272,6 +286,64 @@ int temp_sensor_write(device_instance_t* instance, uint32_t addr, uint32_t value
     printf("DEBUG: temp_sensor_write - 写入完成，返回值=%d\n", ret);
     
     pthread_mutex_unlock(&dev_data->mutex);
+    action_manager_defer_end();
+    return ret;
+}
+
+// 按宽度读取温度传感器寄存器
+int temp_sensor_read_width(device_instance_t* instance, uint32_t addr, unsigned int width, uint64_t* value) {
+    if (!instance || !value) return -1;
+    
+    temp_sensor_device_t* dev_data = (temp_sensor_device_t*)instance->priv_data;
+    if (!dev_data || !__atomic_load_n(&dev_data->memory, __ATOMIC_ACQUIRE)) return -1;
+    
+    pthread_mutex_lock(&dev_data->mutex);
+    int ret = device_memory_read_width(dev_data->memory, addr, width, value);
+    pthread_mutex_unlock(&dev_data->mutex);
+    return ret;
+}
+
+// 按宽度写入温度传感器寄存器
+int temp_sensor_write_width(device_instance_t* instance, uint32_t addr, unsigned int width, uint64_t value) {
+    if (!instance) return -1;
+    
+    temp_sensor_device_t* dev_data = (temp_sensor_device_t*)instance->priv_data;
+    if (!dev_data || !__atomic_load_n(&dev_data->memory, __ATOMIC_ACQUIRE)) return -1;
+    
+    action_manager_defer_begin();
+    pthread_mutex_lock(&dev_data->mutex);
+    int ret = device_memory_write_width(dev_data->memory, addr, width, value);
+    pthread_mutex_unlock(&dev_data->mutex);
+    action_manager_defer_end();
+    return ret;
+}
+
+// 分散读取多个寄存器段
+int temp_sensor_readv(device_instance_t* instance, const device_iovec_t* iov, int iovcnt) {
+    if (!instance) return -1;
+    
+    temp_sensor_device_t* dev_data = (temp_sensor_device_t*)instance->priv_data;
+    if (!dev_data || !__atomic_load_n(&dev_data->memory, __ATOMIC_ACQUIRE)) return -1;
+    
+    pthread_mutex_lock(&dev_data->mutex);
+    int ret = device_memory_readv(dev_data->memory, iov, iovcnt);
+    pthread_mutex_unlock(&dev_data->mutex);
+    return ret;
+}
+
+// 聚集写入多个寄存器段
+int temp_sensor_writev(device_instance_t* instance, const device_iovec_t* iov, int iovcnt) {
+    if (!instance) return -1;
+    
+    temp_sensor_device_t* dev_data = (temp_sensor_device_t*)instance->priv_data;
+    if (!dev_data || !__atomic_load_n(&dev_data->memory, __ATOMIC_ACQUIRE)) return -1;
+    
+    // 与其他写入路径一致：持锁期间匹配的规则在释放锁之后执行
+    action_manager_defer_begin();
+    pthread_mutex_lock(&dev_data->mutex);
+    int ret = device_memory_writev(dev_data->memory, iov, iovcnt);
+    pthread_mutex_unlock(&dev_data->mutex);
+    action_manager_defer_end();
     return ret;
 }
 
@@ -280,7 +352,7 @@ int temp_sensor_read_buffer(device_instance_t* instance, uint32_t addr, uint8_t*
     if (!instance || !buffer) return -1;
     
     temp_sensor_device_t* dev_data = (temp_sensor_device_t*)instance->priv_data;
-    if (!dev_data || !dev_data->memory) return -1;
+    if (!dev_data || !__atomic_load_n(&dev_data->memory, __ATOMIC_ACQUIRE)) return -1;
     
     // 简单实现，每次读取一个字节
     for (size_t i = 0; i < length; i++) {
@@ -299,16 +371,20 @@ int temp_sensor_write_buffer(device_instance_t* instance, uint32_t addr, const u
     if (!instance || !buffer) return -1;
     
     temp_sensor_device_t* dev_data = (temp_sensor_device_t*)instance->priv_data;
-    if (!dev_data || !dev_data->memory) return -1;
+    if (!dev_data || !__atomic_load_n(&dev_data->memory, __ATOMIC_ACQUIRE)) return -1;
     
-    // 简单实现，每次写入一个字节
+    // 简单实现，每次写入一个字节；各字节匹配的规则在整段写完后按顺序执行
+    int ret = 0;
+    action_manager_defer_begin();
     for (size_t i = 0; i < length; i++) {
         if (temp_sensor_write(instance, addr + i, buffer[i]) != 0) {
-            return -1;
+            ret = -1;
+            break;
         }
     }
+    action_manager_defer_end();
     
-    return 0;
+    return ret;
 }
 
 // 复位温度传感器
@@ -356,12 +432,6 @@ int temp_sensor_configure_memory(device_instance_t* instance, memory_region_conf
     temp_sensor_device_t* dev_data = (temp_sensor_device_t*)instance->priv_data;
     if (!dev_data) return -1;
     
-    // 销毁现有内存
-    if (dev_data->memory) {
-        device_memory_destroy(dev_data->memory);
-        dev_data->memory = NULL;
-    }
-    
     // 创建新的内存区域
     memory_region_t* regions = (memory_region_t*)malloc(config_count * sizeof(memory_region_t));
     if (!regions) return -1;
@@ -374,10 +444,15 @@ int temp_sensor_configure_memory(device_instance_t* instance, memory_region_conf
         regions[i].data = NULL;
         regions[i].device_type = DEVICE_TYPE_TEMP_SENSOR;
         regions[i].device_id = instance->dev_id;
+        regions[i].flags = configs[i].flags;
+        regions[i].fill_value = configs[i].fill_value;
+        regions[i].pages = NULL;
+        regions[i].resident_pages = 0;
+        regions[i].backing_file = configs[i].backing_file;
     }
     
-    // 创建新的设备内存
-    dev_data->memory = device_memory_create(
+    // 先创建新的设备内存（包括区域索引和页表），再整体替换
+    device_memory_t* memory = device_memory_create(
         regions, 
         config_count, 
         NULL, 
@@ -387,7 +462,19 @@ int temp_sensor_configure_memory(device_instance_t* instance, memory_region_conf
     
     free(regions);
     
-    return (dev_data->memory) ? 0 : -1;
+    if (!memory) return -1;
+    
+    // 在设备锁内切换内存布局，读写方不会看到中间状态
+    pthread_mutex_lock(&dev_data->mutex);
+    device_memory_t* old_memory = dev_data->memory;
+    __atomic_store_n(&dev_data->memory, memory, __ATOMIC_RELEASE);
+    // 无锁读者不获取设备锁，持锁等待它们退出同时使并发的替换互斥
+    device_memory_grace_wait(&dev_data->grace);
+    pthread_mutex_unlock(&dev_data->mutex);
+    
+    device_memory_destroy(old_memory);
+    
+    return 0;
 }
 
 // 获取温度传感器操作接口
@@ -403,7 +490,11 @@ device_ops_t* get_temp_sensor_ops(void) {
         .get_mutex = temp_sensor_get_mutex,
         .get_rule_manager = temp_sensor_get_rule_manager,
         .get_memory = temp_sensor_get_memory,
-        .configure_memory = temp_sensor_configure_memory
+        .configure_memory = temp_sensor_configure_memory,
+        .read_width = temp_sensor_read_width,
+        .write_width = temp_sensor_write_width,
+        .readv = temp_sensor_readv,
+        .writev = temp_sensor_writev
     };
     
     return &ops;
@@ -435,6 +526,13 @@ int temp_sensor_add_rule(device_instance_t* instance, uint32_t addr,
         return -1;
     }
     
+    // 目标动作放入共享目标池
+    action_target_ref_t ref;
+    if (action_target_pool_intern(targets->targets, targets->count, &ref) != 0) {
+        printf("DEBUG: temp_sensor_add_rule - 目标动作放入目标池失败\n");
+        return -1;
+    }
+    
     // 添加新规则
     device_rule_t* rule = &dev_data->device_rules[dev_data->rule_count];
     rule->addr = addr;
@@ -452,8 +550,7 @@ int temp_sensor_add_rule(device_instance_t* instance, uint32_t addr,
                target->target_addr, target->target_value, target->target_mask);
     }
     
-    // 复制目标数组
-    memcpy(&rule->targets, targets, sizeof(action_target_array_t));
+    rule->targets = ref;
     
     // 保存规则ID并递增计数器
     int rule_id = dev_data->rule_count;
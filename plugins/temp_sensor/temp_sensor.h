@@ -36,6 +36,7 @@ typedef struct {
     device_instance_t base;       // 基础设备实例
     device_memory_t* memory;      // 设备内存
     pthread_mutex_t mutex;        // 互斥锁
+    device_memory_grace_t grace;  // 无锁读取内存指针的宽限期
     
     // 设备特定规则
     device_rule_t device_rules[8];    // 支持最多8个内置规则
@@ -59,6 +60,10 @@ int temp_sensor_init(device_instance_t* instance);
 void temp_sensor_destroy(device_instance_t* instance);
 int temp_sensor_read(device_instance_t* instance, uint32_t addr, uint32_t* value);
 int temp_sensor_write(device_instance_t* instance, uint32_t addr, uint32_t value);
+int temp_sensor_read_width(device_instance_t* instance, uint32_t addr, unsigned int width, uint64_t* value);
+int temp_sensor_write_width(device_instance_t* instance, uint32_t addr, unsigned int width, uint64_t value);
+int temp_sensor_readv(device_instance_t* instance, const device_iovec_t* iov, int iovcnt);
+int temp_sensor_writev(device_instance_t* instance, const device_iovec_t* iov, int iovcnt);
 int temp_sensor_read_buffer(device_instance_t* instance, uint32_t addr, uint8_t* buffer, size_t length);
 int temp_sensor_write_buffer(device_instance_t* instance, uint32_t addr, const uint8_t* buffer, size_t length);
 int temp_sensor_reset(device_instance_t* instance);
@@ -10,7 +10,8 @@ const memory_region_t temp_sensor_memory_regions[] = {
         .length = 8,     // 8个寄存器
         .data = NULL,    // 初始化时分配
         .device_type = DEVICE_TYPE_TEMP_SENSOR,
-        .device_id = 0    // 默认ID为0，实际使用时会被覆盖
+        .device_id = 0,    // 默认ID为0，实际使用时会被覆盖
+        .flags = MEMORY_REGION_LOCKFREE  // 寄存器允许无锁读取
     },
     // 数据区域
     {
@@ -1,8 +1,17 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/time.h>
+#include <time.h>
 #include "device_memory.h"
 #include "device_rule_configs.h"
 #include "action_manager.h"
@@ -11,515 +20,2819 @@
 extern device_manager_t* g_device_manager;
 extern action_manager_t* g_action_manager;
 
-// 查找地址所在的内存区域
-memory_region_t* device_memory_find_region(device_memory_t* mem, uint32_t addr) {
-    if (!mem || !mem->regions || mem->region_count <= 0) {
-        printf("错误: device_memory_find_region - 无效的内存对象或内存区域数组，mem=%p, regions=%p, region_count=%d\n", 
-              (void*)mem, mem ? (void*)mem->regions : NULL, mem ? mem->region_count : 0);
-        return NULL;
+// 全局写入事件队列，NULL时写入者同步检查规则
+static write_event_queue_t* g_write_events = NULL;
+static write_event_handler_t g_write_event_tap = NULL;
+static void* g_write_event_tap_context = NULL;
+
+// 计算区域的最后一个字节地址（包含），用64位运算避免越界回绕
+static uint32_t region_last_addr(const memory_region_t* region) {
+    uint64_t size = (uint64_t)region->unit_size * region->length;
+    return (uint32_t)(region->base_addr + size - 1);
+}
+
+// 按基地址排序的比较函数
+static int region_compare_base(const void* a, const void* b) {
+    const memory_region_t* ra = (const memory_region_t*)a;
+    const memory_region_t* rb = (const memory_region_t*)b;
+    if (ra->base_addr < rb->base_addr) return -1;
+    if (ra->base_addr > rb->base_addr) return 1;
+    return 0;
+}
+
+// 区域数据总字节数
+static size_t region_size(const memory_region_t* region) {
+    return region->unit_size * region->length;
+}
+
+// 区域按DEVICE_MEMORY_PAGE_SIZE划分的页数
+static size_t region_page_count(const memory_region_t* region) {
+    return (region_size(region) + DEVICE_MEMORY_PAGE_SIZE - 1) >> DEVICE_MEMORY_PAGE_SHIFT;
+}
+
+// 稀疏页头：引用计数位于页数据之前，快照与设备内存通过引用计数共享页
+typedef struct {
+    uint32_t refcount;        // 引用计数
+    uint32_t reserved[3];     // 保持页数据16字节对齐
+} page_header_t;
+
+#define PAGE_HEADER(page) ((page_header_t*)((page) - sizeof(page_header_t)))
+
+// 分配一个稀疏页，src不为NULL时复制其内容，否则以填充值初始化
+static uint8_t* page_alloc(const uint8_t* src, uint8_t fill_value) {
+    page_header_t* header = (page_header_t*)malloc(sizeof(page_header_t) + DEVICE_MEMORY_PAGE_SIZE);
+    if (!header) return NULL;
+    
+    header->refcount = 1;
+    uint8_t* page = (uint8_t*)(header + 1);
+    if (src) {
+        memcpy(page, src, DEVICE_MEMORY_PAGE_SIZE);
+    } else {
+        memset(page, fill_value, DEVICE_MEMORY_PAGE_SIZE);
+    }
+    return page;
+}
+
+// 增加页引用（快照可能被恢复到不同设备，使用原子操作）
+static void page_ref(uint8_t* page) {
+    __atomic_add_fetch(&PAGE_HEADER(page)->refcount, 1, __ATOMIC_RELAXED);
+}
+
+// 释放页引用，最后一个引用释放页
+static void page_unref(uint8_t* page) {
+    if (page && __atomic_sub_fetch(&PAGE_HEADER(page)->refcount, 1, __ATOMIC_ACQ_REL) == 0) {
+        free(PAGE_HEADER(page));
+    }
+}
+
+// 页是否被快照共享
+static int page_is_shared(uint8_t* page) {
+    return __atomic_load_n(&PAGE_HEADER(page)->refcount, __ATOMIC_ACQUIRE) > 1;
+}
+
+// 标记脏页（检查点线程可能并发取走位图，使用原子或）
+static inline void region_mark_dirty_page(memory_region_t* region, size_t page) {
+    __atomic_fetch_or(&region->dirty[page / 64], 1ULL << (page % 64), __ATOMIC_RELEASE);
+}
+
+/**
+ * 记录 [offset, offset+len) 被写入
+ * 
+ * 更新脏页位图；普通区域还会记录快照之后写入过的页，恢复时只复制这些页。
+ */
+static inline void region_mark_written(memory_region_t* region, size_t offset, size_t len) {
+    size_t first = offset >> DEVICE_MEMORY_PAGE_SHIFT;
+    size_t last = (offset + len - 1) >> DEVICE_MEMORY_PAGE_SHIFT;
+    for (size_t page = first; page <= last; page++) {
+        region_mark_dirty_page(region, page);
+        if (region->snap_touched) {
+            __atomic_fetch_or(&region->snap_touched[page / 64], 1ULL << (page % 64), __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/**
+ * 将文件映射为区域数据
+ * 
+ * MAP_SHARED：文件不足区域大小时扩展文件，写入直接落到文件页缓存中。
+ * MAP_PRIVATE：文件只读打开，写入触发写时复制，文件内容保持不变；
+ * 文件不足区域大小时先保留匿名映射，再把文件覆盖映射到开头。
+ * 两种方式下数据都在首次访问时按页加载。
+ * 
+ * @param region 内存区域
+ * @return 成功返回0，失败返回-1
+ */
+static int region_map_file(memory_region_t* region) {
+    size_t size = region_size(region);
+    int shared = (region->flags & MEMORY_REGION_FILE_SHARED) != 0;
+    
+    if (!region->backing_file) {
+        printf("错误: 区域 0x%08X 设置了文件映射标志但未指定文件\n", region->base_addr);
+        return -1;
+    }
+    
+    int fd = open(region->backing_file, shared ? (O_RDWR | O_CREAT) : O_RDONLY, 0644);
+    if (fd < 0) {
+        printf("错误: 无法打开映射文件 %s: %s\n", region->backing_file, strerror(errno));
+        return -1;
+    }
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        printf("错误: 无法获取映射文件 %s 的大小: %s\n", region->backing_file, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    size_t file_size = (size_t)st.st_size;
+    
+    void* addr = MAP_FAILED;
+    if (shared) {
+        if (file_size < size && ftruncate(fd, (off_t)size) != 0) {
+            printf("错误: 无法扩展映射文件 %s: %s\n", region->backing_file, strerror(errno));
+            close(fd);
+            return -1;
+        }
+        addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    } else {
+        addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (addr != MAP_FAILED && file_size > 0) {
+            size_t file_map = file_size < size ? file_size : size;
+            if (mmap(addr, file_map, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+                munmap(addr, size);
+                addr = MAP_FAILED;
+            }
+        }
+    }
+    close(fd);
+    
+    if (addr == MAP_FAILED) {
+        printf("错误: 无法映射文件 %s: %s\n", region->backing_file, strerror(errno));
+        return -1;
+    }
+    
+    region->data = (uint8_t*)addr;
+    
+    // 文件中不存在的部分使用填充值
+    if (file_size < size && region->fill_value != 0) {
+        memset(region->data + file_size, region->fill_value, size - file_size);
+    }
+    return 0;
+}
+
+// 按slab对齐粒度向上取整
+static size_t slab_align(size_t bytes) {
+    return (bytes + DEVICE_MEMORY_SLAB_ALIGN - 1) & ~(size_t)(DEVICE_MEMORY_SLAB_ALIGN - 1);
+}
+
+// 区域脏页位图字数
+static size_t region_dirty_words(const memory_region_t* region) {
+    return (region_page_count(region) + 63) / 64;
+}
+
+// 区域脏页位图在slab中占用的字节数
+static size_t region_dirty_bytes(const memory_region_t* region) {
+    return region_dirty_words(region) * sizeof(uint64_t);
+}
+
+/**
+ * 计算区域数据在slab中占用的字节数
+ * 
+ * 稀疏区域为页指针数组，普通区域为全部数据，按缓存行对齐；
+ * 文件映射区域的数据是映射地址，不在slab中。
+ */
+static size_t region_slab_bytes(const memory_region_t* region) {
+    if (region->flags & MEMORY_REGION_FILE_MASK) {
+        return 0;
+    }
+    if (region->flags & MEMORY_REGION_SPARSE) {
+        return slab_align(region_page_count(region) * sizeof(uint8_t*));
+    }
+    return slab_align(region_size(region));
+}
+
+/**
+ * 从slab中为区域分配数据存储和脏页位图
+ * 
+ * 普通区域的数据直接位于slab中；稀疏区域只在slab中放页指针数组，
+ * 数据页在首次写入时才分配；文件映射区域映射backing_file
+ * （优先于稀疏标志，mmap本身就是按需加载的）。
+ * 脏页位图集中存放，不插在区域数据之间。slab已清零。
+ * 
+ * @param region 内存区域
+ * @param dirty_cursor 脏页位图分配游标，按region_dirty_bytes()前移
+ * @param cursor 数据分配游标，按region_slab_bytes()前移
+ * @return 成功返回0，失败返回-1
+ */
+static int region_alloc_storage(memory_region_t* region, uint8_t** dirty_cursor, uint8_t** cursor) {
+    region->data = NULL;
+    region->pages = NULL;
+    region->resident_pages = 0;
+    region->snap_touched = NULL;
+    region->snap_pages = NULL;
+    region->triggers = NULL;
+    
+    region->dirty = (uint64_t*)*dirty_cursor;
+    *dirty_cursor += region_dirty_bytes(region);
+    
+    if (region->flags & MEMORY_REGION_FILE_MASK) {
+        return region_map_file(region);
+    }
+    
+    if (region->flags & MEMORY_REGION_SPARSE) {
+        region->pages = (uint8_t**)*cursor;
+        *cursor += slab_align(region_page_count(region) * sizeof(uint8_t*));
+        return 0;
+    }
+    
+    region->data = *cursor;
+    *cursor += slab_align(region_size(region));
+    if (region->fill_value != 0) {
+        memset(region->data, region->fill_value, region_size(region));
+    }
+    return 0;
+}
+
+// 释放普通区域持有的快照页
+static void region_drop_snap_pages(memory_region_t* region) {
+    if (!region->snap_pages) return;
+    
+    size_t page_count = region_page_count(region);
+    for (size_t i = 0; i < page_count; i++) {
+        page_unref(region->snap_pages[i]);
+    }
+    free(region->snap_pages);
+    region->snap_pages = NULL;
+}
+
+// 释放区域在slab之外的存储（稀疏页、文件映射、快照位图和触发字位图）
+static void region_free_storage(memory_region_t* region) {
+    if (region->pages) {
+        size_t page_count = region_page_count(region);
+        for (size_t i = 0; i < page_count; i++) {
+            page_unref(region->pages[i]);
+            region->pages[i] = NULL;
+        }
+        region->pages = NULL;
+        region->resident_pages = 0;
+    }
+    if (region->data && (region->flags & MEMORY_REGION_FILE_MASK)) {
+        munmap(region->data, region_size(region));
+    }
+    region->data = NULL;
+    
+    free(region->snap_touched);
+    region->snap_touched = NULL;
+    region_drop_snap_pages(region);
+    // 触发字位图属于规则状态，随规则状态释放
+    region->triggers = NULL;
+    region->dirty = NULL;
+}
+
+/**
+ * 复制普通区域的数据
+ * 
+ * 一致性读取者不持有设备锁按字读取普通区域，普通区域数据的读写因此都使用宽松
+ * 原子访问：对齐的32位字逐字访问，首尾不足一个字的部分逐字节访问。
+ * 顺序锁的序号负责一致性，这里只保证单个字不被撕裂且没有数据竞争。
+ */
+static void region_data_store(uint8_t* dst, const uint8_t* src, size_t len) {
+    while (len > 0 && ((uintptr_t)dst & (sizeof(uint32_t) - 1)) != 0) {
+        __atomic_store_n(dst++, *src++, __ATOMIC_RELAXED);
+        len--;
+    }
+    for (; len >= sizeof(uint32_t); len -= sizeof(uint32_t)) {
+        uint32_t word;
+        memcpy(&word, src, sizeof(word));
+        __atomic_store_n((uint32_t*)dst, word, __ATOMIC_RELAXED);
+        dst += sizeof(uint32_t);
+        src += sizeof(uint32_t);
+    }
+    while (len-- > 0) {
+        __atomic_store_n(dst++, *src++, __ATOMIC_RELAXED);
+    }
+}
+
+static void region_data_load(uint8_t* dst, const uint8_t* src, size_t len) {
+    while (len > 0 && ((uintptr_t)src & (sizeof(uint32_t) - 1)) != 0) {
+        *dst++ = __atomic_load_n(src++, __ATOMIC_RELAXED);
+        len--;
+    }
+    for (; len >= sizeof(uint32_t); len -= sizeof(uint32_t)) {
+        uint32_t word = __atomic_load_n((const uint32_t*)src, __ATOMIC_RELAXED);
+        memcpy(dst, &word, sizeof(word));
+        dst += sizeof(uint32_t);
+        src += sizeof(uint32_t);
+    }
+    while (len-- > 0) {
+        *dst++ = __atomic_load_n(src++, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * 从区域读取数据
+ * 
+ * 稀疏区域中未分配的页返回填充值，不会分配内存。
+ * 调用者负责保证 [offset, offset+len) 在区域范围内。
+ */
+static void region_read(const memory_region_t* region, size_t offset, void* buf, size_t len) {
+    if (region->data) {
+        region_data_load((uint8_t*)buf, region->data + offset, len);
+        return;
+    }
+    
+    uint8_t* out = (uint8_t*)buf;
+    while (len > 0) {
+        size_t page = offset >> DEVICE_MEMORY_PAGE_SHIFT;
+        size_t page_offset = offset & (DEVICE_MEMORY_PAGE_SIZE - 1);
+        size_t chunk = DEVICE_MEMORY_PAGE_SIZE - page_offset;
+        if (chunk > len) chunk = len;
+        
+        if (region->pages[page]) {
+            memcpy(out, region->pages[page] + page_offset, chunk);
+        } else {
+            memset(out, region->fill_value, chunk);
+        }
+        out += chunk;
+        offset += chunk;
+        len -= chunk;
+    }
+}
+
+// 判断缓冲区是否全部为填充值
+static int is_fill_pattern(const uint8_t* buf, size_t len, uint8_t fill) {
+    for (size_t i = 0; i < len; i++) {
+        if (buf[i] != fill) return 0;
+    }
+    return 1;
+}
+
+/**
+ * 向区域写入数据
+ * 
+ * 稀疏区域在首次写入某页时分配该页；写入内容与填充值相同时不分配；
+ * 写入被快照共享的页时先复制该页（写时复制）。
+ * 调用者负责保证 [offset, offset+len) 在区域范围内。
+ * 
+ * @return 成功返回0，分配页失败返回-1
+ */
+static int region_write(memory_region_t* region, size_t offset, const void* buf, size_t len) {
+    if (region->data) {
+        region_data_store(region->data + offset, (const uint8_t*)buf, len);
+        region_mark_written(region, offset, len);
+        return 0;
+    }
+    
+    region_mark_written(region, offset, len);
+    
+    const uint8_t* in = (const uint8_t*)buf;
+    while (len > 0) {
+        size_t page = offset >> DEVICE_MEMORY_PAGE_SHIFT;
+        size_t page_offset = offset & (DEVICE_MEMORY_PAGE_SIZE - 1);
+        size_t chunk = DEVICE_MEMORY_PAGE_SIZE - page_offset;
+        if (chunk > len) chunk = len;
+        
+        if (!region->pages[page] && !is_fill_pattern(in, chunk, region->fill_value)) {
+            region->pages[page] = page_alloc(NULL, region->fill_value);
+            if (!region->pages[page]) {
+                printf("错误: 稀疏区域 0x%08X 分配页 %zu 失败\n", region->base_addr, page);
+                return -1;
+            }
+            region->resident_pages++;
+        } else if (region->pages[page] && page_is_shared(region->pages[page])) {
+            uint8_t* copy = page_alloc(region->pages[page], 0);
+            if (!copy) {
+                printf("错误: 稀疏区域 0x%08X 复制共享页 %zu 失败\n", region->base_addr, page);
+                return -1;
+            }
+            page_unref(region->pages[page]);
+            region->pages[page] = copy;
+        }
+        if (region->pages[page]) {
+            memcpy(region->pages[page] + page_offset, in, chunk);
+        }
+        in += chunk;
+        offset += chunk;
+        len -= chunk;
+    }
+    return 0;
+}
+
+/**
+ * 按访问宽度生成区域读写函数
+ * 
+ * 普通区域（含文件映射）且偏移按宽度对齐时直接按类型读写，
+ * MEMORY_REGION_LOCKFREE区域使用acquire/release原子读写，与无锁访问者同步，
+ * 其他普通区域使用宽松原子读写（见region_data_store）；
+ * 未对齐访问和稀疏区域通过region_read/region_write处理，可以跨页。
+ * 调用者负责保证访问范围在区域内。
+ */
+#define DEFINE_REGION_ACCESSORS(bits) \
+static inline uint##bits##_t region_load##bits(const memory_region_t* region, size_t offset) { \
+    uint##bits##_t v; \
+    if (region->data && (offset & (sizeof(v) - 1)) == 0) { \
+        if (region->flags & MEMORY_REGION_LOCKFREE) { \
+            return atomic_load_explicit((_Atomic uint##bits##_t*)(region->data + offset), \
+                                        memory_order_acquire); \
+        } \
+        return __atomic_load_n((const uint##bits##_t*)(region->data + offset), __ATOMIC_RELAXED); \
+    } \
+    region_read(region, offset, &v, sizeof(v)); \
+    return v; \
+} \
+static inline int region_store##bits(memory_region_t* region, size_t offset, uint##bits##_t v) { \
+    if (region->data && (offset & (sizeof(v) - 1)) == 0) { \
+        if (region->flags & MEMORY_REGION_LOCKFREE) { \
+            atomic_store_explicit((_Atomic uint##bits##_t*)(region->data + offset), v, \
+                                  memory_order_release); \
+        } else { \
+            __atomic_store_n((uint##bits##_t*)(region->data + offset), v, __ATOMIC_RELAXED); \
+        } \
+        region_mark_written(region, offset, sizeof(v)); \
+        return 0; \
+    } \
+    return region_write(region, offset, &v, sizeof(v)); \
+}
+
+DEFINE_REGION_ACCESSORS(8)
+DEFINE_REGION_ACCESSORS(16)
+DEFINE_REGION_ACCESSORS(32)
+DEFINE_REGION_ACCESSORS(64)
+
+/**
+ * 顺序锁写入开始/结束
+ * 
+ * 使用两个计数器而不是单个奇偶序号，允许多个无锁写入者同时写入：
+ * 读取者只在write_begin == write_end时读取，读完后write_begin不变才算成功。
+ * 所有修改区域数据的公开接口都用这一对函数包住数据写入。
+ */
+static inline void device_memory_write_begin(device_memory_t* mem) {
+    atomic_fetch_add_explicit((_Atomic uint32_t*)&mem->write_begin, 1, memory_order_relaxed);
+    // 保证序号先于数据对读取者可见
+    atomic_thread_fence(memory_order_release);
+}
+
+static inline void device_memory_write_end(device_memory_t* mem) {
+    atomic_fetch_add_explicit((_Atomic uint32_t*)&mem->write_end, 1, memory_order_release);
+}
+
+/**
+ * 将区域内 [offset, offset+length) 的文件映射数据写回文件
+ * 
+ * 只处理MAP_SHARED区域；MAP_PRIVATE区域的修改不会写回，直接返回成功。
+ */
+static int region_sync(memory_region_t* region, size_t offset, size_t length, int mode) {
+    if (!(region->flags & MEMORY_REGION_FILE_SHARED) || !region->data || length == 0) {
+        return 0;
+    }
+    
+    // msync要求起始地址按系统页对齐，映射起始地址本身是页对齐的
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    size_t start = offset & ~(page_size - 1);
+    int flags = (mode == DEVICE_MEMORY_SYNC_WAIT) ? MS_SYNC : MS_ASYNC;
+    
+    if (msync(region->data + start, offset + length - start, flags) != 0) {
+        printf("错误: 区域 0x%08X 写回文件 %s 失败: %s\n",
+               region->base_addr, region->backing_file, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+// 将所有MAP_SHARED文件映射区域写回文件
+int device_memory_sync(device_memory_t* mem, int mode) {
+    if (!mem || !mem->regions) return -1;
+    
+    int ret = 0;
+    for (int i = 0; i < mem->region_count; i++) {
+        if (region_sync(&mem->regions[i], 0, region_size(&mem->regions[i]), mode) != 0) {
+            ret = -1;
+        }
+    }
+    return ret;
+}
+
+// 将 [addr, addr+length) 范围内的MAP_SHARED文件映射数据写回文件
+int device_memory_sync_range(device_memory_t* mem, uint32_t addr, size_t length, int mode) {
+    if (!mem || !mem->spans || length == 0) return -1;
+    
+    uint64_t end = (uint64_t)addr + length - 1;
+    int ret = 0;
+    for (int i = 0; i < mem->region_count; i++) {
+        const memory_region_span_t* span = &mem->spans[i];
+        if (span->last_addr < addr || span->base_addr > end) {
+            continue;
+        }
+        uint32_t start = addr > span->base_addr ? addr : span->base_addr;
+        uint64_t stop = end < span->last_addr ? end : span->last_addr;
+        if (region_sync(&mem->regions[i], start - span->base_addr, (size_t)(stop - start + 1), mode) != 0) {
+            ret = -1;
+        }
+    }
+    return ret;
+}
+
+// 获取区域实际占用的数据字节数
+size_t device_memory_region_resident_bytes(const memory_region_t* region) {
+    if (!region) return 0;
+    if (region->pages) {
+        return region->resident_pages << DEVICE_MEMORY_PAGE_SHIFT;
     }
+    return region->data ? region_size(region) : 0;
+}
+
+// 获取设备内存实际占用的数据字节数
+size_t device_memory_resident_bytes(const device_memory_t* mem) {
+    if (!mem || !mem->regions) return 0;
     
-    printf("DEBUG: device_memory_find_region - 开始查找地址 0x%08X，内存区域数量: %d\n", addr, mem->region_count);
+    size_t total = 0;
+    for (int i = 0; i < mem->region_count; i++) {
+        total += device_memory_region_resident_bytes(&mem->regions[i]);
+    }
+    return total;
+}
+
+/**
+ * 建立区域索引
+ * 
+ * 将区域按基地址排序，并生成紧凑的 [基址, 末地址] 数组供二分查找使用。
+ * 区域之间不允许重叠，否则二分查找的结果不唯一。
+ * 
+ * @param mem 设备内存
+ * @return 成功返回0，失败返回-1
+ */
+static int device_memory_build_index(device_memory_t* mem) {
+    qsort(mem->regions, mem->region_count, sizeof(memory_region_t), region_compare_base);
     
     for (int i = 0; i < mem->region_count; i++) {
         memory_region_t* region = &mem->regions[i];
-        uint32_t region_end = region->base_addr + (region->unit_size * region->length);
+        mem->spans[i].base_addr = region->base_addr;
+        mem->spans[i].last_addr = region_last_addr(region);
         
-        printf("DEBUG: 区域 #%d: 基址=0x%08X, 结束地址=0x%08X, 数据指针=%p\n", 
-               i, region->base_addr, region_end - 1, (void*)region->data);
-        
-        // 检查地址是否在当前区域范围内
-        if (addr >= region->base_addr && addr < region_end) {
-            printf("DEBUG: 找到地址 0x%08X 所在区域 #%d\n", addr, i);
-            return region;
+        if (i > 0 && mem->spans[i].base_addr <= mem->spans[i - 1].last_addr) {
+            printf("错误: 内存区域重叠: 0x%08X-0x%08X 与 0x%08X-0x%08X\n",
+                   mem->spans[i - 1].base_addr, mem->spans[i - 1].last_addr,
+                   mem->spans[i].base_addr, mem->spans[i].last_addr);
+            return -1;
+        }
+    }
+    
+    mem->last_hit = 0;
+    return 0;
+}
+
+/**
+ * 计算页表大小
+ * 
+ * 只依赖区域的地址范围，与区域顺序无关，可以在排序前用于计算slab大小。
+ * 地址空间过大或过于稀疏时不建立页表，所有查找都走二分查找。
+ * 
+ * @param regions 区域数组（长度均不为0）
+ * @param region_count 区域数量
+ * @param first_page 输出页表覆盖的第一页页号
+ * @return 页表项数量，不建立页表时返回0
+ */
+static uint32_t device_memory_page_table_size(const memory_region_t* regions, int region_count,
+                                              uint32_t* first_page) {
+    if (DEVICE_MEMORY_PAGE_TABLE_MAX_PAGES == 0 || region_count > INT16_MAX) {
+        return 0;
+    }
+    
+    uint32_t lo = UINT32_MAX;
+    uint32_t hi = 0;
+    uint64_t mapped_pages = 0;   // 已映射的页数，用于判断稀疏程度
+    for (int i = 0; i < region_count; i++) {
+        uint32_t start = regions[i].base_addr >> DEVICE_MEMORY_PAGE_SHIFT;
+        uint32_t end = region_last_addr(&regions[i]) >> DEVICE_MEMORY_PAGE_SHIFT;
+        if (start < lo) lo = start;
+        if (end > hi) hi = end;
+        mapped_pages += (uint64_t)(end - start) + 1;
+    }
+    
+    uint64_t page_count = (uint64_t)hi - lo + 1;
+    if (page_count > DEVICE_MEMORY_PAGE_TABLE_MAX_PAGES ||
+        page_count > mapped_pages * DEVICE_MEMORY_PAGE_TABLE_SPARSITY) {
+        return 0;
+    }
+    
+    *first_page = lo;
+    return (uint32_t)page_count;
+}
+
+/**
+ * 填充页表解码器
+ * 
+ * 每个页表项直接记录该页所属的区域索引，一次移位加一次加载即可完成地址解码。
+ * 一页内包含多个区域时记为PAGE_ENTRY_SHARED，查找时回退到二分查找。
+ * 
+ * @param mem 设备内存（区域索引必须已建立，page_table/page_base/page_count已设置）
+ */
+static void device_memory_fill_page_table(device_memory_t* mem) {
+    int16_t* table = mem->page_table;
+    uint32_t first_page = mem->page_base >> DEVICE_MEMORY_PAGE_SHIFT;
+    
+    for (uint32_t p = 0; p < mem->page_count; p++) {
+        table[p] = PAGE_ENTRY_UNMAPPED;
+    }
+    
+    for (int i = 0; i < mem->region_count; i++) {
+        uint32_t start = (mem->spans[i].base_addr >> DEVICE_MEMORY_PAGE_SHIFT) - first_page;
+        uint32_t end = (mem->spans[i].last_addr >> DEVICE_MEMORY_PAGE_SHIFT) - first_page;
+        for (uint32_t p = start; p <= end; p++) {
+            table[p] = (table[p] == PAGE_ENTRY_UNMAPPED) ? (int16_t)i : PAGE_ENTRY_SHARED;
         }
     }
+}
+
+// 页表解码结果：需要回退到查找
+#define PAGE_DECODE_SEARCH  (-2)
+
+/**
+ * 通过页表解码地址
+ * 
+ * @return 区域索引；-1表示地址不在任何区域内；
+ *         PAGE_DECODE_SEARCH表示未启用页表或该页有多个区域，需要回退到查找
+ */
+static inline int device_memory_decode_page(const device_memory_t* mem, uint32_t addr) {
+    if (!mem->page_table) {
+        return PAGE_DECODE_SEARCH;
+    }
+    
+    uint32_t page = (addr - mem->page_base) >> DEVICE_MEMORY_PAGE_SHIFT;
+    if (page >= mem->page_count) {
+        return -1;
+    }
+    int entry = mem->page_table[page];
+    if (entry >= 0) {
+        const memory_region_span_t* span = &mem->spans[entry];
+        return (addr - span->base_addr <= span->last_addr - span->base_addr) ? entry : -1;
+    }
+    return (entry == PAGE_ENTRY_UNMAPPED) ? -1 : PAGE_DECODE_SEARCH;
+}
+
+/**
+ * 无分支二分查找
+ * 
+ * 找到最后一个基址不大于addr的区域后再做一次范围判断。
+ * 
+ * @return 区域索引，未找到返回-1
+ */
+static inline int device_memory_search(const device_memory_t* mem, uint32_t addr) {
+    const memory_region_span_t* spans = mem->spans;
+    const memory_region_span_t* base = spans;
+    int n = mem->region_count;
+    while (n > 1) {
+        int half = n / 2;
+        base = (base[half].base_addr <= addr) ? base + half : base;
+        n -= half;
+    }
+    
+    if (addr - base->base_addr > base->last_addr - base->base_addr) {
+        return -1;
+    }
+    return (int)(base - spans);
+}
+
+/**
+ * 在排序后的区域索引中查找地址（不打印任何信息）
+ * 
+ * 启用页表时先查页表；页表未覆盖的地址一定不在任何区域内。
+ * 否则检查最近一次命中的区域，未命中时使用二分查找。
+ * 
+ * @param mem 设备内存
+ * @param addr 地址
+ * @return 区域索引，未找到返回-1
+ */
+static int device_memory_lookup(device_memory_t* mem, uint32_t addr) {
+    int index = device_memory_decode_page(mem, addr);
+    if (index != PAGE_DECODE_SEARCH) {
+        return index;
+    }
+    
+    // 最近命中缓存：addr - base 与 last - base 比较，一次无符号比较完成范围判断
+    const memory_region_span_t* spans = mem->spans;
+    int hit = mem->last_hit;
+    if (addr - spans[hit].base_addr <= spans[hit].last_addr - spans[hit].base_addr) {
+        return hit;
+    }
+    
+    index = device_memory_search(mem, addr);
+    if (index >= 0) {
+        mem->last_hit = index;
+    }
+    return index;
+}
+
+// 查找地址所在的内存区域
+memory_region_t* device_memory_find_region(device_memory_t* mem, uint32_t addr) {
+    if (!mem || !mem->regions || !mem->spans || mem->region_count <= 0) {
+        printf("错误: device_memory_find_region - 无效的内存对象或内存区域数组，mem=%p, regions=%p, region_count=%d\n", 
+              (void*)mem, mem ? (void*)mem->regions : NULL, mem ? mem->region_count : 0);
+        return NULL;
+    }
+    
+    int index = device_memory_lookup(mem, addr);
+    if (index >= 0) {
+        return &mem->regions[index];
+    }
     
     // 未找到匹配区域，打印所有可用的内存区域信息
     printf("错误：未能找到地址 0x%08X 所在的内存区域\n", addr);
     printf("可用的内存区域如下：\n");
     for (int i = 0; i < mem->region_count; i++) {
         memory_region_t* region = &mem->regions[i];
-        uint32_t region_end = region->base_addr + (region->unit_size * region->length);
         printf("区域 %d: 基地址=0x%08X, 结束地址=0x%08X, 单元大小=%zu字节, 长度=%zu单元, 设备类型=%d, 设备ID=%d\n",
-               i, region->base_addr, region_end - 1, region->unit_size, region->length, 
+               i, region->base_addr, region_last_addr(region), region->unit_size, region->length, 
                region->device_type, region->device_id);
     }
     
     return NULL;  // 未找到匹配的区域
 }
 
-// 创建设备内存（从配置创建）
-device_memory_t* device_memory_create_from_config(memory_region_config_t* configs, int config_count, 
-                                                void* monitor, 
-                                                device_type_id_t device_type, int device_id) {
-    if (!configs || config_count <= 0) return NULL;
+// 创建设备内存（从配置创建）
+device_memory_t* device_memory_create_from_config(memory_region_config_t* configs, int config_count, 
+                                                void* monitor, 
+                                                device_type_id_t device_type, int device_id) {
+    if (!configs || config_count <= 0) return NULL;
+    
+    // 转换为区域描述后使用统一的slab布局创建
+    memory_region_t* regions = (memory_region_t*)calloc(config_count, sizeof(memory_region_t));
+    if (!regions) return NULL;
+    
+    for (int i = 0; i < config_count; i++) {
+        regions[i].base_addr = configs[i].base_addr;
+        regions[i].unit_size = configs[i].unit_size;
+        regions[i].length = configs[i].length;
+        regions[i].flags = configs[i].flags;
+        regions[i].fill_value = configs[i].fill_value;
+        regions[i].backing_file = configs[i].backing_file;
+    }
+    
+    device_memory_t* mem = device_memory_create(regions, config_count, monitor, device_type, device_id);
+    free(regions);
+    return mem;
+}
+
+/**
+ * 创建设备内存
+ * 
+ * 设备内存头、区域描述、区域索引、页表、脏页位图以及所有普通区域的数据
+ * 从一块slab中按缓存行对齐切分：创建只需一次分配，销毁只需一次释放，
+ * 区域数据按基地址顺序排列，低地址的寄存器区域位于相邻的缓存行中。
+ * 
+ * slab布局：
+ *   device_memory_t | regions[] | spans[] | page_table[] | 脏页位图 | 各区域数据
+ */
+device_memory_t* device_memory_create(const memory_region_t* regions, int region_count, 
+                                     void* monitor, uint32_t device_type, uint32_t device_id) {
+    if (!regions || region_count <= 0) {
+        return NULL;
+    }
+    
+    // 计算slab大小（各部分独立对齐，与区域排序无关）
+    size_t total = slab_align(sizeof(device_memory_t));
+    size_t regions_offset = total;
+    total += slab_align(region_count * sizeof(memory_region_t));
+    size_t spans_offset = total;
+    total += slab_align(region_count * sizeof(memory_region_span_t));
+    
+    for (int i = 0; i < region_count; i++) {
+        if ((uint64_t)regions[i].unit_size * regions[i].length == 0) {
+            printf("错误: 内存区域 0x%08X 长度为0\n", regions[i].base_addr);
+            return NULL;
+        }
+    }
+    
+    uint32_t first_page = 0;
+    uint32_t page_count = device_memory_page_table_size(regions, region_count, &first_page);
+    size_t page_table_offset = total;
+    total += slab_align(page_count * sizeof(int16_t));
+    
+    size_t dirty_offset = total;
+    size_t dirty_bytes = 0;
+    for (int i = 0; i < region_count; i++) {
+        dirty_bytes += region_dirty_bytes(&regions[i]);
+    }
+    total += slab_align(dirty_bytes);
+    
+    size_t storage_offset = total;
+    for (int i = 0; i < region_count; i++) {
+        total += region_slab_bytes(&regions[i]);
+    }
+    
+    // calloc保证清零（大块内存由系统按需提供零页），多分配一个对齐粒度用于对齐起始地址
+    void* slab = calloc(1, total + DEVICE_MEMORY_SLAB_ALIGN);
+    if (!slab) {
+        return NULL;
+    }
+    uint8_t* base = (uint8_t*)(((uintptr_t)slab + DEVICE_MEMORY_SLAB_ALIGN - 1) & 
+                               ~(uintptr_t)(DEVICE_MEMORY_SLAB_ALIGN - 1));
+    
+    device_memory_t* memory = (device_memory_t*)base;
+    memory->slab = slab;
+    memory->slab_size = total;
+    memory->regions = (memory_region_t*)(base + regions_offset);
+    memory->spans = (memory_region_span_t*)(base + spans_offset);
+    memory->region_count = region_count;
+    memory->monitor = monitor;
+    memory->device_type = device_type;
+    memory->device_id = device_id;
+    
+    // 复制区域描述并按基地址排序，使数据按地址顺序排列
+    for (int i = 0; i < region_count; i++) {
+        memory->regions[i].base_addr = regions[i].base_addr;
+        memory->regions[i].unit_size = regions[i].unit_size;
+        memory->regions[i].length = regions[i].length;
+        memory->regions[i].device_type = device_type;
+        memory->regions[i].device_id = device_id;
+        memory->regions[i].flags = regions[i].flags;
+        memory->regions[i].fill_value = regions[i].fill_value;
+        memory->regions[i].backing_file = regions[i].backing_file;
+    }
+    if (device_memory_build_index(memory) != 0) {
+        free(slab);
+        return NULL;
+    }
+    
+    if (page_count > 0) {
+        memory->page_table = (int16_t*)(base + page_table_offset);
+        memory->page_base = first_page << DEVICE_MEMORY_PAGE_SHIFT;
+        memory->page_count = page_count;
+        device_memory_fill_page_table(memory);
+    }
+    
+    // 分配每个区域的存储
+    uint8_t* dirty_cursor = base + dirty_offset;
+    uint8_t* cursor = base + storage_offset;
+    for (int i = 0; i < region_count; i++) {
+        if (region_alloc_storage(&memory->regions[i], &dirty_cursor, &cursor) != 0) {
+            for (int j = 0; j < i; j++) {
+                region_free_storage(&memory->regions[j]);
+            }
+            free(slab);
+            return NULL;
+        }
+    }
+    
+    pthread_mutex_init(&memory->rule_state_lock, NULL);
+    pthread_mutex_init(&memory->coalesce_lock, NULL);
+    
+    // 位图分配失败时区域回退为逐条检查规则，不影响创建
+    device_memory_rebuild_triggers(memory);
+    return memory;
+}
+
+// 触发字位图分配失败的区域指向此哨兵，每次写入都逐条检查规则
+static uint64_t g_trigger_all_bitmap;
+#define MEMORY_REGION_TRIGGER_ALL  (&g_trigger_all_bitmap)
+
+// 规则触发状态：高位表示已观察过，低32位为上次观察到的掩码值
+#define RULE_STATE_SEEN  (1ULL << 32)
+
+// 规则触发合并状态
+struct device_rule_coalesce {
+    uint64_t last_fire_us;        // 上次执行的时间
+    uint32_t skipped;             // 上次执行后被合并的次数
+    int armed;                    // 已执行过，之后的触发才参与合并
+    int pending;                  // 有被合并的触发等待补发
+    uint64_t fired;               // 执行次数
+    uint64_t suppressed;          // 被合并次数
+};
+
+/**
+ * 设备内存按一个规则表代次建立的规则状态
+ * 
+ * 规则表代次变化后由写入路径重建并原子发布。旧状态挂在retired链上直到销毁
+ * 设备内存：并发的规则检查和待执行队列中的触发可能仍在使用其中的绑定单元。
+ */
+struct device_rule_state {
+    uint64_t generation;          // 建立时的规则表代次
+    const rule_table_entry_t* rules; // 建立时设备类型的规则表，以下各数组按其中的位置索引（只在规则读侧内使用）
+    int rule_count;               // 规则表的规则数
+    const char** names;           // 各位置的规则名，重建时按名称沿用上一个状态
+    action_binding_t* bindings;   // 规则目标绑定单元，按规则表位置分段（见binding_offsets）
+    int* binding_offsets;         // 规则表位置 -> bindings中的起始下标，共rule_count+1项
+    uint64_t* rule_states;        // 边沿/变化触发规则上次观察到的掩码值（原子访问）
+    struct device_rule_coalesce* coalesce; // 规则触发合并状态（coalesce_lock保护）
+    uint64_t** triggers;          // 各区域的触发字位图，发布时存入region->triggers
+    struct device_rule_state* retired; // 被本状态取代的上一个状态
+};
+
+// 释放一个规则状态（不含retired链）
+static void device_rule_state_free(struct device_rule_state* state, int region_count) {
+    if (!state) return;
+    for (int i = 0; state->triggers && i < region_count; i++) {
+        if (state->triggers[i] != MEMORY_REGION_TRIGGER_ALL) {
+            free(state->triggers[i]);
+        }
+    }
+    free(state->triggers);
+    free(state->names);
+    free(state->bindings);
+    free(state->binding_offsets);
+    free(state->rule_states);
+    free(state->coalesce);
+    free(state);
+}
+
+// 销毁设备内存
+void device_memory_destroy(device_memory_t* mem) {
+    if (!mem) return;
+    
+    // 队列中可能还有引用本设备内存的事件
+    write_event_queue_t* events = __atomic_load_n(&g_write_events, __ATOMIC_ACQUIRE);
+    if (events && !write_event_queue_in_consumer()) {
+        write_event_queue_flush(events);
+    }
+    
+    // 释放slab之外的存储
+    for (int i = 0; i < mem->region_count; i++) {
+        region_free_storage(&mem->regions[i]);
+    }
+    
+    if (mem->export_base) {
+        munmap(mem->export_base, mem->export_size);
+        close(mem->export_fd);
+    }
+    // 其他线程待执行队列中的触发和异步执行的目标动作直接使用规则状态中的绑定单元，
+    // 先等队列清空（清空时可能提交异步动作），再等分发器，之后才能释放；
+    // 当前线程自己的队列非空或在分发器工作线程中无法等待，此时保留规则状态
+    struct device_rule_state* state = mem->rule_state;
+    action_manager_t* am = action_manager_get_instance();
+    if (state && action_manager_defer_wait() != 0) {
+        printf("错误: 当前线程还有待执行的规则，规则状态不释放\n");
+        state = NULL;
+    }
+    if (state && am && action_manager_flush(am) != 0) {
+        printf("错误: 在分发器工作线程中销毁设备内存，规则状态不释放\n");
+        state = NULL;
+    }
+    while (state) {
+        struct device_rule_state* retired = state->retired;
+        device_rule_state_free(state, mem->region_count);
+        state = retired;
+    }
+    pthread_mutex_destroy(&mem->rule_state_lock);
+    pthread_mutex_destroy(&mem->coalesce_lock);
+    
+    free(mem->slab);
+}
+
+// 规则状态中第position条规则的目标绑定单元（每个目标一个，连续存放），没有时返回NULL
+static action_binding_t* device_memory_bindings(struct device_rule_state* state, const rule_table_entry_t* rule,
+                                                int position) {
+    if (!state || !state->bindings || position < 0 || position >= state->rule_count) {
+        return NULL;
+    }
+    int offset = state->binding_offsets[position];
+    if (state->binding_offsets[position + 1] - offset != (int)rule->targets.count) {
+        return NULL;
+    }
+    return &state->bindings[offset];
+}
+
+/**
+ * 执行一条匹配的规则表项，目标未指定设备时使用当前内存所属设备
+ * 
+ * 目标动作直接引用目标池，不复制规则。
+ * 
+ * @param state 规则状态，NULL时不使用绑定单元
+ * @param position 规则在状态规则表中的位置，用于取目标绑定单元，-1表示不属于该状态
+ */
+static void device_memory_execute_rule(device_memory_t* mem, struct device_rule_state* state,
+                                       const rule_table_entry_t* rule, int position) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    
+    printf("[%ld.%06ld] device_memory_write - 规则 \"%s\" 触发条件满足，执行处理动作，目标动作数量: %d\n", 
+          tv.tv_sec, (long)tv.tv_usec, rule->name, rule->targets.count);
+    fflush(stdout);
+    
+    action_firing_t firing;
+    memset(&firing, 0, sizeof(firing));
+    firing.rule_id = 0xFFFF;  // 临时ID
+    firing.name = rule->name;
+    firing.trigger = rule->trigger;
+    firing.device_type = rule->device_type;
+    firing.device_id = (int)mem->device_id;
+    firing.targets = action_target_pool_get(rule->targets);
+    firing.target_count = firing.targets ? (int)rule->targets.count : 0;
+    // 如果目标动作没有指定设备类型和ID，则使用当前内存对象的设备类型和ID
+    firing.inherit_device = 1;
+    // 解析结果只取决于本设备和规则表项，可以在本设备内存中缓存
+    firing.bindings = device_memory_bindings(state, rule, position);
+    if (firing.device_type == 0) {
+        firing.device_type = mem->device_type;
+    }
+    
+    for (int j = 0; j < firing.target_count; j++) {
+        const action_target_t* target = &firing.targets[j];
+        printf("[%ld.%06ld] device_memory_write - 目标动作[%d]: 类型=%d, 设备类型=%d, 设备ID=%d, 地址=0x%08X, 值=0x%08X\n", 
+               tv.tv_sec, (long)tv.tv_usec, j, target->type, 
+               target->device_type ? target->device_type : mem->device_type, 
+               target->device_id ? target->device_id : (int)mem->device_id, 
+               target->target_addr, target->target_value);
+    }
+    
+    // 获取设备管理器和动作管理器
+    device_manager_t* dm = device_manager_get_instance();
+    action_manager_t* am = action_manager_get_instance();
+    
+    if (dm && am) {
+        // 调用者持有设备锁时（defer_begin之后）只放入待执行队列
+        int result = action_manager_submit_firing(am, &firing, dm);
+        printf("[%ld.%06ld] device_memory_write - 规则执行结果: %d\n", 
+               tv.tv_sec, (long)tv.tv_usec, result);
+    } else if (dm) {
+        printf("[%ld.%06ld] device_memory_write - 找到设备管理器，但无法获取动作管理器，直接执行写入动作\n", 
+              tv.tv_sec, (long)tv.tv_usec);
+        
+        for (int j = 0; j < firing.target_count; j++) {
+            const action_target_t* target = &firing.targets[j];
+            if (target->type != ACTION_TYPE_WRITE) {
+                printf("[%ld.%06ld] device_memory_write - 不支持的动作类型: %d\n", 
+                      tv.tv_sec, (long)tv.tv_usec, target->type);
+                continue;
+            }
+            
+            device_type_id_t target_type = target->device_type ? target->device_type : mem->device_type;
+            int target_id = target->device_id ? target->device_id : (int)mem->device_id;
+            device_instance_t* target_device = device_get(dm, target_type, target_id);
+            device_type_t* device_type = &dm->types[target_type];
+            if (!target_device) {
+                printf("[%ld.%06ld] device_memory_write - 未找到目标设备\n", 
+                      tv.tv_sec, (long)tv.tv_usec);
+            } else if (device_type->ops.write) {
+                int result = device_type->ops.write(target_device, target->target_addr, target->target_value);
+                printf("[%ld.%06ld] device_memory_write - 写入结果: %d\n", 
+                      tv.tv_sec, (long)tv.tv_usec, result);
+            } else {
+                printf("[%ld.%06ld] device_memory_write - 设备不支持写入操作\n", 
+                      tv.tv_sec, (long)tv.tv_usec);
+            }
+        }
+    } else {
+        printf("[%ld.%06ld] device_memory_write - 无法获取设备管理器，无法执行规则\n", 
+              tv.tv_sec, (long)tv.tv_usec);
+    }
+    fflush(stdout);
+}
+
+static device_memory_clock_t g_coalesce_clock = NULL;   // 规则合并时钟，NULL为单调时钟
+
+// 设置规则合并使用的时钟
+void device_memory_set_clock(device_memory_clock_t clock) {
+    __atomic_store_n(&g_coalesce_clock, clock, __ATOMIC_RELEASE);
+}
+
+// 当前时间（微秒）
+static uint64_t device_memory_now_us(void) {
+    device_memory_clock_t clock = __atomic_load_n(&g_coalesce_clock, __ATOMIC_ACQUIRE);
+    if (clock) return clock();
+    
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+// 触发字位图字数（每位对应区域内的一个32位字）
+static size_t region_trigger_words(const memory_region_t* region) {
+    return ((region_size(region) + sizeof(uint32_t) - 1) / sizeof(uint32_t) + 63) / 64;
+}
+
+/**
+ * 判断写入范围是否覆盖了某个触发字
+ * 
+ * 没有位图时说明区域内没有任何触发地址（位图分配失败的区域指向哨兵，总是返回1）。
+ * 位图按32位字粒度记录，未对齐的触发字会标记两个字，可能多进入一次规则检查，不会漏检。
+ */
+static inline int region_has_trigger(const memory_region_t* region, uint32_t addr, size_t width) {
+    const uint64_t* triggers = __atomic_load_n(&region->triggers, __ATOMIC_ACQUIRE);
+    if (!triggers || triggers == MEMORY_REGION_TRIGGER_ALL) {
+        return triggers != NULL;
+    }
+    size_t first = (addr - region->base_addr) / sizeof(uint32_t);
+    size_t last = (addr - region->base_addr + width - 1) / sizeof(uint32_t);
+    for (size_t w = first; w <= last; w++) {
+        if (triggers[w / 64] & (1ULL << (w % 64))) return 1;
+    }
+    return 0;
+}
+
+// 按规则表分配目标绑定单元（全部未绑定）、规则触发状态（全部未观察）和合并状态
+static int device_rule_state_alloc(struct device_rule_state* state) {
+    int rule_count = state->rule_count;
+    const rule_table_entry_t* rules = state->rules;
+    if (!rules || rule_count <= 0) {
+        return 0;
+    }
+    
+    // 规则名只用于重建时沿用状态，分配失败时新状态从头开始
+    state->names = (const char**)malloc(rule_count * sizeof(const char*));
+    for (int r = 0; state->names && r < rule_count; r++) {
+        state->names[r] = rules[r].name;
+    }
+    // 状态分配失败时边沿/变化触发的规则按电平触发执行
+    state->rule_states = (uint64_t*)calloc(rule_count, sizeof(uint64_t));
+    if (!state->rule_states) {
+        printf("错误: 无法分配规则触发状态\n");
+    }
+    // 合并状态分配失败时不合并，每次触发都执行
+    state->coalesce = (struct device_rule_coalesce*)calloc(rule_count, sizeof(struct device_rule_coalesce));
+    if (!state->coalesce) {
+        printf("错误: 无法分配规则合并状态\n");
+    }
+    
+    int* offsets = (int*)malloc((rule_count + 1) * sizeof(int));
+    if (!offsets) return -1;
+    offsets[0] = 0;
+    for (int r = 0; r < rule_count; r++) {
+        offsets[r + 1] = offsets[r] + rules[r].targets.count;
+    }
+    if (offsets[rule_count] > 0) {
+        state->bindings = (action_binding_t*)calloc(offsets[rule_count], sizeof(action_binding_t));
+        if (!state->bindings) {
+            free(offsets);
+            return -1;
+        }
+    }
+    state->binding_offsets = offsets;
+    return 0;
+}
+
+// 在触发字位图中标记区域内 [start, end) 覆盖的字，位图分配失败时整个区域按有触发处理
+static int region_mark_triggers(uint64_t** triggers, const memory_region_t* region, uint64_t start, uint64_t end) {
+    if (*triggers == MEMORY_REGION_TRIGGER_ALL) {
+        return -1;
+    }
+    if (!*triggers) {
+        *triggers = (uint64_t*)calloc(region_trigger_words(region), sizeof(uint64_t));
+        if (!*triggers) {
+            printf("错误: 无法为区域 0x%08X 分配触发字位图\n", region->base_addr);
+            *triggers = MEMORY_REGION_TRIGGER_ALL;
+            return -1;
+        }
+    }
+    size_t first = (size_t)(start - region->base_addr) / sizeof(uint32_t);
+    size_t last = (size_t)(end - 1 - region->base_addr) / sizeof(uint32_t);
+    for (size_t w = first; w <= last; w++) {
+        (*triggers)[w / 64] |= 1ULL << (w % 64);
+    }
+    return 0;
+}
+
+// 按区域所属设备类型的规则表建立触发字位图
+static int region_build_triggers(const memory_region_t* region, uint64_t** triggers) {
+    int rule_count = 0;
+    uint64_t generation = 0;
+    const rule_table_entry_t* rules = get_device_rule_table(region->device_type, &rule_count, &generation);
+    size_t size = region_size(region);
+    for (int r = 0; rules && r < rule_count; r++) {
+        uint32_t trigger_addr = rules[r].trigger.trigger_addr;
+        uint64_t start = trigger_addr;
+        uint64_t end = (uint64_t)trigger_addr + sizeof(uint32_t);
+        if (rule_trigger_is_range(&rules[r].trigger)) {
+            // 范围规则标记与区域相交部分的每个字
+            end = rules[r].trigger.range_end;
+            if (start < region->base_addr) start = region->base_addr;
+            if ((uint64_t)region->base_addr + size < end) end = (uint64_t)region->base_addr + size;
+            if (start >= end) continue;
+        } else if (trigger_addr < region->base_addr || 
+                   (size_t)(trigger_addr - region->base_addr) + sizeof(uint32_t) > size) {
+            // 与规则检查一致：触发字必须完整位于区域内
+            continue;
+        }
+        if (region_mark_triggers(triggers, region, start, end) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// 在上一个状态中按规则名查找同一条规则的位置，没有时返回-1（上一个状态的规则表可能已释放）
+static int device_rule_state_find(const struct device_rule_state* state, const rule_table_entry_t* rule) {
+    for (int p = 0; state && state->names && p < state->rule_count; p++) {
+        if (state->names[p] == rule->name) {
+            return p;
+        }
+    }
+    return -1;
+}
+
+/**
+ * 按当前规则表建立新的规则状态并发布，调用者持有rule_state_lock并位于规则读侧临界区内
+ * 
+ * 上一个状态中仍存在的规则沿用其触发状态和合并状态，未补发的合并触发不会丢失。
+ * 
+ * @param seed 非0时以当前内容作为新规则边沿/变化触发的初始值，否则新规则从未观察开始
+ *             （写入路径上重建时写入已经完成，以当前内容为初始值会漏掉这次写入）
+ * @return 成功返回0，内存不足返回-1（位图分配失败的区域回退为逐条检查规则）
+ */
+static int device_memory_publish_rule_state(device_memory_t* mem, int seed) {
+    struct device_rule_state* old = mem->rule_state;
+    struct device_rule_state* state = (struct device_rule_state*)calloc(1, sizeof(*state));
+    if (!state) {
+        printf("错误: 无法分配规则状态\n");
+        return -1;
+    }
+    state->rules = get_device_rule_table(mem->device_type, &state->rule_count, &state->generation);
+    
+    // 绑定单元分配失败时目标在每次触发时查找，不影响规则执行
+    int ret = 0;
+    if (device_rule_state_alloc(state) != 0) {
+        printf("错误: 无法分配规则目标绑定\n");
+    }
+    
+    state->triggers = (uint64_t**)calloc(mem->region_count, sizeof(uint64_t*));
+    for (int i = 0; i < mem->region_count; i++) {
+        memory_region_t* region = &mem->regions[i];
+        uint64_t* triggers = MEMORY_REGION_TRIGGER_ALL;
+        if (!state->triggers || region_build_triggers(region, &state->triggers[i]) != 0) {
+            ret = -1;
+        }
+        if (state->triggers) {
+            triggers = state->triggers[i];
+        }
+        __atomic_store_n(&region->triggers, triggers, __ATOMIC_RELEASE);
+    }
+    
+    for (int r = 0; r < state->rule_count; r++) {
+        const rule_table_entry_t* rule = &state->rules[r];
+        int previous = device_rule_state_find(old, rule);
+        if (previous >= 0) {
+            if (state->rule_states && old->rule_states) {
+                __atomic_store_n(&state->rule_states[r],
+                                 __atomic_load_n(&old->rule_states[previous], __ATOMIC_ACQUIRE), __ATOMIC_RELAXED);
+            }
+            if (state->coalesce && old->coalesce) {
+                pthread_mutex_lock(&mem->coalesce_lock);
+                state->coalesce[r] = old->coalesce[previous];
+                old->coalesce[previous].pending = 0;
+                pthread_mutex_unlock(&mem->coalesce_lock);
+            }
+            continue;
+        }
+        if (!seed || !state->rule_states || rule->trigger.mode == RULE_TRIGGER_LEVEL ||
+            rule_trigger_is_range(&rule->trigger)) {
+            continue;
+        }
+        // 以当前内容作为边沿/变化触发的初始值，重建前已有的值不算一次变化
+        int index = device_memory_lookup(mem, rule->trigger.trigger_addr);
+        if (index < 0) continue;
+        memory_region_t* region = &mem->regions[index];
+        size_t offset = rule->trigger.trigger_addr - region->base_addr;
+        if (offset + sizeof(uint32_t) > region_size(region)) continue;
+        uint32_t value = region_load32(region, offset) & rule->trigger.expected_mask;
+        __atomic_store_n(&state->rule_states[r], RULE_STATE_SEEN | value, __ATOMIC_RELAXED);
+    }
+    
+    state->retired = old;
+    __atomic_store_n(&mem->rule_state, state, __ATOMIC_RELEASE);
+    return ret;
+}
+
+// 规则状态是否属于当前规则表代次：属于时其规则表在读侧临界区退出前有效
+// （新快照先于代次发布，状态可能比刚读到的代次新）
+static inline int device_rule_state_current(const struct device_rule_state* state) {
+    return state && state->generation >= device_rules_generation();
+}
+
+/**
+ * 取当前规则表代次的规则状态，代次变化后先重建，调用者位于规则读侧临界区内
+ * 
+ * 规则表增删规则或修改合并策略后，已创建的设备内存在下一次规则检查时
+ * 自动重建，不需要调用device_memory_rebuild_triggers。
+ * 
+ * @return 规则状态，无法按当前代次建立时返回NULL
+ */
+static struct device_rule_state* device_memory_rule_state(device_memory_t* mem) {
+    struct device_rule_state* state = __atomic_load_n(&mem->rule_state, __ATOMIC_ACQUIRE);
+    if (device_rule_state_current(state)) {
+        return state;
+    }
+    
+    pthread_mutex_lock(&mem->rule_state_lock);
+    state = mem->rule_state;
+    if (!device_rule_state_current(state)) {
+        device_memory_publish_rule_state(mem, 0);
+        state = mem->rule_state;
+    }
+    pthread_mutex_unlock(&mem->rule_state_lock);
+    return device_rule_state_current(state) ? state : NULL;
+}
+
+// 重建触发字位图
+int device_memory_rebuild_triggers(device_memory_t* mem) {
+    if (!mem || !mem->regions) return -1;
+    
+    int token = device_rules_read_begin();
+    pthread_mutex_lock(&mem->rule_state_lock);
+    int ret = device_memory_publish_rule_state(mem, 1);
+    pthread_mutex_unlock(&mem->rule_state_lock);
+    device_rules_read_end(token);
+    return ret;
+}
+
+// 规则在状态中的位置是否有效（规则不属于该状态的规则表时position为-1）
+static inline int rule_state_valid(const struct device_rule_state* state, int position) {
+    return state && position >= 0 && position < state->rule_count;
+}
+
+// 一次写入的范围和值：规则按写入的值判断，不重新读取可能已被之后的写入改变的内存
+struct device_memory_written {
+    uint32_t addr;                // 写入地址
+    size_t width;                 // 写入宽度（字节，最多8）
+    uint8_t new_bytes[8];         // 写入的值（内存中的字节序）
+    uint8_t old_bytes[8];         // 写入前的值（has_old不为0时有效）
+    int has_old;                  // 写入前的值是否已知
+};
+
+// 按写入宽度把值转换为内存中的字节
+static void written_bytes(uint8_t* bytes, size_t width, uint64_t value) {
+    switch (width) {
+    case 1: { uint8_t v = (uint8_t)value; memcpy(bytes, &v, 1); break; }
+    case 2: { uint16_t v = (uint16_t)value; memcpy(bytes, &v, 2); break; }
+    case 4: { uint32_t v = (uint32_t)value; memcpy(bytes, &v, 4); break; }
+    default: memcpy(bytes, &value, sizeof(value)); break;
+    }
+}
+
+/**
+ * 写入前或写入后位于 [word, word+4) 的32位字
+ * 
+ * 写入范围内的字节取自写入记录的值，范围外的字节（窄写入或未对齐的触发字）
+ * 不属于这次写入，取自当前内容。字必须完整位于区域内。
+ * 
+ * @param old 非0时取写入前的值（written->has_old不为0）
+ */
+static uint32_t region_written_word(const memory_region_t* region, const struct device_memory_written* written,
+                                    uint64_t word, int old) {
+    const uint8_t* source = old ? written->old_bytes : written->new_bytes;
+    if (word == written->addr && written->width == sizeof(uint32_t)) {
+        uint32_t value;
+        memcpy(&value, source, sizeof(value));
+        return value;
+    }
+    uint8_t bytes[sizeof(uint32_t)];
+    for (size_t b = 0; b < sizeof(bytes); b++) {
+        uint64_t at = word + b;
+        if (at >= written->addr && at < (uint64_t)written->addr + written->width) {
+            bytes[b] = source[at - written->addr];
+        } else {
+            bytes[b] = region_load8(region, at - region->base_addr);
+        }
+    }
+    uint32_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+/**
+ * 按触发方式判断规则是否触发
+ * 
+ * 写入前的值已知时（写入事件）边沿/变化按这次写入前后的值判断；否则以交换方式
+ * 更新上次观察到的掩码值，同一次变化只会被一个检查者看到，并发写同一触发字时
+ * 观察顺序可能与写入顺序不同，下一次写入后纠正。
+ * 
+ * @param position 规则在状态规则表中的位置
+ * @param value 写入后触发字的值
+ * @param old_value 写入前触发字的值，未知时为NULL
+ * @return 触发返回1，否则返回0
+ */
+static int device_memory_rule_fires(struct device_rule_state* state, const rule_table_entry_t* rule,
+                                    int position, uint32_t value, const uint32_t* old_value) {
+    uint32_t mask = rule->trigger.expected_mask;
+    uint32_t expected = rule->trigger.expected_value & mask;
+    int match = (value & mask) == expected;
+    if (rule->trigger.mode == RULE_TRIGGER_LEVEL) {
+        return match;
+    }
+    
+    uint64_t current = RULE_STATE_SEEN | (value & mask);
+    uint64_t previous = 0;
+    int tracked = rule_state_valid(state, position) && state->rule_states;
+    if (tracked) {
+        previous = __atomic_exchange_n(&state->rule_states[position], current, __ATOMIC_ACQ_REL);
+    }
+    if (old_value) {
+        previous = RULE_STATE_SEEN | (*old_value & mask);
+    } else if (!tracked) {
+        return match;
+    }
+    if (previous == current) {
+        return 0;
+    }
+    if (rule->trigger.mode == RULE_TRIGGER_CHANGE) {
+        return 1;
+    }
+    int was_match = (previous & RULE_STATE_SEEN) && (uint32_t)previous == expected;
+    return match && !was_match;
+}
+
+/**
+ * 按合并策略决定一次触发是立即执行还是被合并
+ * 
+ * 窗口内第一次触发立即执行，之后的触发被合并，窗口结束后的下一次触发或
+ * device_memory_flush_coalesced执行一次。
+ * 
+ * @return 立即执行返回1，被合并返回0
+ */
+static int device_memory_rule_admit(device_memory_t* mem, struct device_rule_state* state,
+                                    const rule_table_entry_t* rule, int position) {
+    uint32_t every = __atomic_load_n(&rule->coalesce.every_writes, __ATOMIC_RELAXED);
+    uint32_t window = __atomic_load_n(&rule->coalesce.window_us, __ATOMIC_RELAXED);
+    if ((every <= 1 && window == 0) || !rule_state_valid(state, position) || !state->coalesce) {
+        return 1;
+    }
+    uint64_t now = window ? device_memory_now_us() : 0;
+    
+    pthread_mutex_lock(&mem->coalesce_lock);
+    struct device_rule_coalesce* coalesce = &state->coalesce[position];
+    int admit = 1;
+    if (coalesce->armed) {
+        if (every > 1 && coalesce->skipped + 1 < every) admit = 0;
+        if (window && now - coalesce->last_fire_us < window) admit = 0;
+    }
+    if (admit) {
+        coalesce->armed = 1;
+        coalesce->last_fire_us = now;
+        coalesce->skipped = 0;
+        coalesce->pending = 0;
+        coalesce->fired++;
+    } else {
+        coalesce->skipped++;
+        coalesce->pending = 1;
+        coalesce->suppressed++;
+    }
+    pthread_mutex_unlock(&mem->coalesce_lock);
+    return admit;
+}
+
+/**
+ * 判断范围规则在 [start, end) 内是否有满足条件的字
+ * 
+ * 与 [start, end) 及规则范围重叠、且完整位于区域内的每个32位字按期望值/掩码比较。
+ * 
+ * @param written 写入记录，不为NULL时按写入后的值比较，否则按当前内容比较
+ * @return 任一字满足返回1，否则返回0
+ */
+static int region_range_matches(const memory_region_t* region, const rule_table_entry_t* rule,
+                                uint64_t start, uint64_t end, const struct device_memory_written* written) {
+    uint64_t base = region->base_addr;
+    uint64_t limit = base + region_size(region);
+    if (start < rule->trigger.trigger_addr) start = rule->trigger.trigger_addr;
+    if (end > rule->trigger.range_end) end = rule->trigger.range_end;
+    if (start < base) start = base;
+    if (end > limit) end = limit;
+    
+    uint32_t mask = rule->trigger.expected_mask;
+    uint32_t expected = rule->trigger.expected_value & mask;
+    for (uint64_t word = start & ~(uint64_t)3; word < end; word += sizeof(uint32_t)) {
+        if (word < base || word + sizeof(uint32_t) > limit) continue;
+        uint32_t value = written ? region_written_word(region, written, word, 0) : region_load32(region, word - base);
+        if ((value & mask) == expected) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// 一次写入就地查询的范围规则数，超过时从堆上分配
+#define DEVICE_MEMORY_RANGE_RULES_STACK 16
+
+// 检查写入范围内各字上的候选规则和重叠的范围规则，调用者位于规则读侧临界区内
+static void device_memory_check_candidates(device_memory_t* mem, struct device_rule_state* state,
+                                           memory_region_t* region, const struct device_memory_written* written) {
+    uint32_t addr = written->addr;
+    size_t width = written->width;
+    // 按（设备类型，触发字）索引只取出写入范围内各字上的候选规则
+    size_t size = region_size(region);
+    uint32_t first_word = addr & ~3u;
+    uint32_t last_word = (uint32_t)((addr + width - 1) & ~(uint64_t)3);
+    for (uint64_t word = first_word; word <= last_word; word += sizeof(uint32_t)) {
+        const int* positions = NULL;
+        int count = 0;
+        const rule_table_entry_t* rules = get_device_rules_at(region->device_type, (uint32_t)word, 
+                                                              &positions, &count);
+        // 规则表与状态不是同一代次（或区域属于其他设备类型）时不使用状态
+        int stateful = state && rules == state->rules;
+        for (int i = 0; i < count; i++) {
+            const rule_table_entry_t* rule = &rules[positions[i]];
+            uint32_t trigger_addr = rule->trigger.trigger_addr;
+            
+            // 未对齐的触发字登记在两个字下，只在写入范围内的第一个字处理一次
+            uint32_t rule_word = trigger_addr & ~3u;
+            if (word != (rule_word > first_word ? rule_word : first_word)) {
+                continue;
+            }
+            // 触发字 [trigger_addr, trigger_addr+4) 与写入范围不重叠
+            if ((uint64_t)trigger_addr + sizeof(uint32_t) <= addr || trigger_addr >= (uint64_t)addr + width) {
+                continue;
+            }
+            // 触发字必须完整位于当前区域内
+            if (trigger_addr < region->base_addr || 
+                (size_t)(trigger_addr - region->base_addr) + sizeof(uint32_t) > size) {
+                continue;
+            }
+            
+            int position = stateful ? positions[i] : -1;
+            uint32_t value = region_written_word(region, written, trigger_addr, 0);
+            uint32_t old_value = written->has_old ? region_written_word(region, written, trigger_addr, 1) : 0;
+            if (device_memory_rule_fires(state, rule, position, value, written->has_old ? &old_value : NULL) &&
+                device_memory_rule_admit(mem, state, rule, position)) {
+                device_memory_execute_rule(mem, state, rule, position);
+            }
+        }
+    }
+    
+    // 区间树取出与写入范围重叠的范围规则，每条规则每次写入最多触发一次
+    int stack_positions[DEVICE_MEMORY_RANGE_RULES_STACK];
+    int* range_positions = stack_positions;
+    int count = 0;
+    uint64_t end = (uint64_t)addr + width;
+    const rule_table_entry_t* rules = get_device_range_rules(region->device_type, addr, end, range_positions,
+                                                             DEVICE_MEMORY_RANGE_RULES_STACK, &count);
+    if (count > DEVICE_MEMORY_RANGE_RULES_STACK) {
+        range_positions = (int*)malloc(count * sizeof(int));
+        if (!range_positions) {
+            printf("错误: 无法分配范围规则列表，只检查前 %d 条\n", DEVICE_MEMORY_RANGE_RULES_STACK);
+            range_positions = stack_positions;
+            count = DEVICE_MEMORY_RANGE_RULES_STACK;
+        } else {
+            rules = get_device_range_rules(region->device_type, addr, end, range_positions, count, &count);
+        }
+    }
+    int stateful = state && rules == state->rules;
+    for (int i = 0; rules && i < count; i++) {
+        const rule_table_entry_t* rule = &rules[range_positions[i]];
+        int position = stateful ? range_positions[i] : -1;
+        if (region_range_matches(region, rule, addr, end, written) &&
+            device_memory_rule_admit(mem, state, rule, position)) {
+            device_memory_execute_rule(mem, state, rule, position);
+        }
+    }
+    if (range_positions != stack_positions) {
+        free(range_positions);
+    }
+}
+
+/**
+ * 检查写入 [addr, addr+width) 后触发的规则
+ * 
+ * 触发地址的32位字与写入范围重叠的规则都会被检查，比较的是这次写入后
+ * 该字的值（写入的字节取自new_value，其余字节取自当前内容），因此8/16/64位
+ * 写入与32位写入的触发语义一致，写入事件晚于之后的写入处理时也按这次写入判断。
+ * 范围与写入重叠的范围规则比较重叠部分的各字，任一字满足即触发一次。
+ * 
+ * @param mem 设备内存
+ * @param region 写入所在的区域
+ * @param addr 写入地址
+ * @param width 写入宽度（字节）
+ * @param new_value 写入的值
+ * @param old_value 写入前的值，未知时为NULL
+ */
+static void device_memory_check_rules(device_memory_t* mem, memory_region_t* region, uint32_t addr, size_t width,
+                                      uint64_t new_value, const uint64_t* old_value) {
+    // 绝大多数写入没有规则关注，规则状态属于当前代次时一次位测试即可跳过规则引擎，
+    // 不需要进入规则读侧（位图属于本设备内存，销毁前不会释放）
+    struct device_rule_state* state = __atomic_load_n(&mem->rule_state, __ATOMIC_ACQUIRE);
+    if (device_rule_state_current(state) && !region_has_trigger(region, addr, width)) {
+        return;
+    }
+    
+    // 规则表代次变化后先重建位图和规则状态；无法重建时逐条检查规则
+    struct device_memory_written written;
+    written.addr = addr;
+    written.width = width;
+    written_bytes(written.new_bytes, width, new_value);
+    written.has_old = old_value != NULL;
+    if (old_value) {
+        written_bytes(written.old_bytes, width, *old_value);
+    }
+    
+    int token = device_rules_read_begin();
+    state = device_memory_rule_state(mem);
+    if (!state || region_has_trigger(region, addr, width)) {
+        device_memory_check_candidates(mem, state, region, &written);
+    }
+    device_rules_read_end(token);
+}
+
+// 按当前值判断被合并的触发是否仍应补发
+static int device_memory_rule_holds(device_memory_t* mem, const rule_table_entry_t* rule) {
+    if (rule_trigger_is_range(&rule->trigger)) {
+        for (int i = 0; i < mem->region_count; i++) {
+            if (region_range_matches(&mem->regions[i], rule, rule->trigger.trigger_addr, rule->trigger.range_end, NULL)) {
+                return 1;
+            }
+        }
+        return 0;
+    }
+    if (rule->trigger.mode == RULE_TRIGGER_CHANGE) {
+        return 1;
+    }
+    uint32_t trigger_addr = rule->trigger.trigger_addr;
+    int index = device_memory_lookup(mem, trigger_addr);
+    if (index < 0) return 0;
+    memory_region_t* region = &mem->regions[index];
+    if ((size_t)(trigger_addr - region->base_addr) + sizeof(uint32_t) > region_size(region)) {
+        return 0;
+    }
+    uint32_t value = region_load32(region, trigger_addr - region->base_addr);
+    uint32_t mask = rule->trigger.expected_mask;
+    return (value & mask) == (rule->trigger.expected_value & mask);
+}
+
+// 补发被合并的触发
+int device_memory_flush_coalesced(device_memory_t* mem, int force) {
+    if (!mem) return -1;
+    
+    int token = device_rules_read_begin();
+    struct device_rule_state* state = device_memory_rule_state(mem);
+    uint64_t now = device_memory_now_us();
+    int flushed = 0;
+    for (int r = 0; state && state->coalesce && r < state->rule_count; r++) {
+        const rule_table_entry_t* rule = &state->rules[r];
+        uint32_t window = __atomic_load_n(&rule->coalesce.window_us, __ATOMIC_RELAXED);
+        // 先按最后的值判断，值已不满足触发条件的合并触发直接丢弃
+        int holds = device_memory_rule_holds(mem, rule);
+        
+        pthread_mutex_lock(&mem->coalesce_lock);
+        struct device_rule_coalesce* coalesce = &state->coalesce[r];
+        int due = coalesce->pending && (force || window == 0 || now - coalesce->last_fire_us >= window);
+        if (due) {
+            coalesce->pending = 0;
+            coalesce->skipped = 0;
+            if (holds) {
+                coalesce->last_fire_us = now;
+                coalesce->fired++;
+                mem->coalesce_flushed++;
+            }
+        }
+        pthread_mutex_unlock(&mem->coalesce_lock);
+        
+        if (due && holds) {
+            device_memory_execute_rule(mem, state, rule, r);
+            flushed++;
+        }
+    }
+    device_rules_read_end(token);
+    return flushed;
+}
+
+// 获取规则合并统计
+int device_memory_coalesce_stats(device_memory_t* mem, device_memory_coalesce_stats_t* stats) {
+    if (!mem || !stats) return -1;
+    
+    // 重建时仍存在的规则沿用合并状态，当前状态的计数即累计值
+    int token = device_rules_read_begin();
+    struct device_rule_state* state = device_memory_rule_state(mem);
+    memset(stats, 0, sizeof(*stats));
+    pthread_mutex_lock(&mem->coalesce_lock);
+    for (int r = 0; state && state->coalesce && r < state->rule_count; r++) {
+        stats->fired += state->coalesce[r].fired;
+        stats->suppressed += state->coalesce[r].suppressed;
+        stats->pending += state->coalesce[r].pending;
+    }
+    stats->flushed = mem->coalesce_flushed;
+    pthread_mutex_unlock(&mem->coalesce_lock);
+    device_rules_read_end(token);
+    return 0;
+}
+
+// 按宽度读取区域中的值
+static uint64_t region_load_width(const memory_region_t* region, size_t offset, size_t width) {
+    switch (width) {
+    case 1: return region_load8(region, offset);
+    case 2: return region_load16(region, offset);
+    case 4: return region_load32(region, offset);
+    default: return region_load64(region, offset);
+    }
+}
+
+// 消费者线程：先交给观察函数，再检查规则
+static void device_memory_handle_event(const write_event_t* event, void* context) {
+    (void)context;
+    if (g_write_event_tap) {
+        g_write_event_tap(event, g_write_event_tap_context);
+    }
+    // 按事件记录的写入前后的值检查规则，不重新读取写入的字节
+    device_memory_check_rules((device_memory_t*)event->source, (memory_region_t*)event->region,
+                              event->addr, event->width, event->new_value, &event->old_value);
+}
+
+/**
+ * 写入完成：开启写入事件队列时发布事件，否则（或队列已满）同步检查规则
+ * 
+ * @param events 写入前取得的队列，old_value只在其不为NULL时有效
+ */
+static void device_memory_write_done(device_memory_t* mem, memory_region_t* region, write_event_queue_t* events,
+                                     uint32_t addr, size_t width, uint64_t old_value, uint64_t new_value) {
+    if (events) {
+        write_event_t event;
+        event.device_type = mem->device_type;
+        event.device_id = mem->device_id;
+        event.addr = addr;
+        event.width = (uint32_t)width;
+        event.old_value = old_value;
+        event.new_value = new_value;
+        event.source = mem;
+        event.region = region;
+        if (write_event_queue_publish(events, &event) == 0) {
+            return;
+        }
+    }
+    device_memory_check_rules(mem, region, addr, width, new_value, events ? &old_value : NULL);
+}
+
+// 开启写入事件队列
+int device_memory_events_start(size_t capacity, write_event_handler_t tap, void* tap_context) {
+    if (g_write_events) return 0;
+    
+    g_write_event_tap = tap;
+    g_write_event_tap_context = tap_context;
+    write_event_queue_t* events = write_event_queue_create(capacity, device_memory_handle_event, NULL);
+    if (!events) return -1;
+    __atomic_store_n(&g_write_events, events, __ATOMIC_RELEASE);
+    return 0;
+}
+
+// 关闭写入事件队列
+void device_memory_events_stop(void) {
+    write_event_queue_t* events = g_write_events;
+    if (!events) return;
+    
+    // 处理中的事件可能触发新的写入并继续发布，先排空再摘下队列
+    write_event_queue_flush(events);
+    __atomic_store_n(&g_write_events, NULL, __ATOMIC_RELEASE);
+    write_event_queue_destroy(events);
+    g_write_event_tap = NULL;
+    g_write_event_tap_context = NULL;
+}
+
+// 等待写入事件处理完成
+int device_memory_events_flush(void) {
+    write_event_queue_t* events = __atomic_load_n(&g_write_events, __ATOMIC_ACQUIRE);
+    return events ? write_event_queue_flush(events) : 0;
+}
+
+// 获取写入事件队列统计
+int device_memory_events_stats(write_event_queue_stats_t* stats) {
+    write_event_queue_t* events = __atomic_load_n(&g_write_events, __ATOMIC_ACQUIRE);
+    if (!events || !stats) return -1;
+    write_event_queue_get_stats(events, stats);
+    return 0;
+}
+
+// 读取内存
+int device_memory_read(device_memory_t* mem, uint32_t addr, uint32_t* value) {
+    if (!mem || !value) return -1;
+    
+    // 查找地址所在的区域
+    memory_region_t* region = device_memory_find_region(mem, addr);
+    if (!region) {
+        printf("Error: Memory read at invalid address 0x%08X\n", addr);
+        return -1;
+    }
+    
+    // 计算区域内的偏移量
+    uint32_t offset = addr - region->base_addr;
+    
+    // 检查对齐
+    if (offset % 4 != 0) {
+        printf("Warning: Unaligned memory read at address 0x%08X\n", addr);
+    }
+    
+    // 防止越界访问
+    if (offset + 4 > region->unit_size * region->length) {
+        printf("Error: Memory read out of bounds at address 0x%08X\n", addr);
+        return -1;
+    }
+    
+    // 读取32位值
+    *value = region_load32(region, offset);
+    
+    // 调试输出
+    printf("DEBUG: device_memory_read - 地址: 0x%08X, 区域基址: 0x%08X, 偏移: %u, 值: 0x%08X\n", 
+           addr, region->base_addr, offset, *value);
+    
+    return 0;
+}
+
+// 写入内存
+int device_memory_write(device_memory_t* mem, uint32_t addr, uint32_t value) {
+    // 获取当前时间戳
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    printf("[%ld.%06ld] device_memory_write - 开始执行，地址: 0x%08X, 值: 0x%08X\n", 
+           tv.tv_sec, (long)tv.tv_usec, addr, value);
+    fflush(stdout);
+    
+    if (!mem) {
+        printf("[%ld.%06ld] device_memory_write - 内存对象为NULL\n", tv.tv_sec, (long)tv.tv_usec);
+        fflush(stdout);
+        return -1;
+    }
+    
+    // 查找地址所在的区域
+    printf("[%ld.%06ld] device_memory_write - 查找地址所在区域\n", tv.tv_sec, (long)tv.tv_usec);
+    fflush(stdout);
+    
+    memory_region_t* region = device_memory_find_region(mem, addr);
+    gettimeofday(&tv, NULL);
+    
+    if (!region) {
+        printf("[%ld.%06ld] device_memory_write - 错误: 内存写入无效地址 0x%08X\n", 
+               tv.tv_sec, (long)tv.tv_usec, addr);
+        fflush(stdout);
+        return -1;
+    }
+    
+    printf("[%ld.%06ld] device_memory_write - 找到区域，基址: 0x%08X, 长度: %u, 设备类型: %d, 设备ID: %d\n", 
+           tv.tv_sec, (long)tv.tv_usec, region->base_addr, (unsigned int)region->length, region->device_type, region->device_id);
+    fflush(stdout);
+    
+    // 计算区域内的偏移量
+    uint32_t offset = addr - region->base_addr;
+    
+    // 检查对齐
+    if (offset % 4 != 0) {
+        printf("[%ld.%06ld] device_memory_write - 警告: 内存写入地址 0x%08X 未对齐\n", 
+               tv.tv_sec, (long)tv.tv_usec, addr);
+        fflush(stdout);
+    }
+    
+    // 防止越界访问
+    if (offset + 4 > region->unit_size * region->length) {
+        printf("[%ld.%06ld] device_memory_write - 错误: 内存写入地址 0x%08X 越界\n", 
+               tv.tv_sec, (long)tv.tv_usec, addr);
+        fflush(stdout);
+        return -1;
+    }
+    
+    printf("[%ld.%06ld] device_memory_write - 准备写入数据到区域偏移 %u\n", 
+           tv.tv_sec, (long)tv.tv_usec, offset);
+    fflush(stdout);
+    
+    // 写入32位值
+    write_event_queue_t* events = __atomic_load_n(&g_write_events, __ATOMIC_ACQUIRE);
+    uint32_t old_value = events ? region_load32(region, offset) : 0;
+    device_memory_write_begin(mem);
+    int ret = region_store32(region, offset, value);
+    device_memory_write_end(mem);
+    if (ret != 0) {
+        return -1;
+    }
+    
+    gettimeofday(&tv, NULL);
+    printf("[%ld.%06ld] device_memory_write - 数据已写入，地址: 0x%08X, 区域基址: 0x%08X, 偏移: %u, 值: 0x%08X\n", 
+           tv.tv_sec, (long)tv.tv_usec, addr, region->base_addr, offset, value);
+    fflush(stdout);
+    
+    // 检查并执行写入地址上的规则（开启写入事件队列时交给消费者线程）
+    device_memory_write_done(mem, region, events, addr, sizeof(uint32_t), old_value, value);
+    
+    gettimeofday(&tv, NULL);
+    printf("[%ld.%06ld] device_memory_write - 写入操作完成\n", tv.tv_sec, (long)tv.tv_usec);
+    fflush(stdout);
+    return 0;
+}
+
+// 读取字节
+int device_memory_read_byte(device_memory_t* mem, uint32_t addr, uint8_t* value) {
+    if (!mem || !value) return -1;
+    
+    // 查找地址所在的区域
+    memory_region_t* region = device_memory_find_region(mem, addr);
+    if (!region) {
+        printf("Error: Byte read at invalid address 0x%08X\n", addr);
+        return -1;
+    }
+    
+    // 计算区域内的偏移量
+    uint32_t offset = addr - region->base_addr;
+    
+    // 防止越界访问
+    if (offset >= region->unit_size * region->length) {
+        printf("Error: Byte read out of bounds at address 0x%08X\n", addr);
+        return -1;
+    }
+    
+    *value = region_load8(region, offset);
+    return 0;
+}
+
+// 写入字节
+int device_memory_write_byte(device_memory_t* mem, uint32_t addr, uint8_t value) {
+    if (!mem) return -1;
+    
+    // 查找地址所在的区域
+    memory_region_t* region = device_memory_find_region(mem, addr);
+    if (!region) {
+        printf("Error: Byte write at invalid address 0x%08X\n", addr);
+        return -1;
+    }
+    
+    // 计算区域内的偏移量
+    uint32_t offset = addr - region->base_addr;
+    
+    // 防止越界访问
+    if (offset >= region->unit_size * region->length) {
+        printf("Error: Byte write out of bounds at address 0x%08X\n", addr);
+        return -1;
+    }
+    
+    device_memory_write_begin(mem);
+    int ret = region_store8(region, offset, value);
+    device_memory_write_end(mem);
+    return ret;
+}
+
+/**
+ * 检查 [addr, addr+length) 是否被连续的区域完整覆盖（不打印任何信息）
+ * 
+ * 区域按基地址升序排列且互不重叠，因此从起始地址所在区域出发，
+ * 只需检查后续区域是否首尾相接。
+ * 
+ * @param first 输出起始地址所在的区域索引（起始地址位于空洞中时为-1）
+ * @param hole_addr 输出第一个空洞的起始地址
+ * @param hole_length 输出该空洞在访问范围内的字节数
+ * @return 完整覆盖返回0，存在空洞返回1
+ */
+static int device_memory_span_regions(device_memory_t* mem, uint32_t addr, size_t length, int* first,
+                                      uint32_t* hole_addr, size_t* hole_length) {
+    uint64_t end = (uint64_t)addr + length;   // 不包含
+    int index = device_memory_lookup(mem, addr);
+    *first = index;
+    
+    uint64_t cursor = addr;
+    if (index >= 0) {
+        for (;;) {
+            cursor = (uint64_t)mem->spans[index].last_addr + 1;
+            if (cursor >= end) return 0;
+            if (index + 1 >= mem->region_count || mem->spans[index + 1].base_addr != cursor) break;
+            index++;
+        }
+    }
+    
+    // cursor 位于空洞中：空洞延伸到下一个区域的起始地址或访问范围末尾
+    uint64_t hole_end = end;
+    int next = index + 1;
+    if (index < 0) {
+        // 起始地址不在任何区域内，找到第一个基地址大于它的区域
+        next = 0;
+        while (next < mem->region_count && mem->spans[next].base_addr < cursor) next++;
+    }
+    if (next < mem->region_count && mem->spans[next].base_addr < hole_end) {
+        hole_end = mem->spans[next].base_addr;
+    }
+    *hole_addr = (uint32_t)cursor;
+    *hole_length = (size_t)(hole_end - cursor);
+    return 1;
+}
+
+// 查找访问范围内的第一个空洞
+int device_memory_find_hole(device_memory_t* mem, uint32_t addr, size_t length, 
+                            uint32_t* hole_addr, size_t* hole_length) {
+    if (!mem || !mem->spans || length == 0 || (uint64_t)addr + length > (1ull << 32)) return -1;
+    
+    int first;
+    uint32_t hole;
+    size_t hole_len;
+    if (device_memory_span_regions(mem, addr, length, &first, &hole, &hole_len) == 0) {
+        return 0;
+    }
+    if (hole_addr) *hole_addr = hole;
+    if (hole_length) *hole_length = hole_len;
+    return 1;
+}
+
+/**
+ * 定位批量访问的起始区域
+ * 
+ * 访问可以跨越首尾相接的多个区域；范围内有空洞时打印空洞位置并返回-1。
+ * 
+ * @return 起始区域索引，失败返回-1
+ */
+static int device_memory_buffer_regions(device_memory_t* mem, uint32_t addr, size_t length, const char* op) {
+    if ((uint64_t)addr + length > (1ull << 32)) {
+        printf("Error: Buffer %s at address 0x%08X, length %zu exceeds address space\n", op, addr, length);
+        return -1;
+    }
+    
+    int first;
+    uint32_t hole_addr;
+    size_t hole_length;
+    if (device_memory_span_regions(mem, addr, length, &first, &hole_addr, &hole_length) != 0) {
+        printf("Error: Buffer %s at address 0x%08X, length %zu hits hole 0x%08X-0x%08X\n", 
+               op, addr, length, hole_addr, (uint32_t)(hole_addr + hole_length - 1));
+        return -1;
+    }
+    return first;
+}
+
+// 批量读取内存：按区域拆分为多段连续复制
+int device_memory_read_buffer(device_memory_t* mem, uint32_t addr, uint8_t* buffer, size_t length) {
+    if (!mem || !mem->spans || !buffer || length == 0) return -1;
+    
+    int index = device_memory_buffer_regions(mem, addr, length, "read");
+    if (index < 0) return -1;
+    
+    while (length > 0) {
+        memory_region_t* region = &mem->regions[index++];
+        size_t offset = addr - region->base_addr;
+        size_t chunk = region_size(region) - offset;
+        if (chunk > length) chunk = length;
+        
+        region_read(region, offset, buffer, chunk);
+        addr += chunk;
+        buffer += chunk;
+        length -= chunk;
+    }
+    return 0;
+}
+
+// 批量写入内存：先确认整个范围没有空洞，再按区域拆分写入
+int device_memory_write_buffer(device_memory_t* mem, uint32_t addr, const uint8_t* buffer, size_t length) {
+    if (!mem || !mem->spans || !buffer || length == 0) return -1;
+    
+    int index = device_memory_buffer_regions(mem, addr, length, "write");
+    if (index < 0) return -1;
+    
+    int ret = 0;
+    device_memory_write_begin(mem);
+    while (ret == 0 && length > 0) {
+        memory_region_t* region = &mem->regions[index++];
+        size_t offset = addr - region->base_addr;
+        size_t chunk = region_size(region) - offset;
+        if (chunk > length) chunk = length;
+        
+        ret = region_write(region, offset, buffer, chunk);
+        addr += chunk;
+        buffer += chunk;
+        length -= chunk;
+    }
+    device_memory_write_end(mem);
+    return ret;
+}
+
+/**
+ * 解析分散/聚集访问的所有段
+ * 
+ * 每段必须完整位于一个区域内。
+ * 
+ * @param regions 输出每段所在的区域
+ * @return 全部有效返回0，否则返回-1
+ */
+static int device_memory_resolve_iov(device_memory_t* mem, const device_iovec_t* iov, int iovcnt,
+                                     memory_region_t** regions, const char* op) {
+    for (int i = 0; i < iovcnt; i++) {
+        if (!iov[i].buffer || iov[i].length == 0) {
+            printf("Error: Invalid %s segment %d at address 0x%08X\n", op, i, iov[i].addr);
+            return -1;
+        }
+        
+        int index = device_memory_lookup(mem, iov[i].addr);
+        if (index < 0) {
+            printf("Error: %s segment %d at invalid address 0x%08X\n", op, i, iov[i].addr);
+            return -1;
+        }
+        
+        memory_region_t* region = &mem->regions[index];
+        if (iov[i].addr - region->base_addr + iov[i].length > region_size(region)) {
+            printf("Error: %s segment %d out of bounds at address 0x%08X, length %zu\n", 
+                   op, i, iov[i].addr, iov[i].length);
+            return -1;
+        }
+        regions[i] = region;
+    }
+    return 0;
+}
+
+// 分配段区域数组，段数较少时使用调用者的栈数组
+static memory_region_t** device_memory_iov_regions(memory_region_t** stack, int iovcnt) {
+    if (iovcnt <= DEVICE_MEMORY_IOV_STACK) {
+        return stack;
+    }
+    return (memory_region_t**)malloc(iovcnt * sizeof(memory_region_t*));
+}
+
+// 分散读取
+int device_memory_readv(device_memory_t* mem, const device_iovec_t* iov, int iovcnt) {
+    if (!mem || !mem->spans || !iov || iovcnt <= 0) return -1;
+    
+    memory_region_t* stack[DEVICE_MEMORY_IOV_STACK];
+    memory_region_t** regions = device_memory_iov_regions(stack, iovcnt);
+    if (!regions) return -1;
+    
+    int ret = device_memory_resolve_iov(mem, iov, iovcnt, regions, "readv");
+    if (ret == 0) {
+        for (int i = 0; i < iovcnt; i++) {
+            region_read(regions[i], iov[i].addr - regions[i]->base_addr, iov[i].buffer, iov[i].length);
+        }
+    }
+    
+    if (regions != stack) free(regions);
+    return ret;
+}
+
+// 聚集写入
+int device_memory_writev(device_memory_t* mem, const device_iovec_t* iov, int iovcnt) {
+    if (!mem || !mem->spans || !iov || iovcnt <= 0) return -1;
+    
+    memory_region_t* stack[DEVICE_MEMORY_IOV_STACK];
+    memory_region_t** regions = device_memory_iov_regions(stack, iovcnt);
+    if (!regions) return -1;
+    
+    int ret = device_memory_resolve_iov(mem, iov, iovcnt, regions, "writev");
+    if (ret == 0) {
+        // 所有段在同一个写入区间内完成，一致性读取不会看到部分写入的结果
+        device_memory_write_begin(mem);
+        for (int i = 0; ret == 0 && i < iovcnt; i++) {
+            ret = region_write(regions[i], iov[i].addr - regions[i]->base_addr, iov[i].buffer, iov[i].length);
+        }
+        device_memory_write_end(mem);
+    }
+    
+    if (regions != stack) free(regions);
+    return ret;
+}
+
+/**
+ * 检查按宽度访问的参数并定位区域
+ * 
+ * 区域设置了MEMORY_REGION_STRICT_WIDTH时，访问宽度必须等于unit_size，
+ * 且地址按unit_size对齐。
+ * 
+ * @return 成功返回区域，失败返回NULL
+ */
+static memory_region_t* device_memory_width_region(device_memory_t* mem, uint32_t addr, 
+                                                   unsigned int width, const char* op, 
+                                                   size_t* offset) {
+    if (width != 1 && width != 2 && width != 4 && width != 8) {
+        printf("Error: Unsupported %u-byte %s at address 0x%08X\n", width, op, addr);
+        return NULL;
+    }
+    
+    memory_region_t* region = device_memory_find_region(mem, addr);
+    if (!region) {
+        printf("Error: %u-byte %s at invalid address 0x%08X\n", width, op, addr);
+        return NULL;
+    }
+    
+    *offset = addr - region->base_addr;
+    if (*offset + width > region_size(region)) {
+        printf("Error: %u-byte %s out of bounds at address 0x%08X\n", width, op, addr);
+        return NULL;
+    }
+    
+    if ((region->flags & MEMORY_REGION_STRICT_WIDTH) && 
+        (width != region->unit_size || *offset % region->unit_size != 0)) {
+        printf("Error: %u-byte %s at address 0x%08X violates unit size %zu of region 0x%08X\n", 
+               width, op, addr, region->unit_size, region->base_addr);
+        return NULL;
+    }
+    
+    return region;
+}
+
+// 按宽度读取内存（1/2/4/8字节）
+int device_memory_read_width(device_memory_t* mem, uint32_t addr, unsigned int width, uint64_t* value) {
+    if (!mem || !value) return -1;
+    
+    size_t offset;
+    memory_region_t* region = device_memory_width_region(mem, addr, width, "read", &offset);
+    if (!region) return -1;
+    
+    switch (width) {
+    case 1: *value = region_load8(region, offset); break;
+    case 2: *value = region_load16(region, offset); break;
+    case 4: *value = region_load32(region, offset); break;
+    default: *value = region_load64(region, offset); break;
+    }
+    return 0;
+}
+
+// 按宽度写入内存（1/2/4/8字节），写入后检查规则
+int device_memory_write_width(device_memory_t* mem, uint32_t addr, unsigned int width, uint64_t value) {
+    if (!mem) return -1;
+    
+    size_t offset;
+    memory_region_t* region = device_memory_width_region(mem, addr, width, "write", &offset);
+    if (!region) return -1;
+    
+    write_event_queue_t* events = __atomic_load_n(&g_write_events, __ATOMIC_ACQUIRE);
+    uint64_t old_value = events ? region_load_width(region, offset, width) : 0;
+    int ret;
+    device_memory_write_begin(mem);
+    switch (width) {
+    case 1: ret = region_store8(region, offset, (uint8_t)value); break;
+    case 2: ret = region_store16(region, offset, (uint16_t)value); break;
+    case 4: ret = region_store32(region, offset, (uint32_t)value); break;
+    default: ret = region_store64(region, offset, value); break;
+    }
+    device_memory_write_end(mem);
+    if (ret != 0) return -1;
+    
+    device_memory_write_done(mem, region, events, addr, width, old_value, value);
+    return 0;
+}
+
+// 读取16位
+int device_memory_read16(device_memory_t* mem, uint32_t addr, uint16_t* value) {
+    uint64_t v;
+    if (!value || device_memory_read_width(mem, addr, sizeof(uint16_t), &v) != 0) return -1;
+    *value = (uint16_t)v;
+    return 0;
+}
+
+// 写入16位
+int device_memory_write16(device_memory_t* mem, uint32_t addr, uint16_t value) {
+    return device_memory_write_width(mem, addr, sizeof(uint16_t), value);
+}
+
+// 读取64位
+int device_memory_read64(device_memory_t* mem, uint32_t addr, uint64_t* value) {
+    return device_memory_read_width(mem, addr, sizeof(uint64_t), value);
+}
+
+// 写入64位
+int device_memory_write64(device_memory_t* mem, uint32_t addr, uint64_t value) {
+    return device_memory_write_width(mem, addr, sizeof(uint64_t), value);
+}
+
+// 区域快照
+typedef struct {
+    uint32_t base_addr;       // 区域基地址
+    size_t size;              // 区域字节数
+    int sparse;               // 是否为稀疏区域
+    uint8_t** pages;          // 区域的页（引用计数，与设备内存和其他快照共享）
+} region_snapshot_t;
+
+// 设备内存快照
+struct device_memory_snapshot {
+    uint64_t generation;           // 快照代号（全局唯一）
+    int region_count;              // 区域数量
+    region_snapshot_t regions[];   // 各区域快照，与设备内存的区域顺序一致
+};
+
+// 快照代号计数器
+static uint64_t g_snapshot_generation = 0;
+
+// 为普通区域分配（或清空）快照后写入页位图
+static int region_reset_touched(memory_region_t* region) {
+    size_t words = (region_page_count(region) + 63) / 64;
+    if (!region->snap_touched) {
+        region->snap_touched = (uint64_t*)calloc(words, sizeof(uint64_t));
+        return region->snap_touched ? 0 : -1;
+    }
+    memset(region->snap_touched, 0, words * sizeof(uint64_t));
+    return 0;
+}
+
+// 普通区域第page页的字节数（最后一页可能不满）
+static size_t region_page_bytes(const memory_region_t* region, size_t page) {
+    size_t offset = page << DEVICE_MEMORY_PAGE_SHIFT;
+    size_t size = region_size(region);
+    return size - offset < DEVICE_MEMORY_PAGE_SIZE ? size - offset : DEVICE_MEMORY_PAGE_SIZE;
+}
+
+// 普通区域第page页自上次快照（或恢复）以来是否未写入，且仍持有那次的页
+static int region_page_unchanged(const memory_region_t* region, size_t page) {
+    return region->snap_pages && region->snap_touched && region->snap_pages[page] &&
+           !(region->snap_touched[page / 64] & (1ULL << (page % 64)));
+}
+
+/**
+ * 记录普通区域当前内容对应的页，并清空写入页位图
+ * 
+ * 下一次快照只复制之后写入过的页。失败时丢弃记录，下一次快照完整复制。
+ */
+static int region_keep_snap_pages(memory_region_t* region, uint8_t** pages) {
+    size_t page_count = region_page_count(region);
+    if (!region->snap_pages) {
+        region->snap_pages = (uint8_t**)calloc(page_count, sizeof(uint8_t*));
+    }
+    if (!region->snap_pages || region_reset_touched(region) != 0) {
+        region_drop_snap_pages(region);
+        return -1;
+    }
+    for (size_t p = 0; p < page_count; p++) {
+        page_ref(pages[p]);
+        page_unref(region->snap_pages[p]);
+        region->snap_pages[p] = pages[p];
+    }
+    return 0;
+}
+
+// 创建设备内存快照
+device_memory_snapshot_t* device_memory_snapshot(device_memory_t* mem) {
+    if (!mem || !mem->regions) return NULL;
     
-    device_memory_t* mem = (device_memory_t*)calloc(1, sizeof(device_memory_t));
-    if (!mem) return NULL;
-    
-    // 分配内存区域数组
-    mem->regions = (memory_region_t*)calloc(config_count, sizeof(memory_region_t));
-    if (!mem->regions) {
-        free(mem);
-        return NULL;
-    }
+    device_memory_snapshot_t* snap = (device_memory_snapshot_t*)calloc(
+        1, sizeof(device_memory_snapshot_t) + mem->region_count * sizeof(region_snapshot_t));
+    if (!snap) return NULL;
     
-    // 复制区域信息并分配每个区域的内存
-    for (int i = 0; i < config_count; i++) {
-        mem->regions[i].base_addr = configs[i].base_addr;
-        mem->regions[i].unit_size = configs[i].unit_size;
-        mem->regions[i].length = configs[i].length;
-        mem->regions[i].device_type = device_type;
-        mem->regions[i].device_id = device_id;
+    snap->region_count = mem->region_count;
+    for (int i = 0; i < mem->region_count; i++) {
+        memory_region_t* region = &mem->regions[i];
+        region_snapshot_t* rs = &snap->regions[i];
+        rs->base_addr = region->base_addr;
+        rs->size = region_size(region);
+        rs->sparse = region->pages != NULL;
         
-        // 计算区域总大小并分配内存
-        size_t region_size = configs[i].unit_size * configs[i].length;
-        mem->regions[i].data = (uint8_t*)calloc(region_size, sizeof(uint8_t));
+        size_t page_count = region_page_count(region);
+        rs->pages = (uint8_t**)calloc(page_count, sizeof(uint8_t*));
+        if (!rs->pages) {
+            device_memory_snapshot_destroy(snap);
+            return NULL;
+        }
+        if (rs->sparse) {
+            // 稀疏区域只复制页指针，数据页由引用计数共享
+            for (size_t p = 0; p < page_count; p++) {
+                rs->pages[p] = region->pages[p];
+                if (rs->pages[p]) page_ref(rs->pages[p]);
+            }
+            continue;
+        }
         
-        if (!mem->regions[i].data) {
-            // 清理已分配的内存
-            for (int j = 0; j < i; j++) {
-                free(mem->regions[j].data);
+        // 普通区域只复制上次快照之后写入过的页，其余页与上次的快照共享
+        for (size_t p = 0; p < page_count; p++) {
+            if (region_page_unchanged(region, p)) {
+                rs->pages[p] = region->snap_pages[p];
+                page_ref(rs->pages[p]);
+                continue;
+            }
+            rs->pages[p] = page_alloc(NULL, 0);
+            if (!rs->pages[p]) {
+                device_memory_snapshot_destroy(snap);
+                mem->snapshot_gen = 0;
+                return NULL;
             }
-            free(mem->regions);
-            free(mem);
+            region_data_load(rs->pages[p], region->data + (p << DEVICE_MEMORY_PAGE_SHIFT), region_page_bytes(region, p));
+        }
+        if (region_keep_snap_pages(region, rs->pages) != 0) {
+            device_memory_snapshot_destroy(snap);
+            mem->snapshot_gen = 0;
             return NULL;
         }
     }
     
-    mem->region_count = config_count;
-    mem->monitor = monitor;
-    mem->device_type = device_type;
-    mem->device_id = device_id;
-    
-    return mem;
+    snap->generation = __atomic_add_fetch(&g_snapshot_generation, 1, __ATOMIC_RELAXED);
+    mem->snapshot_gen = snap->generation;
+    return snap;
 }
 
-// 创建设备内存
-device_memory_t* device_memory_create(const memory_region_t* regions, int region_count, 
-                                     void* monitor, uint32_t device_type, uint32_t device_id) {
-    if (!regions || region_count <= 0) {
-        return NULL;
-    }
+// 恢复设备内存到快照状态
+int device_memory_restore(device_memory_t* mem, const device_memory_snapshot_t* snap) {
+    if (!mem || !mem->regions || !snap) return -1;
     
-    // 分配设备内存结构
-    device_memory_t* memory = (device_memory_t*)calloc(1, sizeof(device_memory_t));
-    if (!memory) {
-        return NULL;
+    // 快照必须与当前内存布局一致
+    if (snap->region_count != mem->region_count) {
+        printf("错误: 快照区域数 %d 与设备内存区域数 %d 不一致\n", snap->region_count, mem->region_count);
+        return -1;
     }
-    
-    // 分配区域数组
-    memory->regions = (memory_region_t*)calloc(region_count, sizeof(memory_region_t));
-    if (!memory->regions) {
-        free(memory);
-        return NULL;
+    for (int i = 0; i < mem->region_count; i++) {
+        const memory_region_t* region = &mem->regions[i];
+        const region_snapshot_t* rs = &snap->regions[i];
+        if (rs->base_addr != region->base_addr || rs->size != region_size(region) || 
+            rs->sparse != (region->pages != NULL)) {
+            printf("错误: 快照区域 0x%08X 与设备内存区域 0x%08X 布局不一致\n", rs->base_addr, region->base_addr);
+            return -1;
+        }
     }
     
-    memory->region_count = region_count;
-    memory->monitor = monitor;
-    memory->device_type = device_type;
-    memory->device_id = device_id;
+    int ret = 0;
     
-    // 复制并初始化每个区域
-    for (int i = 0; i < region_count; i++) {
-        memory->regions[i].base_addr = regions[i].base_addr;
-        memory->regions[i].unit_size = regions[i].unit_size;
-        memory->regions[i].length = regions[i].length;
-        memory->regions[i].device_type = device_type;
-        memory->regions[i].device_id = device_id;
+    device_memory_write_begin(mem);
+    for (int i = 0; i < mem->region_count; i++) {
+        memory_region_t* region = &mem->regions[i];
+        const region_snapshot_t* rs = &snap->regions[i];
+        size_t page_count = region_page_count(region);
         
-        // 分配数据内存
-        size_t data_size = regions[i].unit_size * regions[i].length;
-        memory->regions[i].data = (uint8_t*)calloc(1, data_size);
-        if (!memory->regions[i].data) {
-            // 释放已分配的内存
-            for (int j = 0; j < i; j++) {
-                free(memory->regions[j].data);
+        if (rs->sparse) {
+            // 稀疏区域：替换与快照不同的页指针
+            for (size_t p = 0; p < page_count; p++) {
+                if (region->pages[p] == rs->pages[p]) continue;
+                page_unref(region->pages[p]);
+                region->pages[p] = rs->pages[p];
+                if (region->pages[p]) page_ref(region->pages[p]);
+                region_mark_dirty_page(region, p);
             }
-            free(memory->regions);
-            free(memory);
-            return NULL;
+            region->resident_pages = 0;
+            for (size_t p = 0; p < page_count; p++) {
+                if (region->pages[p]) region->resident_pages++;
+            }
+            continue;
+        }
+        
+        // 上次快照（或恢复）之后没有写入、且与这个快照共享的页内容相同，不需要复制
+        for (size_t p = 0; p < page_count; p++) {
+            if (region_page_unchanged(region, p) && region->snap_pages[p] == rs->pages[p]) continue;
+            region_data_store(region->data + (p << DEVICE_MEMORY_PAGE_SHIFT), rs->pages[p], region_page_bytes(region, p));
+            region_mark_dirty_page(region, p);
+        }
+        // 区域内容与快照一致，之后的快照共享快照的页
+        if (region_keep_snap_pages(region, rs->pages) != 0) {
+            ret = -1;
         }
     }
+    device_memory_write_end(mem);
     
-    return memory;
+    mem->snapshot_gen = ret == 0 ? snap->generation : 0;
+    return ret;
 }
 
-// 销毁设备内存
-void device_memory_destroy(device_memory_t* mem) {
-    if (!mem) return;
+// 销毁设备内存快照
+void device_memory_snapshot_destroy(device_memory_snapshot_t* snap) {
+    if (!snap) return;
     
-    if (mem->regions) {
-        // 释放每个区域的内存
-        for (int i = 0; i < mem->region_count; i++) {
-            if (mem->regions[i].data) {
-                free(mem->regions[i].data);
-                mem->regions[i].data = NULL;
+    for (int i = 0; i < snap->region_count; i++) {
+        region_snapshot_t* rs = &snap->regions[i];
+        if (rs->pages) {
+            size_t page_count = (rs->size + DEVICE_MEMORY_PAGE_SIZE - 1) >> DEVICE_MEMORY_PAGE_SHIFT;
+            for (size_t p = 0; p < page_count; p++) {
+                page_unref(rs->pages[p]);
             }
+            free(rs->pages);
         }
-        
-        free(mem->regions);
-        mem->regions = NULL;
     }
-    
-    free(mem);
+    free(snap);
 }
 
-// 读取内存
-int device_memory_read(device_memory_t* mem, uint32_t addr, uint32_t* value) {
-    if (!mem || !value) return -1;
-    
-    // 查找地址所在的区域
-    memory_region_t* region = device_memory_find_region(mem, addr);
-    if (!region) {
-        printf("Error: Memory read at invalid address 0x%08X\n", addr);
+// 获取区域脏页位图的字数（每位对应一页）
+size_t device_memory_dirty_words(const memory_region_t* region) {
+    return region ? region_dirty_words(region) : 0;
+}
+
+// 获取并清除区域的脏页位图
+int device_memory_fetch_clear_dirty(device_memory_t* mem, int region_index, uint64_t* bitmap, size_t words) {
+    if (!mem || !mem->regions || region_index < 0 || region_index >= mem->region_count) {
         return -1;
     }
     
-    // 计算区域内的偏移量
-    uint32_t offset = addr - region->base_addr;
-    
-    // 检查对齐
-    if (offset % 4 != 0) {
-        printf("Warning: Unaligned memory read at address 0x%08X\n", addr);
+    memory_region_t* region = &mem->regions[region_index];
+    size_t total = device_memory_dirty_words(region);
+    if (bitmap && words < total) {
+        printf("错误: 脏页位图缓冲区过小，需要 %zu 个字，提供 %zu 个字\n", total, words);
+        return -1;
     }
     
-    // 防止越界访问
-    if (offset + 4 > region->unit_size * region->length) {
-        printf("Error: Memory read out of bounds at address 0x%08X\n", addr);
-        return -1;
+    // 逐字原子交换：交换之后的写入会重新置位，由下一次获取得到
+    int dirty_pages = 0;
+    for (size_t w = 0; w < total; w++) {
+        uint64_t bits = __atomic_exchange_n(&region->dirty[w], 0, __ATOMIC_ACQUIRE);
+        if (bitmap) bitmap[w] = bits;
+        dirty_pages += __builtin_popcountll(bits);
+    }
+    return dirty_pages;
+}
+
+/**
+ * 定位无锁访问的32位寄存器（不打印任何信息）
+ * 
+ * 只读取页表和区域索引，不更新最近命中缓存，可以被多个线程并发调用。
+ * 
+ * @return 寄存器地址；地址未对齐、不在MEMORY_REGION_LOCKFREE普通区域内时返回NULL
+ */
+static _Atomic uint32_t* device_memory_atomic_word(device_memory_t* mem, uint32_t addr) {
+    if (!mem || !mem->spans || (addr & (sizeof(uint32_t) - 1)) != 0) {
+        return NULL;
     }
     
-    // 读取32位值
-    *value = *(uint32_t*)(region->data + offset);
+    int index = device_memory_decode_page(mem, addr);
+    if (index == PAGE_DECODE_SEARCH) {
+        index = device_memory_search(mem, addr);
+    }
+    if (index < 0) {
+        return NULL;
+    }
     
-    // 调试输出
-    printf("DEBUG: device_memory_read - 地址: 0x%08X, 区域基址: 0x%08X, 偏移: %u, 值: 0x%08X\n", 
-           addr, region->base_addr, offset, *value);
+    memory_region_t* region = &mem->regions[index];
+    size_t offset = addr - region->base_addr;
+    if (!(region->flags & MEMORY_REGION_LOCKFREE) || !region->data || 
+        (offset & (sizeof(uint32_t) - 1)) != 0 || offset + sizeof(uint32_t) > region_size(region)) {
+        return NULL;
+    }
+    return (_Atomic uint32_t*)(region->data + offset);
+}
+
+// 标记无锁写入的寄存器所在页为脏页
+static void device_memory_atomic_mark(device_memory_t* mem, _Atomic uint32_t* word, uint32_t addr) {
+    int index = device_memory_decode_page(mem, addr);
+    if (index == PAGE_DECODE_SEARCH) {
+        index = device_memory_search(mem, addr);
+    }
+    memory_region_t* region = &mem->regions[index];
+    region_mark_written(region, (uint8_t*)word - region->data, sizeof(uint32_t));
+}
+
+// 进入内存指针读侧
+int device_memory_grace_enter(device_memory_grace_t* grace) {
+    for (;;) {
+        uint32_t epoch = __atomic_load_n(&grace->epoch, __ATOMIC_SEQ_CST);
+        int token = (int)(epoch & 1);
+        __atomic_add_fetch(&grace->readers[token], 1, __ATOMIC_SEQ_CST);
+        // 计数后纪元未变：替换者翻转纪元后一定会看到这个读者
+        if (__atomic_load_n(&grace->epoch, __ATOMIC_SEQ_CST) == epoch) {
+            return token;
+        }
+        __atomic_sub_fetch(&grace->readers[token], 1, __ATOMIC_RELEASE);
+    }
+}
+
+// 退出内存指针读侧
+void device_memory_grace_exit(device_memory_grace_t* grace, int token) {
+    __atomic_sub_fetch(&grace->readers[token & 1], 1, __ATOMIC_RELEASE);
+}
+
+// 等待宽限期：翻转纪元，等待翻转前进入的读者全部退出
+void device_memory_grace_wait(device_memory_grace_t* grace) {
+    uint32_t epoch = __atomic_fetch_add(&grace->epoch, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&grace->readers[epoch & 1], __ATOMIC_ACQUIRE) != 0) {
+        sched_yield();
+    }
+}
+
+// 无锁读取32位寄存器（acquire）
+int device_memory_atomic_load32(device_memory_t* mem, uint32_t addr, uint32_t* value) {
+    _Atomic uint32_t* word = device_memory_atomic_word(mem, addr);
+    if (!word || !value) return -1;
     
+    *value = atomic_load_explicit(word, memory_order_acquire);
     return 0;
 }
 
-// 写入内存
-int device_memory_write(device_memory_t* mem, uint32_t addr, uint32_t value) {
-    // 获取当前时间戳
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    printf("[%ld.%06ld] device_memory_write - 开始执行，地址: 0x%08X, 值: 0x%08X\n", 
-           tv.tv_sec, (long)tv.tv_usec, addr, value);
-    fflush(stdout);
+// 无锁写入32位寄存器（release）
+int device_memory_atomic_store32(device_memory_t* mem, uint32_t addr, uint32_t value) {
+    _Atomic uint32_t* word = device_memory_atomic_word(mem, addr);
+    if (!word) return -1;
     
-    if (!mem) {
-        printf("[%ld.%06ld] device_memory_write - 内存对象为NULL\n", tv.tv_sec, (long)tv.tv_usec);
-        fflush(stdout);
-        return -1;
-    }
+    device_memory_write_begin(mem);
+    atomic_store_explicit(word, value, memory_order_release);
+    device_memory_write_end(mem);
+    device_memory_atomic_mark(mem, word, addr);
+    return 0;
+}
+
+// 原子置位
+int device_memory_atomic_fetch_or32(device_memory_t* mem, uint32_t addr, uint32_t bits, uint32_t* old_value) {
+    _Atomic uint32_t* word = device_memory_atomic_word(mem, addr);
+    if (!word) return -1;
     
-    // 查找地址所在的区域
-    printf("[%ld.%06ld] device_memory_write - 查找地址所在区域\n", tv.tv_sec, (long)tv.tv_usec);
-    fflush(stdout);
+    device_memory_write_begin(mem);
+    uint32_t old = atomic_fetch_or_explicit(word, bits, memory_order_acq_rel);
+    device_memory_write_end(mem);
+    if (old_value) *old_value = old;
+    device_memory_atomic_mark(mem, word, addr);
+    return 0;
+}
+
+// 原子清位
+int device_memory_atomic_fetch_and32(device_memory_t* mem, uint32_t addr, uint32_t mask, uint32_t* old_value) {
+    _Atomic uint32_t* word = device_memory_atomic_word(mem, addr);
+    if (!word) return -1;
     
-    memory_region_t* region = device_memory_find_region(mem, addr);
-    gettimeofday(&tv, NULL);
+    device_memory_write_begin(mem);
+    uint32_t old = atomic_fetch_and_explicit(word, mask, memory_order_acq_rel);
+    device_memory_write_end(mem);
+    if (old_value) *old_value = old;
+    device_memory_atomic_mark(mem, word, addr);
+    return 0;
+}
+
+// 原子比较并交换
+int device_memory_atomic_cas32(device_memory_t* mem, uint32_t addr, uint32_t* expected, uint32_t desired) {
+    _Atomic uint32_t* word = device_memory_atomic_word(mem, addr);
+    if (!word || !expected) return -1;
     
-    if (!region) {
-        printf("[%ld.%06ld] device_memory_write - 错误: 内存写入无效地址 0x%08X\n", 
-               tv.tv_sec, (long)tv.tv_usec, addr);
-        fflush(stdout);
-        return -1;
+    device_memory_write_begin(mem);
+    int swapped = atomic_compare_exchange_strong_explicit(word, expected, desired,
+                                                          memory_order_acq_rel, memory_order_acquire);
+    device_memory_write_end(mem);
+    if (!swapped) {
+        return 1;
     }
+    device_memory_atomic_mark(mem, word, addr);
+    return 0;
+}
+
+/**
+ * 定位一致性访问的寄存器所在区域（不打印任何信息，不更新最近命中缓存）
+ * 
+ * @return 区域；地址未对齐或不在普通区域内时返回NULL
+ */
+static memory_region_t* device_memory_consistent_region(device_memory_t* mem, uint32_t addr) {
+    if ((addr & (sizeof(uint32_t) - 1)) != 0) return NULL;
     
-    printf("[%ld.%06ld] device_memory_write - 找到区域，基址: 0x%08X, 长度: %u, 设备类型: %d, 设备ID: %d\n", 
-           tv.tv_sec, (long)tv.tv_usec, region->base_addr, (unsigned int)region->length, region->device_type, region->device_id);
-    fflush(stdout);
-    
-    // 计算区域内的偏移量
-    uint32_t offset = addr - region->base_addr;
-    
-    // 检查对齐
-    if (offset % 4 != 0) {
-        printf("[%ld.%06ld] device_memory_write - 警告: 内存写入地址 0x%08X 未对齐\n", 
-               tv.tv_sec, (long)tv.tv_usec, addr);
-        fflush(stdout);
+    int index = device_memory_decode_page(mem, addr);
+    if (index == PAGE_DECODE_SEARCH) {
+        index = device_memory_search(mem, addr);
     }
+    if (index < 0) return NULL;
     
-    // 防止越界访问
-    if (offset + 4 > region->unit_size * region->length) {
-        printf("[%ld.%06ld] device_memory_write - 错误: 内存写入地址 0x%08X 越界\n", 
-               tv.tv_sec, (long)tv.tv_usec, addr);
-        fflush(stdout);
-        return -1;
+    memory_region_t* region = &mem->regions[index];
+    size_t offset = addr - region->base_addr;
+    if (!region->data || (offset & (sizeof(uint32_t) - 1)) != 0 || 
+        offset + sizeof(uint32_t) > region_size(region)) {
+        return NULL;
     }
+    return region;
+}
+
+/**
+ * 解析一致性访问的所有地址
+ * 
+ * 寄存器较少时使用调用者的栈数组，与分散访问共用DEVICE_MEMORY_IOV_STACK。
+ * 
+ * @return 区域数组（调用者在其不等于stack时释放）；任一地址无效时返回NULL
+ */
+static memory_region_t** device_memory_consistent_regions(device_memory_t* mem, const uint32_t* addrs, 
+                                                          int count, memory_region_t** stack, const char* op) {
+    memory_region_t** regions = device_memory_iov_regions(stack, count);
+    if (!regions) return NULL;
     
-    printf("[%ld.%06ld] device_memory_write - 准备写入数据到内存地址 0x%p\n", 
-           tv.tv_sec, (long)tv.tv_usec, (void*)(region->data + offset));
-    fflush(stdout);
-    
-    // 写入32位值
-    uint32_t* write_addr = (uint32_t*)(region->data + offset);
-    *write_addr = value;
+    for (int i = 0; i < count; i++) {
+        regions[i] = device_memory_consistent_region(mem, addrs[i]);
+        if (!regions[i]) {
+            printf("Error: Consistent %s at invalid address 0x%08X\n", op, addrs[i]);
+            if (regions != stack) free(regions);
+            return NULL;
+        }
+    }
+    return regions;
+}
+
+// 顺序锁读取失败时先自旋，超过该次数后让出CPU
+#define DEVICE_MEMORY_SEQ_SPINS 64
+
+// 一致性读取多个32位寄存器
+int device_memory_read_consistent(device_memory_t* mem, const uint32_t* addrs, uint32_t* values, int count) {
+    if (!mem || !mem->spans || !addrs || !values || count <= 0) return -1;
     
-    gettimeofday(&tv, NULL);
-    printf("[%ld.%06ld] device_memory_write - 数据已写入，地址: 0x%08X, 区域基址: 0x%08X, 偏移: %u, 值: 0x%08X\n", 
-           tv.tv_sec, (long)tv.tv_usec, addr, region->base_addr, offset, value);
-    fflush(stdout);
+    // 先解析全部地址，重试时不再重复解码
+    memory_region_t* stack[DEVICE_MEMORY_IOV_STACK];
+    memory_region_t** regions = device_memory_consistent_regions(mem, addrs, count, stack, "read");
+    if (!regions) return -1;
     
-   {
-        gettimeofday(&tv, NULL);
-        printf("[%ld.%06ld] device_memory_write - 无监视器\n", tv.tv_sec, (long)tv.tv_usec);
-        fflush(stdout);
-        
-        // 直接检查设备规则表
-        gettimeofday(&tv, NULL);
-        printf("[%ld.%06ld] device_memory_write - 直接检查设备规则表\n", tv.tv_sec, (long)tv.tv_usec);
-        fflush(stdout);
-        
-        // 获取设备规则表并检查
-        int rule_count = 0;
-        const rule_table_entry_t* rules = get_device_rules(region->device_type, &rule_count);
-        
-        if (rules && rule_count > 0) {
-            printf("[%ld.%06ld] device_memory_write - 找到 %d 条规则，开始检查\n", 
-                  tv.tv_sec, (long)tv.tv_usec, rule_count);
-            fflush(stdout);
-            
-            // 检查每条规则
-            for (int i = 0; i < rule_count; i++) {
-                const rule_table_entry_t* rule = &rules[i];
-                
-                printf("[%ld.%06ld] device_memory_write - 检查规则 %d: 触发地址=0x%08X, 当前地址=0x%08X\n", 
-                      tv.tv_sec, (long)tv.tv_usec, i, rule->trigger.trigger_addr, addr);
-                fflush(stdout);
-                
-                // 检查是否满足触发条件
-                if (rule->trigger.trigger_addr == addr) {
-                    uint32_t masked_value = value & rule->trigger.expected_mask;
-                    uint32_t expected_masked = rule->trigger.expected_value & rule->trigger.expected_mask;
-                    
-                    printf("[%ld.%06ld] device_memory_write - 检查规则触发条件: 地址=0x%08X, 值=0x%08X, 掩码=0x%08X, 期望值=0x%08X\n", 
-                          tv.tv_sec, (long)tv.tv_usec, rule->trigger.trigger_addr, value, rule->trigger.expected_mask, rule->trigger.expected_value);
-                    printf("[%ld.%06ld] device_memory_write - 掩码后的值: 0x%08X, 期望的掩码后的值: 0x%08X\n", 
-                          tv.tv_sec, (long)tv.tv_usec, masked_value, expected_masked);
-                    fflush(stdout);
-                    
-                    if (masked_value == expected_masked) {
-                        printf("[%ld.%06ld] device_memory_write - 规则 \"%s\" 触发条件满足，执行处理动作\n", 
-                              tv.tv_sec, (long)tv.tv_usec, rule->name);
-                        fflush(stdout);
-                        
-                        // 打印规则的目标动作信息
-                        printf("[%ld.%06ld] device_memory_write - 规则目标动作数量: %d\n", 
-                              tv.tv_sec, (long)tv.tv_usec, rule->targets.count);
-                        for (int j = 0; j < rule->targets.count; j++) {
-                            action_target_t* target = &rule->targets.targets[j];
-                            printf("[%ld.%06ld] device_memory_write - 目标动作[%d]: 类型=%d, 设备类型=%d, 设备ID=%d, 地址=0x%08X, 值=0x%08X\n", 
-                                  tv.tv_sec, (long)tv.tv_usec, j, target->type, target->device_type, target->device_id, 
-                                  target->target_addr, target->target_value);
-                            fflush(stdout);
-                        }
-                        
-                        // 创建临时规则
-                        action_rule_t temp_rule;
-                        memset(&temp_rule, 0, sizeof(temp_rule));
-                        temp_rule.rule_id = 0xFFFF;  // 临时ID
-                        temp_rule.name = rule->name;
-                        temp_rule.trigger = rule->trigger;
-                        temp_rule.priority = rule->priority;
-                        temp_rule.targets = rule->targets;
-                        
-                        // 获取设备管理器和动作管理器
-                        device_manager_t* dm = device_manager_get_instance();
-                        action_manager_t* am = action_manager_get_instance();
-                        
-                        printf("[%ld.%06ld] device_memory_write - 获取管理器: dm=%p, am=%p\n", 
-                               tv.tv_sec, (long)tv.tv_usec, (void*)dm, (void*)am);
-                        
-                        // 修改目标动作的设备类型和ID
-                        for (int j = 0; j < temp_rule.targets.count; j++) {
-                            action_target_t* target = &temp_rule.targets.targets[j];
-                            // 如果目标动作没有指定设备类型和ID，则使用当前内存对象的设备类型和ID
-                            if (target->device_type == 0) {
-                                target->device_type = mem->device_type;
-                            }
-                            if (target->device_id == 0) {
-                                target->device_id = mem->device_id;
-                            }
-                            printf("[%ld.%06ld] device_memory_write - 更新目标动作[%d]: 类型=%d, 设备类型=%d, 设备ID=%d, 地址=0x%08X, 值=0x%08X\n", 
-                                   tv.tv_sec, (long)tv.tv_usec, j, target->type, target->device_type, 
-                                   target->device_id, target->target_addr, target->target_value);
-                        }
-                        
-                        if (dm && am) {
-                            // 如果找到了设备管理器和动作管理器，则使用动作管理器执行规则
-                            printf("[%ld.%06ld] device_memory_write - 找到设备管理器和动作管理器，执行规则\n", 
-                                   tv.tv_sec, (long)tv.tv_usec);
-                            int result = action_manager_execute_rule(am, &temp_rule, dm);
-                            printf("[%ld.%06ld] device_memory_write - 规则执行结果: %d\n", 
-                                   tv.tv_sec, (long)tv.tv_usec, result);
-                        } else if (dm) {
-                            printf("[%ld.%06ld] device_memory_write - 找到设备管理器，但无法获取动作管理器，无法执行规则\n", 
-                                  tv.tv_sec, (long)tv.tv_usec);
-                            fflush(stdout);
-                            
-                            // 这里我们可以直接执行动作，而不是通过动作管理器
-                            // 但这需要实现一个简化版的执行动作函数
-                            for (int j = 0; j < temp_rule.targets.count; j++) {
-                                action_target_t* target = &temp_rule.targets.targets[j];
-                                if (target->type == ACTION_TYPE_WRITE) {
-                                    // 获取目标设备
-                                    device_instance_t* target_device = 
-                                        device_get(dm, target->device_type, target->device_id);
-                                    
-                                    if (target_device) {
-                                        // 执行写入操作
-                                        uint32_t write_value = target->target_value;
-                                        printf("[%ld.%06ld] device_memory_write - 执行写入操作: 设备类型=%d, 设备ID=%d, 地址=0x%08X, 值=0x%08X\n", 
-                                              tv.tv_sec, (long)tv.tv_usec, target->device_type, target->device_id, 
-                                              target->target_addr, write_value);
-                                        fflush(stdout);
-                                        
-                                        // 调用设备写入函数
-                                        // 获取设备类型
-                                        device_type_t* device_type = &dm->types[target->device_type];
-                                        if (device_type && device_type->ops.write) {
-                                            int result = device_type->ops.write(target_device, 
-                                                                             target->target_addr, 
-                                                                             write_value);
-                                            printf("[%ld.%06ld] device_memory_write - 写入结果: %d\n", 
-                                                  tv.tv_sec, (long)tv.tv_usec, result);
-                                            fflush(stdout);
-                                        } else {
-                                            printf("[%ld.%06ld] device_memory_write - 设备不支持写入操作\n", 
-                                                  tv.tv_sec, (long)tv.tv_usec);
-                                            fflush(stdout);
-                                        }
-                                    } else {
-                                        printf("[%ld.%06ld] device_memory_write - 未找到目标设备\n", 
-                                              tv.tv_sec, (long)tv.tv_usec);
-                                        fflush(stdout);
-                                    }
-                                } else {
-                                    printf("[%ld.%06ld] device_memory_write - 不支持的动作类型: %d\n", 
-                                          tv.tv_sec, (long)tv.tv_usec, target->type);
-                                    fflush(stdout);
-                                }
-                            }
-                        } else {
-                            printf("[%ld.%06ld] device_memory_write - 无法获取设备管理器，无法执行规则\n", 
-                                  tv.tv_sec, (long)tv.tv_usec);
-                            fflush(stdout);
-                        }
-                    }
-                }
+    _Atomic uint32_t* begin = (_Atomic uint32_t*)&mem->write_begin;
+    _Atomic uint32_t* end = (_Atomic uint32_t*)&mem->write_end;
+    for (int spins = 0; ; spins++) {
+        // 先读完成计数再读开始计数：两者相等说明此刻没有写入在进行
+        uint32_t seq_end = atomic_load_explicit(end, memory_order_acquire);
+        uint32_t seq = atomic_load_explicit(begin, memory_order_acquire);
+        if (seq == seq_end) {
+            for (int i = 0; i < count; i++) {
+                uint8_t* word = regions[i]->data + (addrs[i] - regions[i]->base_addr);
+                values[i] = atomic_load_explicit((_Atomic uint32_t*)word, memory_order_relaxed);
             }
-        } else {
-            printf("[%ld.%06ld] device_memory_write - 未找到设备类型 %d 的规则\n", 
-                  tv.tv_sec, (long)tv.tv_usec, region->device_type);
-            fflush(stdout);
+            // 数据读取必须先于再次检查序号
+            atomic_thread_fence(memory_order_acquire);
+            if (atomic_load_explicit(begin, memory_order_relaxed) == seq) break;
+        }
+        if (spins >= DEVICE_MEMORY_SEQ_SPINS) {
+            sched_yield();
         }
     }
     
-    gettimeofday(&tv, NULL);
-    printf("[%ld.%06ld] device_memory_write - 写入操作完成\n", tv.tv_sec, (long)tv.tv_usec);
-    fflush(stdout);
+    if (regions != stack) free(regions);
     return 0;
 }
 
-// 读取字节
-int device_memory_read_byte(device_memory_t* mem, uint32_t addr, uint8_t* value) {
-    if (!mem || !value) return -1;
+// 一致性写入多个32位寄存器
+int device_memory_write_consistent(device_memory_t* mem, const uint32_t* addrs, const uint32_t* values, int count) {
+    if (!mem || !mem->spans || !addrs || !values || count <= 0) return -1;
     
-    // 查找地址所在的区域
-    memory_region_t* region = device_memory_find_region(mem, addr);
-    if (!region) {
-        printf("Error: Byte read at invalid address 0x%08X\n", addr);
-        return -1;
+    memory_region_t* stack[DEVICE_MEMORY_IOV_STACK];
+    memory_region_t** regions = device_memory_consistent_regions(mem, addrs, count, stack, "write");
+    if (!regions) return -1;
+    
+    // 开启写入事件队列时记录旧值
+    write_event_queue_t* events = __atomic_load_n(&g_write_events, __ATOMIC_ACQUIRE);
+    uint32_t old_stack[DEVICE_MEMORY_IOV_STACK];
+    uint32_t* old_values = NULL;
+    if (events) {
+        old_values = count <= DEVICE_MEMORY_IOV_STACK ? old_stack : (uint32_t*)malloc(count * sizeof(uint32_t));
+        // 分配失败时不发布事件，同步检查规则
+        if (!old_values) events = NULL;
     }
     
-    // 计算区域内的偏移量
-    uint32_t offset = addr - region->base_addr;
+    device_memory_write_begin(mem);
+    for (int i = 0; i < count; i++) {
+        if (events) {
+            old_values[i] = region_load32(regions[i], addrs[i] - regions[i]->base_addr);
+        }
+        region_store32(regions[i], addrs[i] - regions[i]->base_addr, values[i]);
+    }
+    device_memory_write_end(mem);
     
-    // 防止越界访问
-    if (offset >= region->unit_size * region->length) {
-        printf("Error: Byte read out of bounds at address 0x%08X\n", addr);
-        return -1;
+    // 全部写入完成后再按顺序检查规则，规则动作看到的是完整的新值
+    for (int i = 0; i < count; i++) {
+        device_memory_write_done(mem, regions[i], events, addrs[i], sizeof(uint32_t), 
+                                 events ? old_values[i] : 0, values[i]);
     }
     
-    *value = region->data[offset];
+    if (old_values && old_values != old_stack) free(old_values);
+    
+    if (regions != stack) free(regions);
     return 0;
 }
 
-// 写入字节
-int device_memory_write_byte(device_memory_t* mem, uint32_t addr, uint8_t value) {
-    if (!mem) return -1;
-    
-    // 查找地址所在的区域
-    memory_region_t* region = device_memory_find_region(mem, addr);
-    if (!region) {
-        printf("Error: Byte write at invalid address 0x%08X\n", addr);
+// 区域是否可以导出到memfd（只导出数据位于slab中的普通区域）
+static int region_exportable(const memory_region_t* region) {
+    return region->data && !(region->flags & MEMORY_REGION_FILE_MASK) && !region->pages;
+}
+
+/**
+ * 创建memfd并把可导出区域的数据迁移进去
+ * 
+ * 每个区域在memfd中的偏移按系统页大小对齐，消费者可以只映射自己关心的区域。
+ * 
+ * @return 成功返回0，失败返回-1（区域仍使用slab中的数据）
+ */
+static int device_memory_create_export(device_memory_t* mem) {
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    size_t total = 0;
+    for (int i = 0; i < mem->region_count; i++) {
+        if (region_exportable(&mem->regions[i])) {
+            total += (region_size(&mem->regions[i]) + page_size - 1) & ~(page_size - 1);
+        }
+    }
+    if (total == 0) {
+        printf("错误: 设备内存没有可导出的普通区域\n");
         return -1;
     }
     
-    // 计算区域内的偏移量
-    uint32_t offset = addr - region->base_addr;
-    
-    // 防止越界访问
-    if (offset >= region->unit_size * region->length) {
-        printf("Error: Byte write out of bounds at address 0x%08X\n", addr);
+    char name[64];
+    snprintf(name, sizeof(name), "device_memory_%u_%u", mem->device_type, mem->device_id);
+    int fd = memfd_create(name, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) {
+        printf("错误: 无法创建memfd: %s\n", strerror(errno));
+        return -1;
+    }
+    if (ftruncate(fd, (off_t)total) != 0) {
+        printf("错误: 无法设置memfd大小 %zu: %s\n", total, strerror(errno));
+        close(fd);
         return -1;
     }
     
-    region->data[offset] = value;
-    
-    return 0;
-}
-
-// 批量读取内存
-int device_memory_read_buffer(device_memory_t* mem, uint32_t addr, uint8_t* buffer, size_t length) {
-    if (!mem || !buffer || length == 0) return -1;
-    
-    // 查找地址所在的区域
-    memory_region_t* region = device_memory_find_region(mem, addr);
-    if (!region) {
-        printf("Error: Buffer read at invalid address 0x%08X\n", addr);
+    uint8_t* base = (uint8_t*)mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        printf("错误: 无法映射memfd: %s\n", strerror(errno));
+        close(fd);
         return -1;
     }
     
-    // 计算区域内的偏移量
-    uint32_t offset = addr - region->base_addr;
+    // 固定大小；F_SEAL_FUTURE_WRITE禁止之后的可写映射和write()，已有的共享映射不受影响
+    int seals = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL;
+    int sealed = -1;
+#ifdef F_SEAL_FUTURE_WRITE
+    sealed = fcntl(fd, F_ADD_SEALS, seals | F_SEAL_FUTURE_WRITE);
+#endif
+    if (sealed != 0 && fcntl(fd, F_ADD_SEALS, seals) != 0) {
+        printf("警告: 无法封住memfd: %s\n", strerror(errno));
+    }
     
-    // 防止越界访问
-    if (offset + length > region->unit_size * region->length) {
-        printf("Error: Buffer read out of bounds at address 0x%08X, length %zu\n", addr, length);
-        return -1;
+    size_t offset = 0;
+    for (int i = 0; i < mem->region_count; i++) {
+        memory_region_t* region = &mem->regions[i];
+        if (!region_exportable(region)) continue;
+        
+        size_t size = region_size(region);
+        memcpy(base + offset, region->data, size);
+        region->data = base + offset;
+        offset += (size + page_size - 1) & ~(page_size - 1);
     }
     
-    memcpy(buffer, region->data + offset, length);
+    mem->export_base = base;
+    mem->export_size = total;
+    mem->export_fd = fd;
     return 0;
 }
 
-// 批量写入内存
-int device_memory_write_buffer(device_memory_t* mem, uint32_t addr, const uint8_t* buffer, size_t length) {
-    if (!mem || !buffer || length == 0) return -1;
+// 导出设备内存
+int device_memory_export(device_memory_t* mem, device_memory_export_region_t* layout, 
+                         int max_regions, int* region_count) {
+    if (!mem || !mem->regions || (layout && max_regions < 0)) return -1;
     
-    // 查找地址所在的区域
-    memory_region_t* region = device_memory_find_region(mem, addr);
-    if (!region) {
-        printf("Error: Buffer write at invalid address 0x%08X\n", addr);
+    if (!mem->export_base && device_memory_create_export(mem) != 0) {
         return -1;
     }
     
-    // 计算区域内的偏移量
-    uint32_t offset = addr - region->base_addr;
-    
-    // 防止越界访问
-    if (offset + length > region->unit_size * region->length) {
-        printf("Error: Buffer write out of bounds at address 0x%08X, length %zu\n", addr, length);
-        return -1;
+    // 导出的区域按基地址顺序连续排列在memfd中
+    int count = 0;
+    for (int i = 0; i < mem->region_count; i++) {
+        const memory_region_t* region = &mem->regions[i];
+        if (!region_exportable(region)) continue;
+        
+        if (layout && count < max_regions) {
+            layout[count].base_addr = region->base_addr;
+            layout[count].flags = region->flags;
+            layout[count].size = region_size(region);
+            layout[count].offset = (uint64_t)(region->data - (uint8_t*)mem->export_base);
+        }
+        count++;
     }
     
-    memcpy(region->data + offset, buffer, length);
-    
-    return 0;
-} 
\ No newline at end of file
+    if (region_count) *region_count = count;
+    return mem->export_fd;
+}
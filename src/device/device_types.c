@@ -3,6 +3,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include "device_types.h"
+#include "device_memory.h"
 #include "device_rules.h"
 
 // 全局设备管理器单例
@@ -20,6 +21,7 @@ device_manager_t* device_manager_init(void) {
     if (!dm) return NULL;
     
     pthread_mutex_init(&dm->mutex, NULL);
+    dm->topology_gen = 1;
     for (int i = 0; i < MAX_DEVICE_TYPES; i++) {
         pthread_mutex_init(&dm->types[i].mutex, NULL);
         dm->types[i].instances = NULL;
@@ -37,8 +39,12 @@ void device_manager_destroy(device_manager_t* dm) {
     for (int i = 0; i < MAX_DEVICE_TYPES; i++) {
         printf("Cleaning up device type %d...\n", i);
         
+        // 整条链表摘下后在锁外销毁，理由同 device_destroy
         pthread_mutex_lock(&dm->types[i].mutex);
         device_instance_t* curr = dm->types[i].instances;
+        dm->types[i].instances = NULL;
+        __atomic_add_fetch(&dm->topology_gen, 1, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&dm->types[i].mutex);
         
         while (curr) {
             device_instance_t* next = curr->next;
@@ -59,7 +65,6 @@ void device_manager_destroy(device_manager_t* dm) {
             curr = next;
         }
         
-        pthread_mutex_unlock(&dm->types[i].mutex);
         printf("  Destroying device type mutex...\n");
         pthread_mutex_destroy(&dm->types[i].mutex);
         printf("Device type %d cleanup completed.\n", i);
@@ -126,6 +131,7 @@ device_instance_t* device_create(device_manager_t* dm, device_type_id_t type_id,
     // 添加到链表头部
     instance->next = type->instances;
     type->instances = instance;
+    __atomic_add_fetch(&dm->topology_gen, 1, __ATOMIC_RELEASE);
     
     pthread_mutex_unlock(&type->mutex);
     return instance;
@@ -149,12 +155,8 @@ void device_destroy(device_manager_t* dm, device_type_id_t type_id, int dev_id)
             } else {
                 type->instances = curr->next;
             }
-            
-            if (type->ops.destroy) {
-                type->ops.destroy(curr);
-            }
-            
-            free(curr);
+            // 先使绑定失效，再销毁实例
+            __atomic_add_fetch(&dm->topology_gen, 1, __ATOMIC_RELEASE);
             break;
         }
         prev = curr;
@@ -162,6 +164,19 @@ void device_destroy(device_manager_t* dm, device_type_id_t type_id, int dev_id)
     }
     
     pthread_mutex_unlock(&type->mutex);
+    
+    // 实例已摘链，销毁在锁外进行：ops.destroy 会等待动作工作线程，
+    // 而工作线程按地址查找设备时需要获取同一把类型锁
+    if (curr) {
+        if (type->ops.destroy) {
+            type->ops.destroy(curr);
+        }
+        free(curr);
+    }
+}
+
+uint32_t device_manager_topology_generation(device_manager_t* dm) {
+    return dm ? __atomic_load_n(&dm->topology_gen, __ATOMIC_ACQUIRE) : 0;
 }
 
 device_instance_t* device_get(device_manager_t* dm, device_type_id_t type_id, int dev_id) {
@@ -247,8 +262,8 @@ device_instance_t* device_create_with_config(device_manager_t* dm, device_type_i
         if (rule_manager) {
             for (int i = 0; i < config->rule_count; i++) {
                 device_rule_t* rule = &config->rules[i];
-                device_rule_add(rule_manager, rule->addr, rule->expected_value, 
-                               rule->expected_mask, rule->targets);
+                device_rule_add_ref(rule_manager, rule->addr, rule->expected_value, 
+                                   rule->expected_mask, rule->targets);
             }
         }
     }
@@ -256,7 +271,80 @@ device_instance_t* device_create_with_config(device_manager_t* dm, device_type_i
     // 添加到链表头部
     instance->next = type->instances;
     type->instances = instance;
+    __atomic_add_fetch(&dm->topology_gen, 1, __ATOMIC_RELEASE);
     
     pthread_mutex_unlock(&type->mutex);
     return instance;
-}
\ No newline at end of file
+}
+
+// 获取设备实例及其内存和互斥锁
+static device_memory_t* device_lookup_memory(device_manager_t* dm, device_type_id_t type_id, int dev_id,
+                                             pthread_mutex_t** mutex) {
+    device_instance_t* instance = device_get(dm, type_id, dev_id);
+    if (!instance) {
+        printf("错误: 未找到设备 类型=%d, ID=%d\n", type_id, dev_id);
+        return NULL;
+    }
+    
+    device_ops_t* ops = &dm->types[type_id].ops;
+    if (!ops->get_memory) {
+        printf("错误: 设备类型 %s 不支持获取设备内存\n", dm->types[type_id].name);
+        return NULL;
+    }
+    
+    *mutex = ops->get_mutex ? ops->get_mutex(instance) : NULL;
+    return ops->get_memory(instance);
+}
+
+// 创建设备内存快照
+device_memory_snapshot_t* device_snapshot(device_manager_t* dm, device_type_id_t type_id, int dev_id) {
+    if (!dm || type_id >= MAX_DEVICE_TYPES) {
+        return NULL;
+    }
+    
+    pthread_mutex_t* mutex = NULL;
+    device_memory_t* memory = device_lookup_memory(dm, type_id, dev_id, &mutex);
+    if (!memory) return NULL;
+    
+    if (mutex) pthread_mutex_lock(mutex);
+    device_memory_snapshot_t* snap = device_memory_snapshot(memory);
+    if (mutex) pthread_mutex_unlock(mutex);
+    
+    return snap;
+}
+
+// 恢复设备内存快照
+int device_restore(device_manager_t* dm, device_type_id_t type_id, int dev_id, 
+                  const device_memory_snapshot_t* snap) {
+    if (!dm || type_id >= MAX_DEVICE_TYPES || !snap) {
+        return -1;
+    }
+    
+    pthread_mutex_t* mutex = NULL;
+    device_memory_t* memory = device_lookup_memory(dm, type_id, dev_id, &mutex);
+    if (!memory) return -1;
+    
+    if (mutex) pthread_mutex_lock(mutex);
+    int ret = device_memory_restore(memory, snap);
+    if (mutex) pthread_mutex_unlock(mutex);
+    
+    return ret;
+}
+
+// 导出设备内存到memfd
+int device_export_memory(device_manager_t* dm, device_type_id_t type_id, int dev_id,
+                         device_memory_export_region_t* layout, int max_regions, int* region_count) {
+    if (!dm || type_id >= MAX_DEVICE_TYPES) {
+        return -1;
+    }
+    
+    pthread_mutex_t* mutex = NULL;
+    device_memory_t* memory = device_lookup_memory(dm, type_id, dev_id, &mutex);
+    if (!memory) return -1;
+    
+    if (mutex) pthread_mutex_lock(mutex);
+    int fd = device_memory_export(memory, layout, max_regions, region_count);
+    if (mutex) pthread_mutex_unlock(mutex);
+    
+    return fd;
+}
@@ -0,0 +1,242 @@
+// src/device/write_event_queue.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include "write_event_queue.h"
+
+// 消费者没有事件时的最长等待时间（纳秒），兜底生产者与消费者之间的唤醒竞争
+#define WRITE_EVENT_IDLE_WAIT_NS  (10 * 1000 * 1000)
+
+// 队列槽位：sequence == 位置 表示空闲，== 位置+1 表示已发布
+typedef struct {
+    uint64_t sequence;
+    write_event_t event;
+} write_event_slot_t;
+
+struct write_event_queue {
+    write_event_slot_t* slots;    // 槽位数组
+    size_t mask;                  // 容量-1
+    uint64_t enqueue_pos;         // 生产者下一个领取位置（原子访问）
+    uint64_t dequeue_pos;         // 消费者下一个读取位置（原子访问）
+    uint64_t consumed;            // 已处理事件数（原子访问）
+    uint64_t overflows;           // 溢出次数（原子访问）
+    uint64_t high_watermark;      // 最大积压深度（原子访问）
+    uint64_t wakeups;             // 唤醒次数（原子访问）
+    int sleeping;                 // 消费者正在等待（原子访问）
+    int stop;                     // 停止标志（原子访问）
+    write_event_handler_t handler;
+    void* context;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t wake_cond;     // 唤醒消费者
+    pthread_cond_t done_cond;     // 消费者处理完一批事件
+};
+
+static __thread write_event_queue_t* t_consumer = NULL;   // 当前线程消费的队列
+
+// 计算条件变量等待的绝对时间
+static void write_event_deadline(struct timespec* ts, long ns) {
+    clock_gettime(CLOCK_REALTIME, ts);
+    ts->tv_nsec += ns;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec += ts->tv_nsec / 1000000000L;
+        ts->tv_nsec %= 1000000000L;
+    }
+}
+
+// 取出一个事件，没有已发布的事件时返回0
+static int write_event_queue_take(write_event_queue_t* queue, write_event_t* event) {
+    uint64_t pos = __atomic_load_n(&queue->dequeue_pos, __ATOMIC_RELAXED);
+    write_event_slot_t* slot = &queue->slots[pos & queue->mask];
+    if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != pos + 1) {
+        return 0;
+    }
+
+    *event = slot->event;
+    // 槽位归还给下一圈的生产者
+    __atomic_store_n(&slot->sequence, pos + queue->mask + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&queue->dequeue_pos, pos + 1, __ATOMIC_RELEASE);
+
+    uint64_t depth = __atomic_load_n(&queue->enqueue_pos, __ATOMIC_RELAXED) - pos;
+    if (depth > queue->high_watermark) {
+        __atomic_store_n(&queue->high_watermark, depth, __ATOMIC_RELAXED);
+    }
+    return 1;
+}
+
+// 消费者线程主循环
+static void* write_event_consumer_main(void* arg) {
+    write_event_queue_t* queue = (write_event_queue_t*)arg;
+    t_consumer = queue;
+
+    for (;;) {
+        write_event_t event;
+        int handled = 0;
+        while (write_event_queue_take(queue, &event)) {
+            queue->handler(&event, queue->context);
+            __atomic_add_fetch(&queue->consumed, 1, __ATOMIC_RELEASE);
+            handled++;
+        }
+
+        pthread_mutex_lock(&queue->mutex);
+        if (handled) {
+            pthread_cond_broadcast(&queue->done_cond);
+        }
+        // 先声明等待再复查队列，与生产者的发布-检查顺序配对
+        __atomic_store_n(&queue->sleeping, 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        uint64_t pos = __atomic_load_n(&queue->dequeue_pos, __ATOMIC_RELAXED);
+        int empty = __atomic_load_n(&queue->slots[pos & queue->mask].sequence, __ATOMIC_ACQUIRE) != pos + 1;
+        int stop = __atomic_load_n(&queue->stop, __ATOMIC_ACQUIRE);
+        if (empty && stop) {
+            __atomic_store_n(&queue->sleeping, 0, __ATOMIC_RELAXED);
+            pthread_mutex_unlock(&queue->mutex);
+            break;
+        }
+        if (empty) {
+            struct timespec deadline;
+            write_event_deadline(&deadline, WRITE_EVENT_IDLE_WAIT_NS);
+            pthread_cond_timedwait(&queue->wake_cond, &queue->mutex, &deadline);
+        }
+        __atomic_store_n(&queue->sleeping, 0, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&queue->mutex);
+    }
+
+    t_consumer = NULL;
+    return NULL;
+}
+
+// 创建队列
+write_event_queue_t* write_event_queue_create(size_t capacity, write_event_handler_t handler, void* context) {
+    if (capacity == 0 || capacity > ((size_t)1 << 24) || !handler) {
+        printf("错误: 无效的写入事件队列参数: capacity=%zu\n", capacity);
+        return NULL;
+    }
+
+    size_t size = 1;
+    while (size < capacity) size <<= 1;
+
+    write_event_queue_t* queue = (write_event_queue_t*)calloc(1, sizeof(write_event_queue_t));
+    if (!queue) return NULL;
+    queue->slots = (write_event_slot_t*)calloc(size, sizeof(write_event_slot_t));
+    if (!queue->slots) {
+        free(queue);
+        return NULL;
+    }
+    for (size_t i = 0; i < size; i++) {
+        queue->slots[i].sequence = i;
+    }
+    queue->mask = size - 1;
+    queue->handler = handler;
+    queue->context = context;
+    pthread_mutex_init(&queue->mutex, NULL);
+    pthread_cond_init(&queue->wake_cond, NULL);
+    pthread_cond_init(&queue->done_cond, NULL);
+
+    if (pthread_create(&queue->thread, NULL, write_event_consumer_main, queue) != 0) {
+        printf("错误: 无法启动写入事件消费者线程\n");
+        pthread_cond_destroy(&queue->done_cond);
+        pthread_cond_destroy(&queue->wake_cond);
+        pthread_mutex_destroy(&queue->mutex);
+        free(queue->slots);
+        free(queue);
+        return NULL;
+    }
+    return queue;
+}
+
+// 销毁队列
+void write_event_queue_destroy(write_event_queue_t* queue) {
+    if (!queue) return;
+    if (t_consumer == queue) {
+        printf("错误: 不能在消费者线程中销毁写入事件队列\n");
+        return;
+    }
+
+    pthread_mutex_lock(&queue->mutex);
+    __atomic_store_n(&queue->stop, 1, __ATOMIC_RELEASE);
+    pthread_cond_signal(&queue->wake_cond);
+    pthread_mutex_unlock(&queue->mutex);
+    pthread_join(queue->thread, NULL);
+
+    pthread_cond_destroy(&queue->done_cond);
+    pthread_cond_destroy(&queue->wake_cond);
+    pthread_mutex_destroy(&queue->mutex);
+    free(queue->slots);
+    free(queue);
+}
+
+// 发布事件
+int write_event_queue_publish(write_event_queue_t* queue, const write_event_t* event) {
+    if (!queue || !event) return -1;
+
+    uint64_t pos = __atomic_load_n(&queue->enqueue_pos, __ATOMIC_RELAXED);
+    write_event_slot_t* slot;
+    for (;;) {
+        slot = &queue->slots[pos & queue->mask];
+        uint64_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        int64_t diff = (int64_t)(sequence - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&queue->enqueue_pos, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // 槽位还没被消费者归还：队列已满
+            __atomic_add_fetch(&queue->overflows, 1, __ATOMIC_RELAXED);
+            return -1;
+        } else {
+            pos = __atomic_load_n(&queue->enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+
+    slot->event = *event;
+    __atomic_store_n(&slot->sequence, pos + 1, __ATOMIC_RELEASE);
+
+    // 消费者空闲时才进入互斥锁唤醒它
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&queue->sleeping, __ATOMIC_RELAXED)) {
+        pthread_mutex_lock(&queue->mutex);
+        __atomic_add_fetch(&queue->wakeups, 1, __ATOMIC_RELAXED);
+        pthread_cond_signal(&queue->wake_cond);
+        pthread_mutex_unlock(&queue->mutex);
+    }
+    return 0;
+}
+
+// 等待已发布的事件处理完成
+int write_event_queue_flush(write_event_queue_t* queue) {
+    if (!queue || t_consumer == queue) return -1;
+
+    uint64_t target = __atomic_load_n(&queue->enqueue_pos, __ATOMIC_ACQUIRE);
+    pthread_mutex_lock(&queue->mutex);
+    while (__atomic_load_n(&queue->consumed, __ATOMIC_ACQUIRE) < target) {
+        struct timespec deadline;
+        write_event_deadline(&deadline, WRITE_EVENT_IDLE_WAIT_NS);
+        pthread_cond_signal(&queue->wake_cond);
+        pthread_cond_timedwait(&queue->done_cond, &queue->mutex, &deadline);
+    }
+    pthread_mutex_unlock(&queue->mutex);
+    return 0;
+}
+
+// 当前线程是否为消费者线程
+int write_event_queue_in_consumer(void) {
+    return t_consumer != NULL;
+}
+
+// 获取统计信息
+void write_event_queue_get_stats(write_event_queue_t* queue, write_event_queue_stats_t* stats) {
+    if (!queue || !stats) return;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->capacity = queue->mask + 1;
+    stats->published = __atomic_load_n(&queue->enqueue_pos, __ATOMIC_ACQUIRE);
+    stats->consumed = __atomic_load_n(&queue->consumed, __ATOMIC_ACQUIRE);
+    stats->overflows = __atomic_load_n(&queue->overflows, __ATOMIC_RELAXED);
+    stats->high_watermark = __atomic_load_n(&queue->high_watermark, __ATOMIC_RELAXED);
+    stats->wakeups = __atomic_load_n(&queue->wakeups, __ATOMIC_RELAXED);
+}
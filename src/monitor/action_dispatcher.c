@@ -0,0 +1,440 @@
+// src/monitor/action_dispatcher.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include "action_dispatcher.h"
+#include "uthash.h"
+
+// 一个strand单次最多连续执行的动作数，超过后让出线程
+#define DISPATCHER_STRAND_BATCH 16
+
+// 计数非零但一轮窃取都落空时的等待时间（微秒）
+#define DISPATCHER_STEAL_BACKOFF_US 100
+
+// 待执行的目标处理动作
+typedef struct dispatch_item {
+    action_target_t target;       // 目标处理动作副本（binding仍指向提交者的共享绑定单元）
+    device_manager_t* dm;         // 设备管理器
+    struct dispatch_item* next;
+} dispatch_item_t;
+
+// strand键：目标设备
+typedef struct {
+    device_type_id_t device_type;
+    int device_id;
+} dispatch_strand_key_t;
+
+// 同一目标设备的动作队列
+typedef struct dispatch_strand {
+    dispatch_strand_key_t key;    // 哈希键
+    dispatch_item_t* head;        // 队首
+    dispatch_item_t* tail;        // 队尾
+    int scheduled;                // 已放入某个工作队列或正在执行
+    UT_hash_handle hh;
+} dispatch_strand_t;
+
+// 工作线程的双端队列（环形缓冲区）
+typedef struct {
+    pthread_mutex_t mutex;
+    dispatch_strand_t** slots;    // strand指针
+    int capacity;                 // 容量
+    int top;                      // 顶部位置（窃取端）
+    int count;                    // 元素数量
+} dispatch_deque_t;
+
+// 工作线程
+typedef struct {
+    action_dispatcher_t* dispatcher;
+    int index;                    // 工作线程序号
+    pthread_t thread;
+    dispatch_deque_t deque;
+} dispatch_worker_t;
+
+struct action_dispatcher {
+    pthread_mutex_t mutex;        // 保护strand表、pending和stop
+    pthread_cond_t work_cond;     // 有新任务
+    pthread_cond_t idle_cond;     // 所有动作执行完成
+    dispatch_strand_t* strands;   // 目标设备 -> strand，只包含有待执行动作的strand
+    int pending;                  // 已提交未完成的动作数
+    int queued;                   // 在工作队列中的strand数
+    int stop;                     // 停止标志
+    unsigned int next_worker;     // 外部提交轮转位置
+    action_execute_fn_t execute;  // 执行函数
+    dispatch_worker_t* workers;   // 工作线程数组
+    int worker_count;             // 工作线程数
+};
+
+static __thread dispatch_worker_t* t_worker = NULL;   // 当前线程对应的工作线程
+
+static int dispatch_deque_init(dispatch_deque_t* deque) {
+    deque->capacity = 16;
+    deque->slots = (dispatch_strand_t**)calloc(deque->capacity, sizeof(dispatch_strand_t*));
+    if (!deque->slots) return -1;
+    deque->top = 0;
+    deque->count = 0;
+    pthread_mutex_init(&deque->mutex, NULL);
+    return 0;
+}
+
+static void dispatch_deque_free(dispatch_deque_t* deque) {
+    pthread_mutex_destroy(&deque->mutex);
+    free(deque->slots);
+    deque->slots = NULL;
+}
+
+// 从底部压入
+static int dispatch_deque_push(dispatch_deque_t* deque, dispatch_strand_t* strand) {
+    pthread_mutex_lock(&deque->mutex);
+    if (deque->count == deque->capacity) {
+        int new_capacity = deque->capacity * 2;
+        dispatch_strand_t** slots = (dispatch_strand_t**)malloc(new_capacity * sizeof(dispatch_strand_t*));
+        if (!slots) {
+            pthread_mutex_unlock(&deque->mutex);
+            return -1;
+        }
+        for (int i = 0; i < deque->count; i++) {
+            slots[i] = deque->slots[(deque->top + i) % deque->capacity];
+        }
+        free(deque->slots);
+        deque->slots = slots;
+        deque->capacity = new_capacity;
+        deque->top = 0;
+    }
+    deque->slots[(deque->top + deque->count) % deque->capacity] = strand;
+    deque->count++;
+    pthread_mutex_unlock(&deque->mutex);
+    return 0;
+}
+
+// 所有者从底部取出最近压入的strand
+static dispatch_strand_t* dispatch_deque_pop(dispatch_deque_t* deque) {
+    dispatch_strand_t* strand = NULL;
+    pthread_mutex_lock(&deque->mutex);
+    if (deque->count > 0) {
+        deque->count--;
+        strand = deque->slots[(deque->top + deque->count) % deque->capacity];
+    }
+    pthread_mutex_unlock(&deque->mutex);
+    return strand;
+}
+
+// 其他线程从顶部窃取最早压入的strand
+static dispatch_strand_t* dispatch_deque_steal(dispatch_deque_t* deque) {
+    dispatch_strand_t* strand = NULL;
+    pthread_mutex_lock(&deque->mutex);
+    if (deque->count > 0) {
+        strand = deque->slots[deque->top];
+        deque->top = (deque->top + 1) % deque->capacity;
+        deque->count--;
+    }
+    pthread_mutex_unlock(&deque->mutex);
+    return strand;
+}
+
+/**
+ * 把strand放入工作队列（调用者持有dispatcher->mutex）
+ *
+ * 工作线程放入自己的队列，其他线程轮转选择。
+ */
+static int dispatcher_schedule(action_dispatcher_t* dispatcher, dispatch_strand_t* strand) {
+    dispatch_worker_t* worker = t_worker;
+    if (!worker || worker->dispatcher != dispatcher) {
+        worker = &dispatcher->workers[dispatcher->next_worker++ % dispatcher->worker_count];
+    }
+    if (dispatch_deque_push(&worker->deque, strand) != 0) {
+        return -1;
+    }
+    __atomic_add_fetch(&dispatcher->queued, 1, __ATOMIC_RELEASE);
+    pthread_cond_signal(&dispatcher->work_cond);
+    return 0;
+}
+
+// 取一个strand：先取自己的队列，再从其他线程窃取
+static dispatch_strand_t* dispatcher_take(dispatch_worker_t* worker) {
+    action_dispatcher_t* dispatcher = worker->dispatcher;
+    dispatch_strand_t* strand = dispatch_deque_pop(&worker->deque);
+    for (int i = 1; !strand && i < dispatcher->worker_count; i++) {
+        dispatch_worker_t* victim = &dispatcher->workers[(worker->index + i) % dispatcher->worker_count];
+        strand = dispatch_deque_steal(&victim->deque);
+    }
+    if (strand) {
+        __atomic_sub_fetch(&dispatcher->queued, 1, __ATOMIC_ACQ_REL);
+    }
+    return strand;
+}
+
+// 删除已清空且未调度的strand（调用者持有dispatcher->mutex），下次提交时重新创建
+static void dispatcher_release_strand(action_dispatcher_t* dispatcher, dispatch_strand_t* strand) {
+    HASH_DEL(dispatcher->strands, strand);
+    free(strand);
+}
+
+// 执行strand中的一批动作
+static void dispatcher_run_strand(action_dispatcher_t* dispatcher, dispatch_strand_t* strand) {
+    pthread_mutex_lock(&dispatcher->mutex);
+    for (;;) {
+        // 摘下一批动作，执行期间同一strand的新动作继续追加到队尾
+        dispatch_item_t* batch = strand->head;
+        dispatch_item_t* last = batch;
+        int count = 1;
+        while (last->next && count < DISPATCHER_STRAND_BATCH) {
+            last = last->next;
+            count++;
+        }
+        strand->head = last->next;
+        if (!strand->head) {
+            strand->tail = NULL;
+        }
+        last->next = NULL;
+        pthread_mutex_unlock(&dispatcher->mutex);
+
+        while (batch) {
+            dispatch_item_t* item = batch;
+            batch = batch->next;
+            dispatcher->execute(&item->target, item->dm);
+            free(item);
+        }
+
+        pthread_mutex_lock(&dispatcher->mutex);
+        dispatcher->pending -= count;
+        if (!strand->head) {
+            // 不在任何工作队列中，也没有其他线程持有：每个目标设备只保留有动作的strand
+            dispatcher_release_strand(dispatcher, strand);
+            break;
+        }
+        // 还有动作时让出线程；放入队列失败就在当前线程继续执行
+        if (dispatcher_schedule(dispatcher, strand) == 0) {
+            break;
+        }
+    }
+    if (dispatcher->pending == 0) {
+        pthread_cond_broadcast(&dispatcher->idle_cond);
+    }
+    pthread_mutex_unlock(&dispatcher->mutex);
+}
+
+// 工作线程主循环
+static void* dispatcher_worker_main(void* arg) {
+    dispatch_worker_t* worker = (dispatch_worker_t*)arg;
+    action_dispatcher_t* dispatcher = worker->dispatcher;
+    t_worker = worker;
+
+    for (;;) {
+        dispatch_strand_t* strand = dispatcher_take(worker);
+        if (strand) {
+            dispatcher_run_strand(dispatcher, strand);
+            continue;
+        }
+
+        pthread_mutex_lock(&dispatcher->mutex);
+        if (__atomic_load_n(&dispatcher->queued, __ATOMIC_ACQUIRE) != 0 && !dispatcher->stop) {
+            // 其他线程已取走strand但还没减计数（或正在放入）：短暂等待新的strand，不空转
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += DISPATCHER_STEAL_BACKOFF_US * 1000L;
+            if (deadline.tv_nsec >= 1000000000L) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&dispatcher->work_cond, &dispatcher->mutex, &deadline);
+        }
+        while (__atomic_load_n(&dispatcher->queued, __ATOMIC_ACQUIRE) == 0 && !dispatcher->stop) {
+            pthread_cond_wait(&dispatcher->work_cond, &dispatcher->mutex);
+        }
+        int stop = dispatcher->stop && __atomic_load_n(&dispatcher->queued, __ATOMIC_ACQUIRE) == 0;
+        pthread_mutex_unlock(&dispatcher->mutex);
+        if (stop) break;
+    }
+
+    t_worker = NULL;
+    return NULL;
+}
+
+// 创建分发器
+action_dispatcher_t* action_dispatcher_create(int worker_count, action_execute_fn_t execute) {
+    if (worker_count <= 0 || worker_count > ACTION_DISPATCHER_MAX_WORKERS || !execute) {
+        printf("错误: 无效的分发器参数: worker_count=%d\n", worker_count);
+        return NULL;
+    }
+
+    action_dispatcher_t* dispatcher = (action_dispatcher_t*)calloc(1, sizeof(action_dispatcher_t));
+    if (!dispatcher) return NULL;
+    dispatcher->workers = (dispatch_worker_t*)calloc(worker_count, sizeof(dispatch_worker_t));
+    if (!dispatcher->workers) {
+        free(dispatcher);
+        return NULL;
+    }
+
+    pthread_mutex_init(&dispatcher->mutex, NULL);
+    pthread_cond_init(&dispatcher->work_cond, NULL);
+    pthread_cond_init(&dispatcher->idle_cond, NULL);
+    dispatcher->execute = execute;
+
+    // 先初始化全部队列再启动线程，工作线程启动后就可能窃取
+    int initialized = 0;
+    for (; initialized < worker_count; initialized++) {
+        dispatch_worker_t* worker = &dispatcher->workers[initialized];
+        worker->dispatcher = dispatcher;
+        worker->index = initialized;
+        if (dispatch_deque_init(&worker->deque) != 0) break;
+    }
+    dispatcher->worker_count = initialized;
+
+    int started = 0;
+    if (initialized == worker_count) {
+        for (; started < worker_count; started++) {
+            dispatch_worker_t* worker = &dispatcher->workers[started];
+            if (pthread_create(&worker->thread, NULL, dispatcher_worker_main, worker) != 0) break;
+        }
+    }
+
+    if (started < worker_count) {
+        printf("错误: 无法启动分发器工作线程\n");
+        pthread_mutex_lock(&dispatcher->mutex);
+        dispatcher->stop = 1;
+        pthread_cond_broadcast(&dispatcher->work_cond);
+        pthread_mutex_unlock(&dispatcher->mutex);
+        for (int i = 0; i < started; i++) {
+            pthread_join(dispatcher->workers[i].thread, NULL);
+        }
+        for (int i = 0; i < initialized; i++) {
+            dispatch_deque_free(&dispatcher->workers[i].deque);
+        }
+        pthread_cond_destroy(&dispatcher->idle_cond);
+        pthread_cond_destroy(&dispatcher->work_cond);
+        pthread_mutex_destroy(&dispatcher->mutex);
+        free(dispatcher->workers);
+        free(dispatcher);
+        return NULL;
+    }
+
+    return dispatcher;
+}
+
+// 销毁分发器
+void action_dispatcher_destroy(action_dispatcher_t* dispatcher) {
+    if (!dispatcher) return;
+
+    if (action_dispatcher_flush(dispatcher) != 0) {
+        printf("错误: 不能在分发器工作线程中销毁分发器\n");
+        return;
+    }
+
+    pthread_mutex_lock(&dispatcher->mutex);
+    dispatcher->stop = 1;
+    pthread_cond_broadcast(&dispatcher->work_cond);
+    pthread_mutex_unlock(&dispatcher->mutex);
+    // 其他线程可能仍在窃取，全部退出后才能释放队列
+    for (int i = 0; i < dispatcher->worker_count; i++) {
+        pthread_join(dispatcher->workers[i].thread, NULL);
+    }
+    for (int i = 0; i < dispatcher->worker_count; i++) {
+        dispatch_deque_free(&dispatcher->workers[i].deque);
+    }
+
+    dispatch_strand_t *strand, *tmp;
+    HASH_ITER(hh, dispatcher->strands, strand, tmp) {
+        HASH_DEL(dispatcher->strands, strand);
+        while (strand->head) {
+            dispatch_item_t* item = strand->head;
+            strand->head = item->next;
+            free(item);
+        }
+        free(strand);
+    }
+
+    pthread_cond_destroy(&dispatcher->idle_cond);
+    pthread_cond_destroy(&dispatcher->work_cond);
+    pthread_mutex_destroy(&dispatcher->mutex);
+    free(dispatcher->workers);
+    free(dispatcher);
+}
+
+// 提交目标处理动作
+int action_dispatcher_submit(action_dispatcher_t* dispatcher, const action_target_t* target, device_manager_t* dm) {
+    if (!dispatcher || !target || !dm) return -1;
+
+    dispatch_item_t* item = (dispatch_item_t*)malloc(sizeof(dispatch_item_t));
+    if (!item) return -1;
+    // 绑定单元由互斥锁和拓扑代号保护，工作线程解析的结果写回共享单元，之后的触发不再查找
+    item->target = *target;
+    item->dm = dm;
+    item->next = NULL;
+
+    dispatch_strand_key_t key;
+    memset(&key, 0, sizeof(key));
+    key.device_type = target->device_type;
+    key.device_id = target->device_id;
+
+    pthread_mutex_lock(&dispatcher->mutex);
+    if (dispatcher->stop) {
+        pthread_mutex_unlock(&dispatcher->mutex);
+        free(item);
+        return -1;
+    }
+
+    dispatch_strand_t* strand = NULL;
+    HASH_FIND(hh, dispatcher->strands, &key, sizeof(key), strand);
+    if (!strand) {
+        strand = (dispatch_strand_t*)calloc(1, sizeof(dispatch_strand_t));
+        if (!strand) {
+            pthread_mutex_unlock(&dispatcher->mutex);
+            free(item);
+            return -1;
+        }
+        strand->key = key;
+        HASH_ADD(hh, dispatcher->strands, key, sizeof(key), strand);
+    }
+
+    if (!strand->scheduled) {
+        if (dispatcher_schedule(dispatcher, strand) != 0) {
+            if (!strand->head) {
+                dispatcher_release_strand(dispatcher, strand);
+            }
+            pthread_mutex_unlock(&dispatcher->mutex);
+            free(item);
+            return -1;
+        }
+        strand->scheduled = 1;
+    }
+
+    if (strand->tail) {
+        strand->tail->next = item;
+    } else {
+        strand->head = item;
+    }
+    strand->tail = item;
+    dispatcher->pending++;
+    pthread_mutex_unlock(&dispatcher->mutex);
+    return 0;
+}
+
+// 等待动作执行完成
+int action_dispatcher_flush(action_dispatcher_t* dispatcher) {
+    if (!dispatcher) return -1;
+    if (t_worker && t_worker->dispatcher == dispatcher) return -1;
+
+    pthread_mutex_lock(&dispatcher->mutex);
+    while (dispatcher->pending > 0) {
+        pthread_cond_wait(&dispatcher->idle_cond, &dispatcher->mutex);
+    }
+    pthread_mutex_unlock(&dispatcher->mutex);
+    return 0;
+}
+
+// 当前的strand数
+int action_dispatcher_strand_count(action_dispatcher_t* dispatcher) {
+    if (!dispatcher) return -1;
+
+    pthread_mutex_lock(&dispatcher->mutex);
+    int count = (int)HASH_COUNT(dispatcher->strands);
+    pthread_mutex_unlock(&dispatcher->mutex);
+    return count;
+}
+
+// 当前线程是否为工作线程
+int action_dispatcher_in_worker(void) {
+    return t_worker != NULL;
+}
@@ -4,16 +4,18 @@
 #include <string.h>
 #include <time.h>
 #include <sys/time.h>
+#include <sched.h>
 #include "action_manager.h"
+#include "action_dispatcher.h"
 #include "device_types.h"
 #include "device_rule_configs.h"
 #include "device_registry.h"
 #include "device_memory.h"
+#include "uthash.h"
 #include "temp_sensor/temp_sensor.h"  // 添加温度传感器头文件
 
 // 前向声明
 static int action_target_count(action_target_array_t* targets);
-static action_target_t* action_target_get(action_target_array_t* targets, int index);
 static int execute_action_target(action_target_t* target, device_manager_t* dm);
 
 // 全局动作管理器实例（单例模式）
@@ -114,9 +116,146 @@ rule_trigger_t rule_trigger_create(uint32_t addr, uint32_t value, uint32_t mask)
     trigger.trigger_addr = addr;
     trigger.expected_value = value;
     trigger.expected_mask = mask;
+    trigger.mode = RULE_TRIGGER_LEVEL;
+    trigger.range_end = 0;
     return trigger;
 }
 
+// 创建范围触发条件
+rule_trigger_t rule_trigger_create_range(uint32_t start, uint32_t end, uint32_t value, uint32_t mask) {
+    rule_trigger_t trigger = rule_trigger_create(start, value, mask);
+    trigger.range_end = end;
+    return trigger;
+}
+
+// 目标池：每块目标数与块数上限，引用不跨块
+#define ACTION_TARGET_POOL_CHUNK       1024
+#define ACTION_TARGET_POOL_MAX_CHUNKS  256
+
+// 目标序列去重表项，键为池中目标序列的字节内容
+typedef struct {
+    action_target_ref_t ref;
+    UT_hash_handle hh;
+} target_pool_entry_t;
+
+typedef struct {
+    action_target_t* chunks[ACTION_TARGET_POOL_MAX_CHUNKS]; // 目标块（原子访问）
+    uint32_t chunk_count;         // 已分配的块数
+    uint32_t chunk_used;          // 最后一块已使用的目标数
+    target_pool_entry_t* entries; // 去重表
+    uint64_t interned;            // 放入次数
+    uint64_t deduplicated;        // 复用次数
+    size_t targets;               // 池中目标数
+    pthread_mutex_t mutex;        // 保护追加和去重表，读取不加锁
+} action_target_pool_t;
+
+static action_target_pool_t g_target_pool = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+// 池中引用对应的目标地址（调用者保证引用有效）
+static action_target_t* target_pool_at(action_target_ref_t ref) {
+    action_target_t* chunk = __atomic_load_n(&g_target_pool.chunks[ref.offset / ACTION_TARGET_POOL_CHUNK],
+                                             __ATOMIC_ACQUIRE);
+    return chunk ? &chunk[ref.offset % ACTION_TARGET_POOL_CHUNK] : NULL;
+}
+
+// 把目标序列放入目标池
+int action_target_pool_intern(const action_target_t* targets, int count, action_target_ref_t* ref) {
+    if (!ref || count < 0 || count > MAX_ACTION_TARGETS || (count > 0 && !targets)) return -1;
+    
+    ref->offset = 0;
+    ref->count = 0;
+    if (count == 0) return 0;
+    
+    size_t bytes = (size_t)count * sizeof(action_target_t);
+    action_target_pool_t* pool = &g_target_pool;
+    pthread_mutex_lock(&pool->mutex);
+    pool->interned++;
+    
+    target_pool_entry_t* entry = NULL;
+    HASH_FIND(hh, pool->entries, targets, bytes, entry);
+    if (entry) {
+        pool->deduplicated++;
+        *ref = entry->ref;
+        pthread_mutex_unlock(&pool->mutex);
+        return 0;
+    }
+    
+    // 当前块放不下时开新块，已发布的目标地址不再变化
+    if (pool->chunk_count == 0 || pool->chunk_used + (uint32_t)count > ACTION_TARGET_POOL_CHUNK) {
+        if (pool->chunk_count >= ACTION_TARGET_POOL_MAX_CHUNKS) {
+            pthread_mutex_unlock(&pool->mutex);
+            printf("错误: 目标池已满（%d个目标）\n", ACTION_TARGET_POOL_CHUNK * ACTION_TARGET_POOL_MAX_CHUNKS);
+            return -1;
+        }
+        action_target_t* chunk = (action_target_t*)calloc(ACTION_TARGET_POOL_CHUNK, sizeof(action_target_t));
+        if (!chunk) {
+            pthread_mutex_unlock(&pool->mutex);
+            return -1;
+        }
+        __atomic_store_n(&pool->chunks[pool->chunk_count], chunk, __ATOMIC_RELEASE);
+        pool->chunk_count++;
+        pool->chunk_used = 0;
+    }
+    
+    entry = (target_pool_entry_t*)calloc(1, sizeof(target_pool_entry_t));
+    if (!entry) {
+        pthread_mutex_unlock(&pool->mutex);
+        return -1;
+    }
+    entry->ref.offset = (pool->chunk_count - 1) * ACTION_TARGET_POOL_CHUNK + pool->chunk_used;
+    entry->ref.count = (uint32_t)count;
+    action_target_t* stored = target_pool_at(entry->ref);
+    memcpy(stored, targets, bytes);
+    pool->chunk_used += (uint32_t)count;
+    pool->targets += (size_t)count;
+    HASH_ADD_KEYPTR(hh, pool->entries, stored, bytes, entry);
+    
+    *ref = entry->ref;
+    pthread_mutex_unlock(&pool->mutex);
+    return 0;
+}
+
+// 按引用取目标序列
+const action_target_t* action_target_pool_get(action_target_ref_t ref) {
+    if (ref.count == 0 || ref.offset / ACTION_TARGET_POOL_CHUNK >= ACTION_TARGET_POOL_MAX_CHUNKS) {
+        return NULL;
+    }
+    return target_pool_at(ref);
+}
+
+// 获取规则表示的内存占用
+void action_manager_get_memory_report(action_memory_report_t* report) {
+    if (!report) return;
+    
+    memset(report, 0, sizeof(*report));
+    report->embedded_rule_bytes = sizeof(rule_table_entry_t) - sizeof(action_target_ref_t) +
+                                  sizeof(action_target_array_t);
+    report->compact_rule_bytes = sizeof(rule_table_entry_t);
+    report->target_bytes = sizeof(action_target_t);
+    
+    pthread_mutex_lock(&g_target_pool.mutex);
+    report->interned = g_target_pool.interned;
+    report->deduplicated = g_target_pool.deduplicated;
+    report->pool_targets = g_target_pool.targets;
+    report->pool_bytes = (size_t)g_target_pool.chunk_count * ACTION_TARGET_POOL_CHUNK * sizeof(action_target_t) +
+                         HASH_COUNT(g_target_pool.entries) * sizeof(target_pool_entry_t);
+    pthread_mutex_unlock(&g_target_pool.mutex);
+}
+
+// 打印每条规则的内存占用
+void action_manager_print_memory_report(void) {
+    action_memory_report_t report;
+    action_manager_get_memory_report(&report);
+    
+    // 目标池中的目标由内容相同的规则共享，按放入次数平摊
+    double shared = report.interned ? (double)report.pool_targets * report.target_bytes / report.interned : 0.0;
+    printf("规则内存占用: 内嵌目标数组 %zu 字节/条，目标池引用 %zu 字节/条 + 平摊目标 %.1f 字节/条\n",
+           report.embedded_rule_bytes, report.compact_rule_bytes, shared);
+    printf("目标池: %zu 个目标（%zu 字节/个），已分配 %zu 字节，放入 %llu 次，复用 %llu 次\n",
+           report.pool_targets, report.target_bytes, report.pool_bytes,
+           (unsigned long long)report.interned, (unsigned long long)report.deduplicated);
+}
+
 // 创建规则表项
 rule_table_entry_t* rule_table_entry_create(const char* name, rule_trigger_t trigger, 
                                           const action_target_array_t* targets, int priority) {
@@ -139,11 +278,11 @@ rule_table_entry_t* rule_table_entry_create(const char* name, rule_trigger_t tri
     entry->trigger = trigger;
     entry->priority = priority;
     
-    // 复制目标数组
-    if (targets) {
-        memcpy(&entry->targets, targets, sizeof(action_target_array_t));
-    } else {
-        memset(&entry->targets, 0, sizeof(action_target_array_t));
+    // 目标动作放入共享目标池
+    if (targets && action_target_pool_intern(targets->targets, targets->count, &entry->targets) != 0) {
+        if (name) free((void*)entry->name);
+        free(entry);
+        return NULL;
     }
     
     return entry;
@@ -158,13 +297,431 @@ void rule_table_entry_destroy(rule_table_entry_t* entry) {
         free((void*)entry->name);
     }
     
-    // 释放目标处理动作数组
-    action_target_array_destroy(&entry->targets);
+    // 目标动作位于共享目标池中，不随表项释放
     
     // 释放表项本身
     free(entry);
 }
 
+// 规则索引键
+typedef struct {
+    uint32_t device_type;         // 触发设备类型
+    uint32_t trigger_word;        // 触发字地址（按4字节对齐）
+} rule_index_key_t;
+
+// 规则索引项：同一触发字上的所有规则位置
+typedef struct {
+    rule_index_key_t key;         // 哈希键
+    int* positions;               // 规则位置数组（按登记顺序）
+    int count;                    // 规则数量
+    int capacity;                 // 数组容量
+    UT_hash_handle hh;            // uthash句柄
+} rule_index_entry_t;
+
+struct rule_index {
+    rule_index_entry_t* table;    // uthash表头
+};
+
+// 创建空的规则索引
+rule_index_t* rule_index_create(void) {
+    return (rule_index_t*)calloc(1, sizeof(rule_index_t));
+}
+
+// 清空规则索引
+void rule_index_clear(rule_index_t* index) {
+    if (!index) return;
+    
+    rule_index_entry_t* entry;
+    rule_index_entry_t* tmp;
+    HASH_ITER(hh, index->table, entry, tmp) {
+        HASH_DEL(index->table, entry);
+        free(entry->positions);
+        free(entry);
+    }
+}
+
+// 销毁规则索引
+void rule_index_destroy(rule_index_t* index) {
+    if (!index) return;
+    
+    rule_index_clear(index);
+    free(index);
+}
+
+// 在一个触发字下登记规则位置
+static int rule_index_add_word(rule_index_t* index, device_type_id_t device_type, uint32_t word, int position) {
+    rule_index_key_t key;
+    memset(&key, 0, sizeof(key));
+    key.device_type = device_type;
+    key.trigger_word = word;
+    
+    rule_index_entry_t* entry = NULL;
+    HASH_FIND(hh, index->table, &key, sizeof(key), entry);
+    if (!entry) {
+        entry = (rule_index_entry_t*)calloc(1, sizeof(rule_index_entry_t));
+        if (!entry) return -1;
+        entry->key = key;
+        HASH_ADD(hh, index->table, key, sizeof(key), entry);
+    }
+    
+    if (entry->count >= entry->capacity) {
+        int new_capacity = entry->capacity ? entry->capacity * 2 : 2;
+        int* positions = (int*)realloc(entry->positions, new_capacity * sizeof(int));
+        if (!positions) return -1;
+        entry->positions = positions;
+        entry->capacity = new_capacity;
+    }
+    entry->positions[entry->count++] = position;
+    return 0;
+}
+
+// 登记一条规则
+int rule_index_add(rule_index_t* index, device_type_id_t device_type, uint32_t trigger_addr, int position) {
+    if (!index || position < 0) return -1;
+    
+    uint32_t first = trigger_addr & ~3u;
+    if (rule_index_add_word(index, device_type, first, position) != 0) {
+        return -1;
+    }
+    
+    // 未对齐的触发字跨越两个字
+    uint64_t last = ((uint64_t)trigger_addr + 3) & ~3ull;
+    if ((trigger_addr & 3u) != 0 && last <= UINT32_MAX) {
+        return rule_index_add_word(index, device_type, (uint32_t)last, position);
+    }
+    return 0;
+}
+
+// 查找触发字覆盖addr所在字的规则
+int rule_index_lookup(const rule_index_t* index, device_type_id_t device_type, uint32_t addr, 
+                      const int** positions) {
+    if (!index || !positions) return 0;
+    
+    rule_index_key_t key;
+    memset(&key, 0, sizeof(key));
+    key.device_type = device_type;
+    key.trigger_word = addr & ~3u;
+    
+    rule_index_entry_t* entry = NULL;
+    HASH_FIND(hh, index->table, &key, sizeof(key), entry);
+    if (!entry) {
+        *positions = NULL;
+        return 0;
+    }
+    *positions = entry->positions;
+    return entry->count;
+}
+
+// 一个触发设备类型的区间树：按起始地址排序的数组，隐式平衡二叉树
+typedef struct {
+    uint32_t device_type;         // 哈希键：触发设备类型
+    uint32_t* starts;             // 区间起始地址（升序）
+    uint32_t* ends;               // 区间结束地址（不含）
+    uint32_t* max_ends;           // 以该位置为根的子树中最大的结束地址
+    int* positions;               // 规则位置
+    int count;                    // 区间数量
+    int built;                    // 已排序并建树的区间数量，之后的区间只是追加，查询不可见
+    int capacity;                 // 数组容量
+    UT_hash_handle hh;            // uthash句柄
+} rule_range_set_t;
+
+struct rule_range_index {
+    rule_range_set_t* table;      // uthash表头
+};
+
+// 创建空的范围规则索引
+rule_range_index_t* rule_range_index_create(void) {
+    return (rule_range_index_t*)calloc(1, sizeof(rule_range_index_t));
+}
+
+// 销毁范围规则索引
+void rule_range_index_destroy(rule_range_index_t* index) {
+    if (!index) return;
+    
+    rule_range_set_t* set;
+    rule_range_set_t* tmp;
+    HASH_ITER(hh, index->table, set, tmp) {
+        HASH_DEL(index->table, set);
+        free(set->starts);
+        free(set->ends);
+        free(set->max_ends);
+        free(set->positions);
+        free(set);
+    }
+    free(index);
+}
+
+// 重新计算 [lo, hi) 子树的最大结束地址，子树根为中点
+static uint32_t rule_range_build(rule_range_set_t* set, int lo, int hi) {
+    if (lo >= hi) return 0;
+    
+    int mid = lo + (hi - lo) / 2;
+    uint32_t max_end = set->ends[mid];
+    uint32_t left = rule_range_build(set, lo, mid);
+    uint32_t right = rule_range_build(set, mid + 1, hi);
+    if (left > max_end) max_end = left;
+    if (right > max_end) max_end = right;
+    set->max_ends[mid] = max_end;
+    return max_end;
+}
+
+// 登记一条范围规则
+int rule_range_index_add(rule_range_index_t* index, device_type_id_t device_type, 
+                         uint32_t start, uint32_t end, int position) {
+    if (!index || position < 0 || end <= start) return -1;
+    
+    uint32_t key = device_type;
+    rule_range_set_t* set = NULL;
+    HASH_FIND(hh, index->table, &key, sizeof(key), set);
+    if (!set) {
+        set = (rule_range_set_t*)calloc(1, sizeof(rule_range_set_t));
+        if (!set) return -1;
+        set->device_type = key;
+        HASH_ADD(hh, index->table, device_type, sizeof(set->device_type), set);
+    }
+    
+    if (set->count >= set->capacity) {
+        int new_capacity = set->capacity ? set->capacity * 2 : 4;
+        uint32_t* starts = (uint32_t*)realloc(set->starts, new_capacity * sizeof(uint32_t));
+        if (starts) set->starts = starts;
+        uint32_t* ends = (uint32_t*)realloc(set->ends, new_capacity * sizeof(uint32_t));
+        if (ends) set->ends = ends;
+        uint32_t* max_ends = (uint32_t*)realloc(set->max_ends, new_capacity * sizeof(uint32_t));
+        if (max_ends) set->max_ends = max_ends;
+        int* positions = (int*)realloc(set->positions, new_capacity * sizeof(int));
+        if (positions) set->positions = positions;
+        if (!starts || !ends || !max_ends || !positions) return -1;
+        set->capacity = new_capacity;
+    }
+    
+    // 只追加，rule_range_index_build时统一排序建树
+    set->starts[set->count] = start;
+    set->ends[set->count] = end;
+    set->positions[set->count] = position;
+    set->count++;
+    return 0;
+}
+
+// 排序用的区间，order为排序前的位置
+typedef struct {
+    uint32_t start;
+    uint32_t end;
+    int position;
+    int order;
+} rule_range_sort_t;
+
+// 按起始地址排序，起始地址相同的保持登记顺序
+static int rule_range_sort_compare(const void* a, const void* b) {
+    const rule_range_sort_t* x = (const rule_range_sort_t*)a;
+    const rule_range_sort_t* y = (const rule_range_sort_t*)b;
+    if (x->start != y->start) return x->start < y->start ? -1 : 1;
+    return x->order - y->order;
+}
+
+// 排序并建立区间树
+int rule_range_index_build(rule_range_index_t* index) {
+    if (!index) return -1;
+    
+    rule_range_set_t* set;
+    rule_range_set_t* tmp;
+    HASH_ITER(hh, index->table, set, tmp) {
+        if (set->built == set->count) continue;
+        
+        rule_range_sort_t* sorted = (rule_range_sort_t*)malloc(set->count * sizeof(rule_range_sort_t));
+        if (!sorted) return -1;
+        for (int i = 0; i < set->count; i++) {
+            sorted[i].start = set->starts[i];
+            sorted[i].end = set->ends[i];
+            sorted[i].position = set->positions[i];
+            sorted[i].order = i;
+        }
+        qsort(sorted, set->count, sizeof(rule_range_sort_t), rule_range_sort_compare);
+        for (int i = 0; i < set->count; i++) {
+            set->starts[i] = sorted[i].start;
+            set->ends[i] = sorted[i].end;
+            set->positions[i] = sorted[i].position;
+        }
+        free(sorted);
+        
+        rule_range_build(set, 0, set->count);
+        set->built = set->count;
+    }
+    return 0;
+}
+
+// 中序遍历 [lo, hi) 子树中与 [start, end) 重叠的区间
+static void rule_range_collect(const rule_range_set_t* set, int lo, int hi, uint64_t start, uint64_t end,
+                               int* positions, int max_positions, int* found) {
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        // 子树内所有区间都在查询起点之前结束
+        if (set->max_ends[mid] <= start) return;
+        
+        rule_range_collect(set, lo, mid, start, end, positions, max_positions, found);
+        // 右侧区间的起点都不小于这里的起点
+        if (set->starts[mid] >= end) return;
+        if (set->ends[mid] > start) {
+            if (*found < max_positions) {
+                positions[*found] = set->positions[mid];
+            }
+            (*found)++;
+        }
+        lo = mid + 1;
+    }
+}
+
+// 查找与 [start, end) 重叠的范围规则
+int rule_range_index_query(const rule_range_index_t* index, device_type_id_t device_type, 
+                           uint64_t start, uint64_t end, int* positions, int max_positions) {
+    if (!index || end <= start || (!positions && max_positions > 0)) return 0;
+    
+    uint32_t key = device_type;
+    rule_range_set_t* set = NULL;
+    HASH_FIND(hh, index->table, &key, sizeof(key), set);
+    if (!set) return 0;
+    
+    int found = 0;
+    rule_range_collect(set, 0, set->built, start, end, positions, max_positions, &found);
+    return found;
+}
+
+// 当前线程嵌套的读侧临界区层数，更新者不能在临界区内等待宽限期
+static __thread int t_read_depth = 0;
+
+// 进入读侧临界区
+int action_manager_read_begin(action_manager_t* am) {
+    for (;;) {
+        uint32_t epoch = __atomic_load_n(&am->read_epoch, __ATOMIC_SEQ_CST);
+        int token = (int)(epoch & 1);
+        __atomic_add_fetch(&am->readers[token], 1, __ATOMIC_SEQ_CST);
+        // 计数后纪元未变：更新者翻转纪元后一定会看到这个读者
+        if (__atomic_load_n(&am->read_epoch, __ATOMIC_SEQ_CST) == epoch) {
+            t_read_depth++;
+            return token;
+        }
+        __atomic_sub_fetch(&am->readers[token], 1, __ATOMIC_RELEASE);
+    }
+}
+
+// 退出读侧临界区
+void action_manager_read_end(action_manager_t* am, int token) {
+    t_read_depth--;
+    __atomic_sub_fetch(&am->readers[token & 1], 1, __ATOMIC_RELEASE);
+}
+
+// 当前发布的规则表
+const action_rule_table_t* action_manager_rules(action_manager_t* am) {
+    return __atomic_load_n(&am->table, __ATOMIC_ACQUIRE);
+}
+
+// 等待宽限期：翻转纪元，等待翻转前进入的读者全部退出（调用者持有am->mutex）
+static void action_manager_synchronize(action_manager_t* am) {
+    uint32_t epoch = __atomic_fetch_add(&am->read_epoch, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&am->readers[epoch & 1], __ATOMIC_ACQUIRE) != 0) {
+        sched_yield();
+    }
+    __atomic_add_fetch(&am->grace_periods, 1, __ATOMIC_RELAXED);
+}
+
+// 创建空规则表，capacity为预计的规则数量
+static action_rule_table_t* rule_table_create(int capacity) {
+    action_rule_table_t* table = (action_rule_table_t*)calloc(1, sizeof(action_rule_table_t));
+    if (!table) return NULL;
+    
+    table->index = rule_index_create();
+    table->ranges = rule_range_index_create();
+    if (capacity > 0) {
+        table->rules = (action_rule_t*)malloc(capacity * sizeof(action_rule_t));
+    }
+    if (!table->index || !table->ranges || (capacity > 0 && !table->rules)) {
+        rule_index_destroy(table->index);
+        rule_range_index_destroy(table->ranges);
+        free(table->rules);
+        free(table);
+        return NULL;
+    }
+    return table;
+}
+
+// 释放规则表
+static void rule_table_free(action_rule_table_t* table) {
+    if (!table) return;
+    
+    for (int i = 0; i < table->rule_count; i++) {
+        if (table->rules[i].name && strcmp(table->rules[i].name, "Unnamed Rule") != 0) {
+            free((void*)table->rules[i].name);
+        }
+    }
+    free(table->rules);
+    rule_index_destroy(table->index);
+    rule_range_index_destroy(table->ranges);
+    free(table);
+}
+
+// 向未发布的规则表追加规则（复制名称）并登记索引，容量由创建时保证
+static void rule_table_append(action_rule_table_t* table, const action_rule_t* rule) {
+    action_rule_t* copy = &table->rules[table->rule_count];
+    *copy = *rule;
+    
+    // 复制名称字符串而不是仅复制指针
+    if (rule->name && strcmp(rule->name, "Unnamed Rule") != 0) {
+        copy->name = strdup(rule->name);
+        if (!copy->name) {
+            // 如果分配失败，使用默认名称
+            copy->name = "Unnamed Rule";
+        }
+    } else {
+        copy->name = "Unnamed Rule";
+    }
+    
+    int indexed;
+    if (rule_trigger_is_range(&copy->trigger)) {
+        indexed = rule_range_index_add(table->ranges, copy->device_type, copy->trigger.trigger_addr,
+                                       copy->trigger.range_end, table->rule_count);
+    } else {
+        indexed = rule_index_add(table->index, copy->device_type, copy->trigger.trigger_addr, table->rule_count);
+    }
+    if (indexed != 0) {
+        printf("错误: 无法为规则 %d 建立索引\n", copy->rule_id);
+    }
+    table->rule_count++;
+}
+
+// 更新前检查：读侧临界区内等待宽限期会等待自己
+static int action_manager_can_update(void) {
+    if (t_read_depth > 0) {
+        printf("错误: 不能在规则读侧临界区内修改规则\n");
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * 发布新规则表并在宽限期后释放旧表（调用者持有am->mutex）
+ */
+static void action_manager_publish(action_manager_t* am, action_rule_table_t* table) {
+    // 追加的范围规则在发布前一次性排序建树
+    if (rule_range_index_build(table->ranges) != 0) {
+        printf("错误: 无法建立范围规则索引\n");
+    }
+    action_rule_table_t* old = am->table;
+    table->version = old ? old->version + 1 : 1;
+    __atomic_store_n(&am->table, table, __ATOMIC_RELEASE);
+    
+    if (old) {
+        action_manager_synchronize(am);
+        rule_table_free(old);
+    }
+}
+
+// 打印当前规则表状态
+static void action_manager_print_state(action_manager_t* am, const char* prefix) {
+    int token = action_manager_read_begin(am);
+    const action_rule_table_t* table = action_manager_rules(am);
+    printf("%s动作管理器状态: rules=%p, rule_count=%d\n", prefix, (void*)table->rules, table->rule_count);
+    action_manager_read_end(am, token);
+}
+
 // 复制目标处理动作数组
 static action_target_array_t* action_target_copy_array(const action_target_t* src) {
     if (!src) return NULL;
@@ -196,8 +753,14 @@ action_manager_t* action_manager_create(void) {
     if (!am) return NULL;
     
     pthread_mutex_init(&am->mutex, NULL);
-    am->rules = NULL;  // 初始化为NULL，而不是分配0大小的内存
-    am->rule_count = 0;
+    // 始终有一张已发布的规则表，读者不需要判空
+    action_rule_table_t* table = rule_table_create(0);
+    if (!table) {
+        pthread_mutex_destroy(&am->mutex);
+        free(am);
+        return NULL;
+    }
+    action_manager_publish(am, table);
     
     return am;
 }
@@ -205,19 +768,13 @@ action_manager_t* action_manager_create(void) {
 void action_manager_destroy(action_manager_t* am) {
     if (!am) return;
     
+    action_manager_stop_async(am);
+    
     pthread_mutex_lock(&am->mutex);
     
-    // 清理所有规则
-    if (am->rules) {
-        for (int i = 0; i < am->rule_count; i++) {
-            if (am->rules[i].name && strcmp(am->rules[i].name, "Unnamed Rule") != 0) {
-                free((void*)am->rules[i].name);
-            }
-            action_target_array_destroy(&am->rules[i].targets);
-        }
-        free(am->rules);
-        am->rules = NULL;
-    }
+    // 清理所有规则（销毁时不应再有读者）
+    rule_table_free(am->table);
+    am->table = NULL;
     
     pthread_mutex_unlock(&am->mutex);
     pthread_mutex_destroy(&am->mutex);
@@ -243,8 +800,11 @@ int action_manager_load_all_rules(action_manager_t* am) {
     // 使用全局规则配置
     int total_rules = 0;
     
+    // 设备类型规则表可能被并发修改，复制到动作管理器之前不能释放
+    int token = device_rules_read_begin();
+    
     printf("开始加载Flash设备规则...\n");
-    printf("动作管理器状态: rules=%p, rule_count=%d\n", am->rules, am->rule_count);
+    action_manager_print_state(am, "");
     // 加载 Flash 设备规则
     int count;
     const rule_table_entry_t* rules = get_device_rules(DEVICE_TYPE_FLASH, &count);
@@ -255,7 +815,7 @@ int action_manager_load_all_rules(action_manager_t* am) {
         if (result == 0) {
             total_rules += count;
             printf("成功加载 %d 条Flash设备规则\n", count);
-            printf("动作管理器状态: rules=%p, rule_count=%d\n", am->rules, am->rule_count);
+            action_manager_print_state(am, "");
         } else {
             printf("加载Flash设备规则失败\n");
         }
@@ -264,7 +824,7 @@ int action_manager_load_all_rules(action_manager_t* am) {
     }
     
     printf("开始加载温度传感器设备规则...\n");
-    printf("动作管理器状态: rules=%p, rule_count=%d\n", am->rules, am->rule_count);
+    action_manager_print_state(am, "");
     // 加载温度传感器设备规则
     rules = get_device_rules(DEVICE_TYPE_TEMP_SENSOR, &count);
     if (rules && count > 0) {
@@ -274,7 +834,7 @@ int action_manager_load_all_rules(action_manager_t* am) {
         if (result == 0) {
             total_rules += count;
             printf("成功加载 %d 条温度传感器设备规则\n", count);
-            printf("动作管理器状态: rules=%p, rule_count=%d\n", am->rules, am->rule_count);
+            action_manager_print_state(am, "");
         } else {
             printf("加载温度传感器设备规则失败\n");
         }
@@ -283,7 +843,7 @@ int action_manager_load_all_rules(action_manager_t* am) {
     }
     
     printf("开始加载FPGA设备规则...\n");
-    printf("动作管理器状态: rules=%p, rule_count=%d\n", am->rules, am->rule_count);
+    action_manager_print_state(am, "");
     // 加载 FPGA 设备规则
     rules = get_device_rules(DEVICE_TYPE_FPGA, &count);
     if (rules && count > 0) {
@@ -293,13 +853,14 @@ int action_manager_load_all_rules(action_manager_t* am) {
         if (result == 0) {
             total_rules += count;
             printf("成功加载 %d 条FPGA设备规则\n", count);
-            printf("动作管理器状态: rules=%p, rule_count=%d\n", am->rules, am->rule_count);
+            action_manager_print_state(am, "");
         } else {
             printf("加载FPGA设备规则失败\n");
         }
     } else {
         printf("未找到FPGA设备规则\n");
     }
+    device_rules_read_end(token);
     
     printf("总共加载了 %d 条规则\n", total_rules);
     return total_rules;
@@ -308,71 +869,55 @@ int action_manager_load_all_rules(action_manager_t* am) {
 // 从规则表批量添加规则
 int action_manager_add_rules_from_table(action_manager_t* am, const rule_table_entry_t* table, int count) {
     if (!am || !table || count <= 0) return -1;
+    if (!action_manager_can_update()) return -1;
     
     printf("开始从规则表添加规则，表地址: %p, 规则数量: %d\n", table, count);
-    printf("当前动作管理器状态: rules=%p, rule_count=%d\n", am->rules, am->rule_count);
     
     pthread_mutex_lock(&am->mutex);
     
-    // 分配新的规则数组
-    printf("准备使用realloc分配内存，当前rules=%p, 新大小=%zu\n", 
-           am->rules, (am->rule_count + count) * sizeof(action_rule_t));
-    
-    action_rule_t* new_rules;
-    if (am->rules == NULL) {
-        // 如果rules为NULL，使用malloc而不是realloc
-        printf("rules为NULL，使用malloc分配内存\n");
-        new_rules = (action_rule_t*)malloc((am->rule_count + count) * sizeof(action_rule_t));
-    } else {
-        // 否则使用realloc
-        new_rules = (action_rule_t*)realloc(am->rules, 
-            (am->rule_count + count) * sizeof(action_rule_t));
-    }
-        
-    if (!new_rules) {
+    // 复制当前规则表，读者继续使用已发布的规则表
+    const action_rule_table_t* current = am->table;
+    printf("当前动作管理器状态: rules=%p, rule_count=%d\n", (void*)current->rules, current->rule_count);
+    action_rule_table_t* next = rule_table_create(current->rule_count + count);
+    if (!next) {
         printf("内存分配失败，无法分配内存\n");
         pthread_mutex_unlock(&am->mutex);
         return -1;
     }
-    
-    printf("内存分配成功，新rules地址=%p\n", new_rules);
-    am->rules = new_rules;
+    for (int i = 0; i < current->rule_count; i++) {
+        rule_table_append(next, &current->rules[i]);
+    }
     
     // 添加规则表中的所有规则
     for (int i = 0; i < count; i++) {
         printf("处理规则 %d/%d\n", i+1, count);
-        action_rule_t* rule = &am->rules[am->rule_count + i];
         const rule_table_entry_t* entry = &table[i];
+        action_rule_t rule;
+        memset(&rule, 0, sizeof(rule));
         
         // 生成规则ID
         static int next_rule_id = 1;
-        rule->rule_id = next_rule_id++;
+        rule.rule_id = next_rule_id++;
         
         // 复制规则内容
         printf("复制规则内容: name=%s, trigger_addr=0x%x\n", 
                entry->name ? entry->name : "NULL", entry->trigger.trigger_addr);
+        rule.name = entry->name;
+        rule.trigger = entry->trigger;
+        rule.priority = entry->priority;
+        rule.device_type = entry->device_type;
         
-        // 复制名称字符串而不是仅复制指针
-        if (entry->name && strcmp(entry->name, "Unnamed Rule") != 0) {
-            rule->name = strdup(entry->name);
-            if (!rule->name) {
-                // 如果分配失败，使用默认名称
-                rule->name = "Unnamed Rule";
-            }
-        } else {
-            rule->name = "Unnamed Rule";
-        }
-        
-        rule->trigger = entry->trigger;
-        rule->priority = entry->priority;
-        
-        // 直接复制目标处理动作数组
+        // 从目标池展开目标处理动作数组
         printf("复制目标处理动作数组: count=%d\n", entry->targets.count);
-        memcpy(&rule->targets, &entry->targets, sizeof(action_target_array_t));
+        const action_target_t* targets = action_target_pool_get(entry->targets);
+        for (uint32_t j = 0; targets && j < entry->targets.count; j++) {
+            action_target_add_to_array(&rule.targets, &targets[j]);
+        }
+        rule_table_append(next, &rule);
     }
     
-    am->rule_count += count;
-    printf("规则添加完成，当前动作管理器状态: rules=%p, rule_count=%d\n", am->rules, am->rule_count);
+    printf("规则添加完成，当前动作管理器状态: rules=%p, rule_count=%d\n", (void*)next->rules, next->rule_count);
+    action_manager_publish(am, next);
     
     pthread_mutex_unlock(&am->mutex);
     return 0;
@@ -380,72 +925,449 @@ int action_manager_add_rules_from_table(action_manager_t* am, const rule_table_e
 
 int action_manager_add_rule(action_manager_t* am, action_rule_t* rule) {
     if (!am || !rule) return -1;
+    if (!action_manager_can_update()) return -1;
     
     pthread_mutex_lock(&am->mutex);
     
-    action_rule_t* new_rules;
-    if (am->rules == NULL) {
-        // 如果rules为NULL，使用malloc而不是realloc
-        new_rules = (action_rule_t*)malloc(sizeof(action_rule_t));
-    } else {
-        // 否则使用realloc
-        new_rules = (action_rule_t*)realloc(am->rules, 
-            (am->rule_count + 1) * sizeof(action_rule_t));
-    }
-        
-    if (!new_rules) {
+    const action_rule_table_t* current = am->table;
+    action_rule_table_t* next = rule_table_create(current->rule_count + 1);
+    if (!next) {
         pthread_mutex_unlock(&am->mutex);
         return -1;
     }
+    for (int i = 0; i < current->rule_count; i++) {
+        rule_table_append(next, &current->rules[i]);
+    }
+    rule_table_append(next, rule);
+    action_manager_publish(am, next);
     
-    am->rules = new_rules;
+    pthread_mutex_unlock(&am->mutex);
+    return 0;
+}
+
+void action_manager_remove_rule(action_manager_t* am, int rule_id) {
+    if (!am) return;
+    if (!action_manager_can_update()) return;
     
-    // 复制规则内容
-    action_rule_t* new_rule = &am->rules[am->rule_count];
-    new_rule->rule_id = rule->rule_id;
+    pthread_mutex_lock(&am->mutex);
+    const action_rule_table_t* current = am->table;
+    int found = -1;
+    for (int i = 0; i < current->rule_count; i++) {
+        if (current->rules[i].rule_id == rule_id) {
+            found = i;
+            break;
+        }
+    }
     
-    // 复制名称字符串而不是仅复制指针
-    if (rule->name && strcmp(rule->name, "Unnamed Rule") != 0) {
-        new_rule->name = strdup(rule->name);
-        if (!new_rule->name) {
-            // 如果分配失败，使用默认名称
-            new_rule->name = "Unnamed Rule";
+    if (found >= 0) {
+        // 后面的规则位置前移，新规则表的索引随追加重建
+        action_rule_table_t* next = rule_table_create(current->rule_count - 1);
+        if (next) {
+            for (int i = 0; i < current->rule_count; i++) {
+                if (i != found) {
+                    rule_table_append(next, &current->rules[i]);
+                }
+            }
+            action_manager_publish(am, next);
+        } else {
+            printf("错误: 内存不足，无法移除规则 %d\n", rule_id);
         }
-    } else {
-        new_rule->name = "Unnamed Rule";
+    }
+    pthread_mutex_unlock(&am->mutex);
+}
+
+// 整体替换规则集
+int action_manager_replace_rules(action_manager_t* am, const action_rule_t* rules, int count) {
+    if (!am || count < 0 || (count > 0 && !rules)) return -1;
+    if (!action_manager_can_update()) return -1;
+    
+    action_rule_table_t* next = rule_table_create(count);
+    if (!next) return -1;
+    // 新规则表在锁外构建，锁内只做发布和等待宽限期
+    for (int i = 0; i < count; i++) {
+        rule_table_append(next, &rules[i]);
     }
     
-    new_rule->trigger = rule->trigger;
-    new_rule->priority = rule->priority;
+    pthread_mutex_lock(&am->mutex);
+    action_manager_publish(am, next);
+    pthread_mutex_unlock(&am->mutex);
+    return 0;
+}
+
+// 按触发字查找规则
+int action_manager_find_rules(action_manager_t* am, device_type_id_t device_type, uint32_t addr,
+                              int* rule_ids, int max_rules) {
+    if (!am || (!rule_ids && max_rules > 0)) return -1;
+    
+    // 只读已发布的规则表快照，不加锁
+    int token = action_manager_read_begin(am);
+    const action_rule_table_t* table = action_manager_rules(am);
+    const int* positions = NULL;
+    int count = rule_index_lookup(table->index, device_type, addr, &positions);
+    for (int i = 0; i < count && i < max_rules; i++) {
+        rule_ids[i] = table->rules[positions[i]].rule_id;
+    }
     
-    // 直接复制目标处理动作数组
-    memcpy(&new_rule->targets, &rule->targets, sizeof(action_target_array_t));
+    // 与该字重叠的范围规则排在单字规则之后
+    uint32_t word = addr & ~3u;
+    int range_max = max_rules > count ? max_rules - count : 0;
+    int* range_out = range_max > 0 ? rule_ids + count : NULL;
+    int ranges = rule_range_index_query(table->ranges, device_type, word, (uint64_t)word + 4,
+                                        range_out, range_max);
+    for (int i = 0; i < ranges && i < range_max; i++) {
+        range_out[i] = table->rules[range_out[i]].rule_id;
+    }
+    count += ranges;
+    action_manager_read_end(am, token);
     
-    am->rule_count++;
+    return count;
+}
+
+// 当前线程的待执行规则
+typedef struct {
+    action_manager_t* am;         // 动作管理器
+    device_manager_t* dm;         // 设备管理器
+    action_firing_t firing;       // 规则触发（按引用使用目标动作）
+    action_target_t* owned;       // 为action_rule_t复制的目标动作，执行后释放
+    int parent;                   // 触发本规则的规则在队列中的位置，-1表示级联起点
+    int depth;                    // 级联深度，起点为0
+} pending_rule_t;
+
+static __thread pending_rule_t* t_pending = NULL;   // 待执行队列（FIFO）
+static __thread int t_pending_head = 0;              // 队首位置
+static __thread int t_pending_count = 0;             // 队尾位置
+static __thread int t_pending_capacity = 0;          // 队列容量
+static __thread int t_defer_depth = 0;               // 延迟执行嵌套深度
+static __thread int t_pending_running = 0;           // 正在执行队列
+static __thread int t_pending_current = -1;          // 正在执行的规则在队列中的位置
+static __thread int t_pending_token = -1;            // 队列非空期间计入的纪元槽，-1表示未计入
+
+// 待执行队列非空的线程按纪元奇偶计数，action_manager_defer_wait据此等待
+static uint32_t g_pending_epoch = 0;
+static int g_pending_threads[2];
+static pthread_mutex_t g_pending_wait_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// 级联深度上限与统计
+static int g_cascade_max_depth = ACTION_CASCADE_DEFAULT_MAX_DEPTH;
+static action_cascade_stats_t g_cascade_stats;
+
+// 开始延迟执行
+void action_manager_defer_begin(void) {
+    t_defer_depth++;
+}
+
+// 当前线程的队列变为非空：计入当前纪元（与action_manager_read_begin相同的重试）
+static void pending_enter(void) {
+    for (;;) {
+        uint32_t epoch = __atomic_load_n(&g_pending_epoch, __ATOMIC_SEQ_CST);
+        int token = (int)(epoch & 1);
+        __atomic_add_fetch(&g_pending_threads[token], 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&g_pending_epoch, __ATOMIC_SEQ_CST) == epoch) {
+            t_pending_token = token;
+            return;
+        }
+        __atomic_sub_fetch(&g_pending_threads[token], 1, __ATOMIC_RELEASE);
+    }
+}
+
+// 当前线程的队列已清空
+static void pending_leave(void) {
+    if (t_pending_token < 0) return;
+    __atomic_sub_fetch(&g_pending_threads[t_pending_token], 1, __ATOMIC_RELEASE);
+    t_pending_token = -1;
+}
+
+// 等待其他线程的待执行队列清空
+int action_manager_defer_wait(void) {
+    if (t_pending_count > 0) {
+        return -1;
+    }
     
-    pthread_mutex_unlock(&am->mutex);
+    // 翻转纪元，等待翻转前非空的队列全部清空；多个等待者依次翻转
+    pthread_mutex_lock(&g_pending_wait_lock);
+    uint32_t epoch = __atomic_fetch_add(&g_pending_epoch, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&g_pending_threads[epoch & 1], __ATOMIC_ACQUIRE) != 0) {
+        sched_yield();
+    }
+    pthread_mutex_unlock(&g_pending_wait_lock);
     return 0;
 }
 
-void action_manager_remove_rule(action_manager_t* am, int rule_id) {
-    if (!am) return;
-    
-    pthread_mutex_lock(&am->mutex);
-    for (int i = 0; i < am->rule_count; i++) {
-        if (am->rules[i].rule_id == rule_id) {
-            // 清理目标处理动作数组
-            action_target_array_destroy(&am->rules[i].targets);
-            
-            // 移动后面的规则
-            if (i < am->rule_count - 1) {
-                memmove(&am->rules[i], &am->rules[i + 1], 
-                    (am->rule_count - i - 1) * sizeof(action_rule_t));
+// 设置级联深度上限
+int action_manager_set_cascade_limit(int max_depth) {
+    if (max_depth < 0) return -1;
+    __atomic_store_n(&g_cascade_max_depth, max_depth, __ATOMIC_RELAXED);
+    return 0;
+}
+
+// 获取级联统计
+void action_manager_get_cascade_stats(action_cascade_stats_t* stats) {
+    if (!stats) return;
+    stats->cascades = __atomic_load_n(&g_cascade_stats.cascades, __ATOMIC_RELAXED);
+    stats->max_depth = __atomic_load_n(&g_cascade_stats.max_depth, __ATOMIC_RELAXED);
+    stats->depth_truncated = __atomic_load_n(&g_cascade_stats.depth_truncated, __ATOMIC_RELAXED);
+    stats->cycle_truncated = __atomic_load_n(&g_cascade_stats.cycle_truncated, __ATOMIC_RELAXED);
+}
+
+// 两次触发是否为同一触发设备上的同一规则（触发条件和目标动作都相同）
+static int pending_rule_same(const action_firing_t* a, const action_firing_t* b) {
+    return a->rule_id == b->rule_id && a->name == b->name &&
+           a->device_type == b->device_type && a->device_id == b->device_id &&
+           a->trigger.trigger_addr == b->trigger.trigger_addr &&
+           a->trigger.expected_value == b->trigger.expected_value &&
+           a->trigger.expected_mask == b->trigger.expected_mask &&
+           a->trigger.mode == b->trigger.mode && a->trigger.range_end == b->trigger.range_end &&
+           a->target_count == b->target_count && a->bindings == b->bindings &&
+           (a->targets == b->targets ||
+            memcmp(a->targets, b->targets, a->target_count * sizeof(action_target_t)) == 0);
+}
+
+// 打印被截断的级联：从起点到被拒绝的规则
+static void pending_report_truncated(const char* reason, int parent, const action_firing_t* firing) {
+    printf("错误: 规则级联被截断（%s），规则链: ", reason);
+    // 沿父节点回溯得到的是逆序，先收集再正序打印
+    int chain[ACTION_CASCADE_REPORT_MAX];
+    int length = 0;
+    for (int i = parent; i >= 0 && length < ACTION_CASCADE_REPORT_MAX; i = t_pending[i].parent) {
+        chain[length++] = i;
+    }
+    if (length == ACTION_CASCADE_REPORT_MAX && t_pending[chain[length - 1]].parent >= 0) {
+        printf("... -> ");
+    }
+    for (int i = length - 1; i >= 0; i--) {
+        const action_firing_t* f = &t_pending[chain[i]].firing;
+        printf("\"%s\"(设备%d/%d, 0x%08X) -> ", f->name ? f->name : "未命名", 
+               f->device_type, f->device_id, f->trigger.trigger_addr);
+    }
+    printf("\"%s\"(设备%d/%d, 0x%08X)\n", firing->name ? firing->name : "未命名", 
+           firing->device_type, firing->device_id, firing->trigger.trigger_addr);
+    fflush(stdout);
+}
+
+/**
+ * 把规则触发放入当前线程的待执行队列
+ * 
+ * 执行队列期间提交的规则是正在执行的规则的级联，超过深度上限或与级联链上的
+ * 某条规则相同（构成循环）时拒绝并报告规则链。
+ * 
+ * @param owned 触发引用的目标动作副本，入队后由队列释放（包括失败时），可为NULL
+ * @return 成功返回0，截断或内存不足返回-1
+ */
+static int pending_push(action_manager_t* am, const action_firing_t* firing, action_target_t* owned,
+                        device_manager_t* dm) {
+    int parent = t_pending_running ? t_pending_current : -1;
+    int depth = 0;
+    if (parent >= 0) {
+        depth = t_pending[parent].depth + 1;
+        if (depth > __atomic_load_n(&g_cascade_max_depth, __ATOMIC_RELAXED)) {
+            __atomic_add_fetch(&g_cascade_stats.depth_truncated, 1, __ATOMIC_RELAXED);
+            pending_report_truncated("超过深度上限", parent, firing);
+            free(owned);
+            return -1;
+        }
+        for (int i = parent; i >= 0; i = t_pending[i].parent) {
+            if (pending_rule_same(&t_pending[i].firing, firing)) {
+                __atomic_add_fetch(&g_cascade_stats.cycle_truncated, 1, __ATOMIC_RELAXED);
+                pending_report_truncated("检测到循环", parent, firing);
+                free(owned);
+                return -1;
             }
-            am->rule_count--;
-            break;
         }
     }
-    pthread_mutex_unlock(&am->mutex);
+    
+    if (t_pending_count >= t_pending_capacity) {
+        int new_capacity = t_pending_capacity ? t_pending_capacity * 2 : 4;
+        pending_rule_t* pending = (pending_rule_t*)realloc(t_pending, new_capacity * sizeof(pending_rule_t));
+        if (!pending) {
+            printf("错误: 无法延迟执行规则 \"%s\"\n", firing->name ? firing->name : "未命名");
+            free(owned);
+            return -1;
+        }
+        t_pending = pending;
+        t_pending_capacity = new_capacity;
+    }
+    
+    if (t_pending_count == 0) {
+        pending_enter();
+    }
+    pending_rule_t* item = &t_pending[t_pending_count++];
+    item->am = am;
+    item->dm = dm;
+    item->firing = *firing;
+    item->owned = owned;
+    item->parent = parent;
+    item->depth = depth;
+    
+    if (parent < 0) {
+        __atomic_add_fetch(&g_cascade_stats.cascades, 1, __ATOMIC_RELAXED);
+    }
+    uint64_t max_depth = __atomic_load_n(&g_cascade_stats.max_depth, __ATOMIC_RELAXED);
+    while ((uint64_t)depth > max_depth &&
+           !__atomic_compare_exchange_n(&g_cascade_stats.max_depth, &max_depth, (uint64_t)depth, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+    return 0;
+}
+
+/**
+ * 执行当前线程的待执行规则，执行期间追加的级联规则也按顺序执行
+ * 
+ * 级联规则在队列中迭代执行，栈深度与级联长度无关。
+ * 
+ * @return 队首规则（调用时的第一条）的执行结果
+ */
+static int action_manager_run_pending(void) {
+    int first_result = 0;
+    int first = 1;
+    
+    t_pending_running = 1;
+    while (t_pending_head < t_pending_count) {
+        // 执行期间队列可能扩容，先复制出来
+        t_pending_current = t_pending_head++;
+        pending_rule_t item = t_pending[t_pending_current];
+        int result = action_manager_execute_firing(item.am, &item.firing, item.dm);
+        if (first) {
+            first_result = result;
+            first = 0;
+        }
+    }
+    // 级联链检查会比较已执行规则的目标动作，队列清空后才释放副本
+    for (int i = 0; i < t_pending_count; i++) {
+        free(t_pending[i].owned);
+    }
+    free(t_pending);
+    t_pending = NULL;
+    t_pending_head = t_pending_count = t_pending_capacity = 0;
+    t_pending_current = -1;
+    t_pending_running = 0;
+    pending_leave();
+    return first_result;
+}
+
+// 结束延迟执行
+void action_manager_defer_end(void) {
+    if (t_defer_depth <= 0) return;
+    
+    if (--t_defer_depth == 0 && !t_pending_running && t_pending_count > 0) {
+        action_manager_run_pending();
+    }
+}
+
+// 以规则构造触发，目标动作直接引用规则中的数组
+static void action_firing_from_rule(action_firing_t* firing, const action_rule_t* rule) {
+    memset(firing, 0, sizeof(*firing));
+    firing->rule_id = rule->rule_id;
+    firing->name = rule->name;
+    firing->trigger = rule->trigger;
+    firing->device_type = rule->device_type;
+    firing->device_id = rule->device_id;
+    firing->targets = rule->targets.targets;
+    firing->target_count = rule->targets.count;
+}
+
+// 提交规则触发
+static int action_manager_submit(action_manager_t* am, const action_firing_t* firing,
+                                 action_target_t* owned, device_manager_t* dm) {
+    if (pending_push(am, firing, owned, dm) != 0) {
+        return -1;
+    }
+    
+    // 不在延迟执行范围内时立即执行，级联规则同样进入队列迭代执行
+    if (t_defer_depth == 0 && !t_pending_running) {
+        return action_manager_run_pending();
+    }
+    return 0;
+}
+
+// 提交规则
+int action_manager_submit_rule(action_manager_t* am, const action_rule_t* rule, device_manager_t* dm) {
+    if (!am || !rule || !dm) return -1;
+    
+    // 规则可能在调用者栈上，只复制实际使用的目标动作
+    action_firing_t firing;
+    action_firing_from_rule(&firing, rule);
+    action_target_t* owned = NULL;
+    if (firing.target_count > 0) {
+        owned = (action_target_t*)malloc(firing.target_count * sizeof(action_target_t));
+        if (!owned) return -1;
+        memcpy(owned, rule->targets.targets, firing.target_count * sizeof(action_target_t));
+        firing.targets = owned;
+    }
+    return action_manager_submit(am, &firing, owned, dm);
+}
+
+// 提交规则触发
+int action_manager_submit_firing(action_manager_t* am, const action_firing_t* firing, device_manager_t* dm) {
+    if (!am || !firing || !dm || (firing->target_count > 0 && !firing->targets)) return -1;
+    
+    return action_manager_submit(am, firing, NULL, dm);
+}
+
+// 开启异步执行
+int action_manager_start_async(action_manager_t* am, int worker_count) {
+    if (!am) return -1;
+    if (am->dispatcher) return 0;
+    
+    action_dispatcher_t* dispatcher = action_dispatcher_create(worker_count, execute_action_target);
+    if (!dispatcher) return -1;
+    __atomic_store_n(&am->dispatcher, dispatcher, __ATOMIC_RELEASE);
+    return 0;
+}
+
+// 关闭异步执行
+void action_manager_stop_async(action_manager_t* am) {
+    if (!am || !am->dispatcher) return;
+    
+    action_dispatcher_t* dispatcher = am->dispatcher;
+    // 先等待队列清空：执行中的动作可能级联提交新的动作
+    action_dispatcher_flush(dispatcher);
+    __atomic_store_n(&am->dispatcher, NULL, __ATOMIC_RELEASE);
+    action_dispatcher_destroy(dispatcher);
+}
+
+// 等待异步动作完成
+int action_manager_flush(action_manager_t* am) {
+    if (!am) return -1;
+    
+    action_dispatcher_t* dispatcher = __atomic_load_n(&am->dispatcher, __ATOMIC_ACQUIRE);
+    return dispatcher ? action_dispatcher_flush(dispatcher) : 0;
+}
+
+// 更新绑定的互斥锁（只在绑定失效后重新解析时使用）
+static pthread_mutex_t g_binding_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * 读取有效的绑定
+ * 
+ * generation兼作顺序锁：写入时先清零，读取前后两次的代号一致且等于当前拓扑代号才有效。
+ * 
+ * @return 绑定的设备，未绑定或已失效返回NULL
+ */
+static device_instance_t* action_binding_get(action_binding_t* binding, device_manager_t* dm) {
+    if (!binding) return NULL;
+    
+    uint32_t generation = __atomic_load_n(&binding->generation, __ATOMIC_ACQUIRE);
+    if (generation == 0 || generation != device_manager_topology_generation(dm)) {
+        return NULL;
+    }
+    device_instance_t* device = __atomic_load_n(&binding->device, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&binding->generation, __ATOMIC_RELAXED) != generation) {
+        return NULL;
+    }
+    return device;
+}
+
+// 更新绑定，generation为解析前取得的拓扑代号
+static void action_binding_set(action_binding_t* binding, device_instance_t* device, uint32_t generation) {
+    if (!binding) return;
+    
+    pthread_mutex_lock(&g_binding_mutex);
+    __atomic_store_n(&binding->generation, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&binding->device, device, __ATOMIC_RELAXED);
+    __atomic_store_n(&binding->generation, generation, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&g_binding_mutex);
 }
 
 /**
@@ -466,10 +1388,17 @@ static int execute_action_target(action_target_t* target, device_manager_t* dm)
     printf("DEBUG: 动作目标详情: type=%d, device_type=%d, device_id=%d, addr=0x%08x, value=0x%08x, mask=0x%08x\n",
         target->type, target->device_type, target->device_id, target->target_addr, target->target_value, target->target_mask);
     
-    device_instance_t* device = NULL;
+    // 绑定有效时直接使用预解析的设备，不做任何查找
+    device_instance_t* device = action_binding_get(target->binding, dm);
+    int bound = device != NULL;
+    if (bound) {
+        printf("DEBUG: 使用预解析的目标设备: device=%p\n", device);
+    }
+    // 查找前取拓扑代号，查找期间拓扑变化时绑定随即失效
+    uint32_t generation = bound ? 0 : device_manager_topology_generation(dm);
     
     // 首先尝试根据设备类型和ID查找设备
-    if (target->device_type != 0 && target->device_id != 0) {
+    if (!device && target->device_type != 0 && target->device_id != 0) {
         printf("DEBUG: 通过设备类型(%d)和ID(%d)查找设备\n", target->device_type, target->device_id);
         device = device_manager_get_device_by_type_id(dm, target->device_type, target->device_id);
         if (!device) {
@@ -492,6 +1421,11 @@ static int execute_action_target(action_target_t* target, device_manager_t* dm)
         printf("DEBUG: 成功通过地址找到设备: device=%p\n", device);
     }
     
+    // 记住解析结果，下次执行同一目标时不再查找
+    if (!bound) {
+        action_binding_set(target->binding, device, generation);
+    }
+    
     // 获取设备类型的操作接口
     device_type_t* device_type = &dm->types[device->type_id];
     if (!device_type || device_type->type_id <= 0) {
@@ -546,40 +1480,73 @@ static int execute_action_target(action_target_t* target, device_manager_t* dm)
     return 0;
 }
 
+// 取触发的第index个目标动作的执行副本：补全继承的设备并挂上绑定单元
+static void action_firing_target(const action_firing_t* firing, int index, action_target_t* target) {
+    *target = firing->targets[index];
+    if (firing->inherit_device) {
+        if (target->device_type == 0) {
+            target->device_type = firing->device_type;
+        }
+        if (target->device_id == 0) {
+            target->device_id = firing->device_id;
+        }
+    }
+    if (firing->bindings) {
+        target->binding = &firing->bindings[index];
+    }
+}
+
 /**
- * 执行指定的规则
+ * 执行规则触发
+ * 
+ * 目标动作按引用读取，每个目标只在栈上复制一份执行副本。
  * 
  * @param am 动作管理器
- * @param rule 规则
+ * @param firing 规则触发
  * @param dm 设备管理器
  * @return 成功返回0，失败返回非0
  */
-int action_manager_execute_rule(action_manager_t* am, action_rule_t* rule, device_manager_t* dm) {
+int action_manager_execute_firing(action_manager_t* am, const action_firing_t* firing, device_manager_t* dm) {
     struct timeval tv, start_time, end_time;
     gettimeofday(&tv, NULL);
     
-    if (!am || !rule || !dm) {
+    if (!am || !firing || !dm || (firing->target_count > 0 && !firing->targets)) {
         printf("[%ld.%06ld] action_manager_execute_rule - 参数无效: am=%p, rule=%p, dm=%p\n", 
-              tv.tv_sec, (long)tv.tv_usec, (void*)am, (void*)rule, (void*)dm);
+              tv.tv_sec, (long)tv.tv_usec, (void*)am, (void*)firing, (void*)dm);
         fflush(stdout);
         return -1;
     }
     
     printf("[%ld.%06ld] action_manager_execute_rule - 开始执行规则 %d: \"%s\"\n", 
-          tv.tv_sec, (long)tv.tv_usec, rule->rule_id, rule->name ? rule->name : "未命名");
+          tv.tv_sec, (long)tv.tv_usec, firing->rule_id, firing->name ? firing->name : "未命名");
     fflush(stdout);
     
     // 获取目标数量
-    int target_count = action_target_count(&rule->targets);
+    int target_count = firing->target_count;
     
     printf("[%ld.%06ld] action_manager_execute_rule - 规则包含 %d 个目标处理动作\n", 
            tv.tv_sec, (long)tv.tv_usec, target_count);
     fflush(stdout);
     
     printf("[%ld.%06ld] action_manager_execute_rule - 触发条件: 地址=0x%08X, 值=0x%08X, 掩码=0x%08X\n", 
-           tv.tv_sec, (long)tv.tv_usec, rule->trigger.trigger_addr, rule->trigger.expected_value, rule->trigger.expected_mask);
+           tv.tv_sec, (long)tv.tv_usec, firing->trigger.trigger_addr, firing->trigger.expected_value, firing->trigger.expected_mask);
     fflush(stdout);
     
+    // 异步模式：按目标设备交给分发器，提交失败时回退到同步执行
+    action_dispatcher_t* dispatcher = __atomic_load_n(&am->dispatcher, __ATOMIC_ACQUIRE);
+    if (dispatcher) {
+        int failed = 0;
+        for (int i = 0; i < target_count; i++) {
+            action_target_t target;
+            action_firing_target(firing, i, &target);
+            if (action_dispatcher_submit(dispatcher, &target, dm) != 0 &&
+                execute_action_target(&target, dm) != 0) {
+                failed++;
+            }
+        }
+        return (failed == 0 && target_count > 0) ? 0 : -1;
+    }
+    
     // 执行每个目标处理动作
     int success_count = 0;
     for (int i = 0; i < target_count; i++) {
@@ -590,13 +1557,9 @@ int action_manager_execute_rule(action_manager_t* am, action_rule_t* rule, devic
         fflush(stdout);
         
         // 获取目标处理动作
-        action_target_t* target = action_target_get(&rule->targets, i);
-        if (!target) {
-            printf("[%ld.%06ld] action_manager_execute_rule - 无法获取目标处理动作 %d\n", 
-                  tv.tv_sec, (long)tv.tv_usec, i+1);
-            fflush(stdout);
-            continue;
-        }
+        action_target_t target_copy;
+        action_firing_target(firing, i, &target_copy);
+        action_target_t* target = &target_copy;
         
         printf("[%ld.%06ld] action_manager_execute_rule - 目标处理动作 %d: 类型=%d, 设备类型=%d, 设备ID=%d, 地址=0x%08X, 值=0x%08X, 掩码=0x%08X\n", 
                tv.tv_sec, (long)tv.tv_usec, i+1, target->type, target->device_type, target->device_id, 
@@ -632,30 +1595,35 @@ int action_manager_execute_rule(action_manager_t* am, action_rule_t* rule, devic
 }
 
 /**
- * 获取目标数组中目标的数量
+ * 执行指定的规则
  * 
- * @param targets 目标数组
- * @return 目标数量
+ * @param am 动作管理器
+ * @param rule 规则
+ * @param dm 设备管理器
+ * @return 成功返回0，失败返回非0
  */
-static int action_target_count(action_target_array_t* targets) {
-    if (!targets) {
-        return 0;
+int action_manager_execute_rule(action_manager_t* am, action_rule_t* rule, device_manager_t* dm) {
+    if (!rule) {
+        return action_manager_execute_firing(am, NULL, dm);
     }
-    return targets->count;
+    
+    action_firing_t firing;
+    action_firing_from_rule(&firing, rule);
+    firing.target_count = action_target_count(&rule->targets);
+    return action_manager_execute_firing(am, &firing, dm);
 }
 
 /**
- * 从目标数组中获取指定索引的目标
+ * 获取目标数组中目标的数量
  * 
  * @param targets 目标数组
- * @param index 索引
- * @return 目标指针，如果索引无效则返回NULL
+ * @return 目标数量
  */
-static action_target_t* action_target_get(action_target_array_t* targets, int index) {
-    if (!targets || index < 0 || index >= targets->count) {
-        return NULL;
+static int action_target_count(action_target_array_t* targets) {
+    if (!targets) {
+        return 0;
     }
-    return &targets->targets[index];
+    return targets->count;
 }
 
 /**
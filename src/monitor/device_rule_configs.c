@@ -1,6 +1,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
+#include <sched.h>
 #include "device_rule_configs.h"
 #include "device_types.h"
 #include "action_manager.h"
@@ -107,190 +109,508 @@ int setup_device_rules(device_rule_manager_t* manager, device_type_id_t device_t
     return rule_count;
 }
 
-// 静态规则表
-static rule_table_entry_t flash_rules[10];
-static int flash_rule_table_count = 0;
+// 有规则表的设备类型，规则表快照中按此顺序存放
+static const device_type_id_t g_rule_table_types[] = { DEVICE_TYPE_FLASH, DEVICE_TYPE_TEMP_SENSOR, DEVICE_TYPE_FPGA };
+#define DEVICE_RULE_TABLE_TYPES  (int)(sizeof(g_rule_table_types) / sizeof(g_rule_table_types[0]))
 
-static rule_table_entry_t temp_sensor_rules[10];
-static int temp_sensor_rule_table_count = 0;
+/**
+ * 规则表快照：所有设备类型的规则表和索引一起发布，发布后不再修改
+ * 
+ * 运行时修改规则时复制出新快照并原子发布，等待读侧临界区的宽限期后释放旧快照。
+ * 规则名称由各快照共享，删除规则后也不释放：待执行的触发可能仍引用规则名。
+ */
+typedef struct {
+    rule_table_entry_t* rules[DEVICE_RULE_TABLE_TYPES]; // 各设备类型的规则表
+    int counts[DEVICE_RULE_TABLE_TYPES];                // 各设备类型的规则数
+    rule_index_t* index;          // 单字规则的（设备类型，触发字）索引
+    rule_range_index_t* ranges;   // 范围规则的区间树索引
+    uint64_t generation;          // 规则表代次
+} device_rule_snapshot_t;
 
-static rule_table_entry_t fpga_rules[10];
-static int fpga_rule_table_count = 0;
+// 当前发布的规则表快照，初始化规则表之前为NULL（原子访问）
+static device_rule_snapshot_t* g_rule_snapshot = NULL;
 
-// 初始化规则表
-static void init_rule_tables(void) {
-    static int initialized = 0;
-    if (initialized) {
-        printf("规则表已初始化，跳过\n");
-        return;
+// 规则表代次：与当前快照的代次相同，不进入读侧即可比较（原子访问）
+static uint64_t g_rule_generation = 0;
+
+// 串行化规则表的修改
+static pthread_mutex_t g_rule_update_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// 规则表读侧：读者按纪元奇偶分组计数（原子访问）
+static uint32_t g_rule_read_epoch = 0;
+static uint32_t g_rule_readers[2] = { 0, 0 };
+
+// 当前线程嵌套的规则表读侧临界区层数，修改者不能在临界区内等待宽限期
+static __thread int t_rule_read_depth = 0;
+
+// 被删除规则的名称，保留到进程结束（g_rule_update_lock保护）
+static const char** g_removed_rule_names = NULL;
+static int g_removed_rule_name_count = 0;
+
+// 设备类型在规则表快照中的下标，没有规则表时返回-1
+static int device_rule_slot(device_type_id_t device_type) {
+    for (int t = 0; t < DEVICE_RULE_TABLE_TYPES; t++) {
+        if (g_rule_table_types[t] == device_type) return t;
+    }
+    return -1;
+}
+
+// 当前规则表快照，调用者位于读侧临界区内或持有g_rule_update_lock
+static device_rule_snapshot_t* device_rule_snapshot(void) {
+    return __atomic_load_n(&g_rule_snapshot, __ATOMIC_ACQUIRE);
+}
+
+// 获取设备类型的规则表（不打印信息）
+static const rule_table_entry_t* device_rule_table(const device_rule_snapshot_t* snap, 
+                                                   device_type_id_t device_type, int* count) {
+    int slot = device_rule_slot(device_type);
+    if (!snap || slot < 0) {
+        *count = 0;
+        return NULL;
+    }
+    *count = snap->counts[slot];
+    return snap->rules[slot];
+}
+
+// 登记一条规则：范围规则进入区间树，其他规则按触发字登记
+static int device_rule_index_add(device_rule_snapshot_t* snap, device_type_id_t device_type, 
+                                 const rule_table_entry_t* rule, int position) {
+    if (rule_trigger_is_range(&rule->trigger)) {
+        return rule_range_index_add(snap->ranges, device_type, rule->trigger.trigger_addr,
+                                    rule->trigger.range_end, position);
     }
+    return rule_index_add(snap->index, device_type, rule->trigger.trigger_addr, position);
+}
+
+// 释放规则表快照（不释放规则名称）
+static void device_rule_snapshot_free(device_rule_snapshot_t* snap) {
+    if (!snap) return;
     
-    printf("开始初始化规则表...\n");
+    for (int t = 0; t < DEVICE_RULE_TABLE_TYPES; t++) {
+        free(snap->rules[t]);
+    }
+    rule_index_destroy(snap->index);
+    rule_range_index_destroy(snap->ranges);
+    free(snap);
+}
+
+/**
+ * 复制规则表快照（不含索引），代次加1
+ * 
+ * @param slot 需要追加规则的设备类型下标，-1表示不追加
+ * @param extra slot的规则表额外预留的位置数
+ */
+static device_rule_snapshot_t* device_rule_snapshot_copy(const device_rule_snapshot_t* from, int slot, int extra) {
+    device_rule_snapshot_t* snap = (device_rule_snapshot_t*)calloc(1, sizeof(device_rule_snapshot_t));
+    if (!snap) return NULL;
     
-    // 初始化Flash规则表
-    printf("初始化Flash规则表...\n");
-    printf("Flash规则配置数量: %d\n", flash_rule_config_count);
-    for (int i = 0; i < flash_rule_config_count && i < 10; i++) {
-        printf("处理Flash规则配置 %d/%d\n", i+1, flash_rule_config_count);
-        action_target_array_t targets;
-        memset(&targets, 0, sizeof(action_target_array_t));
-        
-        action_target_t target = create_action_target_from_config(&flash_rule_configs[i]);
-        printf("创建目标动作: type=%d, device_type=%d, addr=0x%x\n", 
-               target.type, target.device_type, target.target_addr);
-        action_target_add_to_array(&targets, &target);
-        
-        rule_trigger_t trigger = rule_trigger_create(
-            flash_rule_configs[i].addr,
-            flash_rule_configs[i].expected_value,
-            flash_rule_configs[i].expected_mask
-        );
-        printf("创建触发条件: addr=0x%x, value=0x%x, mask=0x%x\n", 
-               trigger.trigger_addr, trigger.expected_value, trigger.expected_mask);
-        
-        char name[32];
-        snprintf(name, sizeof(name), "Flash_Rule_%d", i);
-        
-        // 创建一个临时的rule_table_entry_t，然后复制到flash_rules[i]
-        printf("创建规则表项: name=%s\n", name);
-        rule_table_entry_t* temp_entry = rule_table_entry_create(strdup(name), trigger, &targets, 100);
-        if (temp_entry) {
-            printf("规则表项创建成功: %p\n", temp_entry);
-            flash_rules[i] = *temp_entry;
-            // 不要释放temp_entry->name，因为它已经被复制到flash_rules[i]
-            free(temp_entry);
-            flash_rule_table_count++;
-        } else {
-            printf("规则表项创建失败\n");
+    for (int t = 0; t < DEVICE_RULE_TABLE_TYPES; t++) {
+        int count = from->counts[t];
+        int capacity = count + (t == slot ? extra : 0);
+        if (capacity > 0) {
+            snap->rules[t] = (rule_table_entry_t*)malloc(capacity * sizeof(rule_table_entry_t));
+            if (!snap->rules[t]) {
+                device_rule_snapshot_free(snap);
+                return NULL;
+            }
+            memcpy(snap->rules[t], from->rules[t], count * sizeof(rule_table_entry_t));
+        }
+        snap->counts[t] = count;
+    }
+    snap->generation = from->generation + 1;
+    return snap;
+}
+
+// 为快照中的所有规则表建立索引
+static int device_rule_snapshot_index(device_rule_snapshot_t* snap) {
+    snap->index = rule_index_create();
+    snap->ranges = rule_range_index_create();
+    if (!snap->index || !snap->ranges) {
+        printf("错误: 无法创建规则索引\n");
+        return -1;
+    }
+    for (int t = 0; t < DEVICE_RULE_TABLE_TYPES; t++) {
+        for (int i = 0; i < snap->counts[t]; i++) {
+            if (device_rule_index_add(snap, g_rule_table_types[t], &snap->rules[t][i], i) != 0) {
+                printf("错误: 无法为规则 %s 建立索引\n", snap->rules[t][i].name);
+                return -1;
+            }
+        }
+    }
+    // 范围规则全部登记后一次性排序建树
+    if (rule_range_index_build(snap->ranges) != 0) {
+        printf("错误: 无法建立范围规则索引\n");
+        return -1;
+    }
+    return 0;
+}
+
+// 进入规则表读侧临界区
+int device_rules_read_begin(void) {
+    for (;;) {
+        uint32_t epoch = __atomic_load_n(&g_rule_read_epoch, __ATOMIC_SEQ_CST);
+        int token = (int)(epoch & 1);
+        __atomic_add_fetch(&g_rule_readers[token], 1, __ATOMIC_SEQ_CST);
+        // 计数后纪元未变：修改者翻转纪元后一定会看到这个读者
+        if (__atomic_load_n(&g_rule_read_epoch, __ATOMIC_SEQ_CST) == epoch) {
+            t_rule_read_depth++;
+            return token;
         }
+        __atomic_sub_fetch(&g_rule_readers[token], 1, __ATOMIC_RELEASE);
+    }
+}
+
+// 退出规则表读侧临界区
+void device_rules_read_end(int token) {
+    t_rule_read_depth--;
+    __atomic_sub_fetch(&g_rule_readers[token & 1], 1, __ATOMIC_RELEASE);
+}
+
+// 修改前检查：读侧临界区内等待宽限期会等待自己
+static int device_rules_can_update(void) {
+    if (t_rule_read_depth > 0) {
+        printf("错误: 不能在设备规则读侧临界区内修改规则表\n");
+        return 0;
     }
-    printf("Flash规则表初始化完成，共 %d 条规则\n", flash_rule_table_count);
-    printf("Flash规则表地址: %p\n", flash_rules);
+    return 1;
+}
+
+/**
+ * 发布新快照，等待宽限期后释放旧快照（调用者持有g_rule_update_lock）
+ * 
+ * 先发布快照再更新代次：读者看到新代次时一定能取到新快照。
+ */
+static void device_rules_publish(device_rule_snapshot_t* snap) {
+    device_rule_snapshot_t* old = g_rule_snapshot;
+    __atomic_store_n(&g_rule_snapshot, snap, __ATOMIC_RELEASE);
+    __atomic_store_n(&g_rule_generation, snap->generation, __ATOMIC_SEQ_CST);
     
-    // 初始化温度传感器规则表
-    printf("初始化温度传感器规则表...\n");
-    printf("温度传感器规则配置数量: %d\n", temp_sensor_rule_config_count);
-    for (int i = 0; i < temp_sensor_rule_config_count && i < 10; i++) {
-        printf("处理温度传感器规则配置 %d/%d\n", i+1, temp_sensor_rule_config_count);
-        action_target_array_t targets;
-        memset(&targets, 0, sizeof(action_target_array_t));
-        
-        action_target_t target = create_action_target_from_config(&temp_sensor_rule_configs[i]);
-        printf("创建目标动作: type=%d, device_type=%d, addr=0x%x\n", 
-               target.type, target.device_type, target.target_addr);
-        action_target_add_to_array(&targets, &target);
-        
-        rule_trigger_t trigger = rule_trigger_create(
-            temp_sensor_rule_configs[i].addr,
-            temp_sensor_rule_configs[i].expected_value,
-            temp_sensor_rule_configs[i].expected_mask
-        );
-        printf("创建触发条件: addr=0x%x, value=0x%x, mask=0x%x\n", 
-               trigger.trigger_addr, trigger.expected_value, trigger.expected_mask);
-        
-        char name[32];
-        snprintf(name, sizeof(name), "TempSensor_Rule_%d", i);
-        
-        // 创建一个临时的rule_table_entry_t，然后复制到temp_sensor_rules[i]
-        printf("创建规则表项: name=%s\n", name);
-        rule_table_entry_t* temp_entry = rule_table_entry_create(strdup(name), trigger, &targets, 100);
-        if (temp_entry) {
-            printf("规则表项创建成功: %p\n", temp_entry);
-            temp_sensor_rules[i] = *temp_entry;
-            // 不要释放temp_entry->name，因为它已经被复制到temp_sensor_rules[i]
-            free(temp_entry);
-            temp_sensor_rule_table_count++;
-        } else {
-            printf("规则表项创建失败\n");
+    if (old) {
+        uint32_t epoch = __atomic_fetch_add(&g_rule_read_epoch, 1, __ATOMIC_SEQ_CST);
+        while (__atomic_load_n(&g_rule_readers[epoch & 1], __ATOMIC_ACQUIRE) != 0) {
+            sched_yield();
         }
+        device_rule_snapshot_free(old);
     }
-    printf("温度传感器规则表初始化完成，共 %d 条规则\n", temp_sensor_rule_table_count);
-    printf("温度传感器规则表地址: %p\n", temp_sensor_rules);
+}
+
+/**
+ * 由一种设备类型的规则配置生成快照中的规则表
+ * 
+ * 规则表按配置数量分配，没有数量上限；单条规则创建失败时跳过。
+ * 
+ * @param slot 设备类型在快照中的下标
+ * @param label 打印用的设备类型名称
+ * @param prefix 规则名前缀，规则名为 前缀_序号
+ * @return 成功返回0，规则表分配失败返回-1
+ */
+static int load_rule_table(device_rule_snapshot_t* snap, int slot, const device_rule_config_t* configs,
+                           int config_count, const char* label, const char* prefix) {
+    printf("初始化%s规则表...\n", label);
+    printf("%s规则配置数量: %d\n", label, config_count);
+    if (config_count <= 0) return 0;
     
-    // 初始化FPGA规则表
-    printf("初始化FPGA规则表...\n");
-    printf("FPGA规则配置数量: %d\n", fpga_rule_config_count);
-    for (int i = 0; i < fpga_rule_config_count && i < 10; i++) {
-        printf("处理FPGA规则配置 %d/%d\n", i+1, fpga_rule_config_count);
+    snap->rules[slot] = (rule_table_entry_t*)calloc(config_count, sizeof(rule_table_entry_t));
+    if (!snap->rules[slot]) {
+        printf("错误: 无法分配%s规则表\n", label);
+        return -1;
+    }
+    
+    for (int i = 0; i < config_count; i++) {
+        printf("处理%s规则配置 %d/%d\n", label, i+1, config_count);
         action_target_array_t targets;
         memset(&targets, 0, sizeof(action_target_array_t));
         
-        action_target_t target = create_action_target_from_config(&fpga_rule_configs[i]);
+        action_target_t target = create_action_target_from_config(&configs[i]);
         printf("创建目标动作: type=%d, device_type=%d, addr=0x%x\n", 
                target.type, target.device_type, target.target_addr);
         action_target_add_to_array(&targets, &target);
         
         rule_trigger_t trigger = rule_trigger_create(
-            fpga_rule_configs[i].addr,
-            fpga_rule_configs[i].expected_value,
-            fpga_rule_configs[i].expected_mask
+            configs[i].addr,
+            configs[i].expected_value,
+            configs[i].expected_mask
         );
+        trigger.mode = configs[i].trigger_mode;
+        trigger.range_end = configs[i].addr_end;
         printf("创建触发条件: addr=0x%x, value=0x%x, mask=0x%x\n", 
                trigger.trigger_addr, trigger.expected_value, trigger.expected_mask);
         
         char name[32];
-        snprintf(name, sizeof(name), "FPGA_Rule_%d", i);
+        snprintf(name, sizeof(name), "%s_%d", prefix, i);
         
-        // 创建一个临时的rule_table_entry_t，然后复制到fpga_rules[i]
+        // 创建一个临时的rule_table_entry_t，然后复制到规则表中
         printf("创建规则表项: name=%s\n", name);
-        rule_table_entry_t* temp_entry = rule_table_entry_create(strdup(name), trigger, &targets, 100);
+        rule_table_entry_t* temp_entry = rule_table_entry_create(name, trigger, &targets, 100);
         if (temp_entry) {
             printf("规则表项创建成功: %p\n", temp_entry);
-            fpga_rules[i] = *temp_entry;
-            // 不要释放temp_entry->name，因为它已经被复制到fpga_rules[i]
+            rule_table_entry_t* rule = &snap->rules[slot][snap->counts[slot]++];
+            *rule = *temp_entry;
+            rule->device_type = g_rule_table_types[slot];
+            // 不要释放temp_entry->name，因为它已经被复制到规则表中
             free(temp_entry);
-            fpga_rule_table_count++;
         } else {
             printf("规则表项创建失败\n");
         }
     }
-    printf("FPGA规则表初始化完成，共 %d 条规则\n", fpga_rule_table_count);
-    printf("FPGA规则表地址: %p\n", fpga_rules);
+    printf("%s规则表初始化完成，共 %d 条规则\n", label, snap->counts[slot]);
+    printf("%s规则表地址: %p\n", label, (void*)snap->rules[slot]);
+    return 0;
+}
+
+// 由配置生成规则表并发布第一个快照（只经由init_rule_tables执行一次）
+static void build_rule_tables(void) {
+    printf("开始初始化规则表...\n");
+    
+    device_rule_snapshot_t* snap = (device_rule_snapshot_t*)calloc(1, sizeof(device_rule_snapshot_t));
+    int result = snap ? 0 : -1;
+    if (result == 0) {
+        result = load_rule_table(snap, device_rule_slot(DEVICE_TYPE_FLASH), 
+                                 flash_rule_configs, flash_rule_config_count, "Flash", "Flash_Rule");
+    }
+    if (result == 0) {
+        result = load_rule_table(snap, device_rule_slot(DEVICE_TYPE_TEMP_SENSOR), 
+                                 temp_sensor_rule_configs, temp_sensor_rule_config_count, 
+                                 "温度传感器", "TempSensor_Rule");
+    }
+    if (result == 0) {
+        result = load_rule_table(snap, device_rule_slot(DEVICE_TYPE_FPGA), 
+                                 fpga_rule_configs, fpga_rule_config_count, "FPGA", "FPGA_Rule");
+    }
+    if (result != 0 || device_rule_snapshot_index(snap) != 0) {
+        printf("错误: 无法发布规则表快照\n");
+        device_rule_snapshot_free(snap);
+        return;
+    }
+    snap->generation = 1;
+    
+    pthread_mutex_lock(&g_rule_update_lock);
+    device_rules_publish(snap);
+    pthread_mutex_unlock(&g_rule_update_lock);
     
-    initialized = 1;
     printf("所有规则表初始化完成\n");
 }
 
+// 初始化规则表：读者和修改者都可能首次调用，并发调用时只有一个线程生成规则表，
+// 其他线程等待它完成
+static pthread_once_t g_rule_tables_once = PTHREAD_ONCE_INIT;
+
+static void init_rule_tables(void) {
+    pthread_once(&g_rule_tables_once, build_rule_tables);
+}
+
 // 获取设备规则配置
 const rule_table_entry_t* get_device_rules(device_type_id_t device_type, int* count) {
     // 确保规则表已初始化
     printf("获取设备类型 %d 的规则...\n", device_type);
     init_rule_tables();
     
+    const char* label;
     switch (device_type) {
         case DEVICE_TYPE_FLASH:
-            if (count) *count = flash_rule_table_count;
-            printf("返回 %d 条Flash规则，规则表地址: %p\n", flash_rule_table_count, flash_rules);
-            // 打印每条规则的详细信息
-            for (int i = 0; i < flash_rule_table_count; i++) {
-                printf("Flash规则 %d: name=%s, trigger_addr=0x%x, targets.count=%d\n", 
-                       i, flash_rules[i].name, flash_rules[i].trigger.trigger_addr, flash_rules[i].targets.count);
-            }
-            return flash_rules;
-            
+            label = "Flash";
+            break;
         case DEVICE_TYPE_TEMP_SENSOR:
-            if (count) *count = temp_sensor_rule_table_count;
-            printf("返回 %d 条温度传感器规则，规则表地址: %p\n", temp_sensor_rule_table_count, temp_sensor_rules);
-            // 打印每条规则的详细信息
-            for (int i = 0; i < temp_sensor_rule_table_count; i++) {
-                printf("温度传感器规则 %d: name=%s, trigger_addr=0x%x, targets.count=%d\n", 
-                       i, temp_sensor_rules[i].name, temp_sensor_rules[i].trigger.trigger_addr, temp_sensor_rules[i].targets.count);
-            }
-            return temp_sensor_rules;
-            
+            label = "温度传感器";
+            break;
         case DEVICE_TYPE_FPGA:
-            if (count) *count = fpga_rule_table_count;
-            printf("返回 %d 条FPGA规则，规则表地址: %p\n", fpga_rule_table_count, fpga_rules);
-            // 打印每条规则的详细信息
-            for (int i = 0; i < fpga_rule_table_count; i++) {
-                printf("FPGA规则 %d: name=%s, trigger_addr=0x%x, targets.count=%d\n", 
-                       i, fpga_rules[i].name, fpga_rules[i].trigger.trigger_addr, fpga_rules[i].targets.count);
-            }
-            return fpga_rules;
-            
+            label = "FPGA";
+            break;
         default:
             if (count) *count = 0;
             printf("未知设备类型 %d，返回0条规则\n", device_type);
             return NULL;
     }
-} 
\ No newline at end of file
+    
+    int rule_count = 0;
+    const rule_table_entry_t* rules = device_rule_table(device_rule_snapshot(), device_type, &rule_count);
+    if (count) *count = rule_count;
+    printf("返回 %d 条%s规则，规则表地址: %p\n", rule_count, label, (void*)rules);
+    // 打印每条规则的详细信息
+    for (int i = 0; i < rule_count; i++) {
+        printf("%s规则 %d: name=%s, trigger_addr=0x%x, targets.count=%d\n", 
+               label, i, rules[i].name, rules[i].trigger.trigger_addr, rules[i].targets.count);
+    }
+    return rules;
+} 
+
+// 设置设备类型规则的触发合并策略
+int set_device_rule_coalescing(device_type_id_t device_type, uint32_t trigger_addr, 
+                               uint32_t every_writes, uint32_t window_us) {
+    int slot = device_rule_slot(device_type);
+    if (slot < 0 || !device_rules_can_update()) return 0;
+    init_rule_tables();
+    
+    pthread_mutex_lock(&g_rule_update_lock);
+    device_rule_snapshot_t* current = g_rule_snapshot;
+    int updated = 0;
+    for (int i = 0; current && i < current->counts[slot]; i++) {
+        if (current->rules[slot][i].trigger.trigger_addr == trigger_addr) updated++;
+    }
+    if (updated == 0) {
+        pthread_mutex_unlock(&g_rule_update_lock);
+        return 0;
+    }
+    
+    device_rule_snapshot_t* snap = device_rule_snapshot_copy(current, -1, 0);
+    if (!snap || device_rule_snapshot_index(snap) != 0) {
+        printf("错误: 无法为设备类型 %d 设置规则合并策略\n", device_type);
+        device_rule_snapshot_free(snap);
+        pthread_mutex_unlock(&g_rule_update_lock);
+        return 0;
+    }
+    for (int i = 0; i < snap->counts[slot]; i++) {
+        rule_table_entry_t* rule = &snap->rules[slot][i];
+        if (rule->trigger.trigger_addr != trigger_addr) continue;
+        rule->coalesce.every_writes = every_writes;
+        rule->coalesce.window_us = window_us;
+    }
+    device_rules_publish(snap);
+    pthread_mutex_unlock(&g_rule_update_lock);
+    return updated;
+}
+
+// 获取规则表代次
+uint64_t device_rules_generation(void) {
+    if (!__atomic_load_n(&g_rule_snapshot, __ATOMIC_ACQUIRE)) {
+        init_rule_tables();
+    }
+    return __atomic_load_n(&g_rule_generation, __ATOMIC_SEQ_CST);
+}
+
+// 获取设备类型的规则表及规则表代次
+const rule_table_entry_t* get_device_rule_table(device_type_id_t device_type, int* count, uint64_t* generation) {
+    if (!__atomic_load_n(&g_rule_snapshot, __ATOMIC_ACQUIRE)) {
+        init_rule_tables();
+    }
+    // 规则表和代次取自同一个快照
+    const device_rule_snapshot_t* snap = device_rule_snapshot();
+    if (generation) {
+        *generation = snap ? snap->generation : 0;
+    }
+    return device_rule_table(snap, device_type, count);
+}
+
+// 按触发字查找设备规则
+const rule_table_entry_t* get_device_rules_at(device_type_id_t device_type, uint32_t addr, 
+                                              const int** positions, int* count) {
+    if (!__atomic_load_n(&g_rule_snapshot, __ATOMIC_ACQUIRE)) {
+        init_rule_tables();
+    }
+    
+    int table_count = 0;
+    const device_rule_snapshot_t* snap = device_rule_snapshot();
+    const rule_table_entry_t* rules = device_rule_table(snap, device_type, &table_count);
+    *count = rules ? rule_index_lookup(snap->index, device_type, addr, positions) : 0;
+    return *count > 0 ? rules : NULL;
+}
+
+// 查找与 [start, end) 重叠的设备范围规则
+const rule_table_entry_t* get_device_range_rules(device_type_id_t device_type, uint32_t start, uint64_t end, 
+                                                 int* positions, int max_positions, int* count) {
+    if (!__atomic_load_n(&g_rule_snapshot, __ATOMIC_ACQUIRE)) {
+        init_rule_tables();
+    }
+    
+    int table_count = 0;
+    const device_rule_snapshot_t* snap = device_rule_snapshot();
+    const rule_table_entry_t* rules = device_rule_table(snap, device_type, &table_count);
+    *count = rules ? rule_range_index_query(snap->ranges, device_type, start, end, positions, max_positions) : 0;
+    return *count > 0 ? rules : NULL;
+}
+
+// 运行时向设备类型规则表追加规则
+int add_device_rule(device_type_id_t device_type, const char* name, rule_trigger_t trigger, 
+                    const action_target_array_t* targets, int priority) {
+    int slot = device_rule_slot(device_type);
+    if (slot < 0) {
+        printf("错误: 未知设备类型 %d，无法添加规则\n", device_type);
+        return -1;
+    }
+    if (!device_rules_can_update()) return -1;
+    init_rule_tables();
+    
+    rule_table_entry_t* entry = rule_table_entry_create(name, trigger, targets, priority);
+    if (!entry) {
+        printf("错误: 无法创建规则表项\n");
+        return -1;
+    }
+    entry->device_type = device_type;
+    
+    pthread_mutex_lock(&g_rule_update_lock);
+    device_rule_snapshot_t* snap = g_rule_snapshot ? device_rule_snapshot_copy(g_rule_snapshot, slot, 1) : NULL;
+    int position = -1;
+    if (snap) {
+        position = snap->counts[slot]++;
+        snap->rules[slot][position] = *entry;
+    }
+    if (!snap || device_rule_snapshot_index(snap) != 0) {
+        printf("错误: 无法为规则 %s 发布规则表\n", entry->name);
+        pthread_mutex_unlock(&g_rule_update_lock);
+        device_rule_snapshot_free(snap);
+        if (strcmp(entry->name, "Unnamed Rule") != 0) {
+            free((void*)entry->name);
+        }
+        free(entry);
+        return -1;
+    }
+    device_rules_publish(snap);
+    pthread_mutex_unlock(&g_rule_update_lock);
+    free(entry);
+    return position;
+}
+
+// 运行时从设备类型规则表删除规则
+int remove_device_rule(device_type_id_t device_type, const char* name) {
+    int slot = device_rule_slot(device_type);
+    if (slot < 0 || !name) {
+        printf("错误: 无法从设备类型 %d 删除规则\n", device_type);
+        return -1;
+    }
+    if (!device_rules_can_update()) return -1;
+    init_rule_tables();
+    
+    pthread_mutex_lock(&g_rule_update_lock);
+    device_rule_snapshot_t* current = g_rule_snapshot;
+    int position = -1;
+    for (int i = 0; current && i < current->counts[slot]; i++) {
+        if (strcmp(current->rules[slot][i].name, name) == 0) {
+            position = i;
+            break;
+        }
+    }
+    if (position < 0) {
+        pthread_mutex_unlock(&g_rule_update_lock);
+        printf("错误: 设备类型 %d 没有规则 %s\n", device_type, name);
+        return -1;
+    }
+    
+    // 待执行的触发可能仍引用规则名，名称登记后保留到进程结束
+    const char* removed = current->rules[slot][position].name;
+    const char** names = (const char**)realloc(g_removed_rule_names, 
+                                               (g_removed_rule_name_count + 1) * sizeof(const char*));
+    device_rule_snapshot_t* snap = device_rule_snapshot_copy(current, -1, 0);
+    if (names) {
+        g_removed_rule_names = names;
+    }
+    if (!names || !snap) {
+        printf("错误: 无法删除规则 %s\n", name);
+        device_rule_snapshot_free(snap);
+        pthread_mutex_unlock(&g_rule_update_lock);
+        return -1;
+    }
+    rule_table_entry_t* rules = snap->rules[slot];
+    memmove(&rules[position], &rules[position + 1], 
+            (snap->counts[slot] - position - 1) * sizeof(rule_table_entry_t));
+    snap->counts[slot]--;
+    if (device_rule_snapshot_index(snap) != 0) {
+        printf("错误: 无法删除规则 %s\n", name);
+        device_rule_snapshot_free(snap);
+        pthread_mutex_unlock(&g_rule_update_lock);
+        return -1;
+    }
+    g_removed_rule_names[g_removed_rule_name_count++] = removed;
+    device_rules_publish(snap);
+    pthread_mutex_unlock(&g_rule_update_lock);
+    return 0;
+}
@@ -10,6 +10,20 @@ int device_rule_add(device_rule_manager_t* manager, uint32_t addr,
                    const action_target_array_t* targets) {
     if (!manager || !targets) return -1;
     
+    // 目标动作放入共享目标池，规则只保存引用
+    action_target_ref_t ref;
+    if (action_target_pool_intern(targets->targets, targets->count, &ref) != 0) {
+        return -1;
+    }
+    return device_rule_add_ref(manager, addr, expected_value, expected_mask, ref);
+}
+
+// 添加设备规则（目标池引用）
+int device_rule_add_ref(device_rule_manager_t* manager, uint32_t addr, 
+                       uint32_t expected_value, uint32_t expected_mask,
+                       action_target_ref_t targets) {
+    if (!manager) return -1;
+    
     pthread_mutex_lock(manager->mutex);
     
     // 检查是否需要扩展规则数组
@@ -33,15 +47,7 @@ int device_rule_add(device_rule_manager_t* manager, uint32_t addr,
     rule->addr = addr;
     rule->expected_value = expected_value;
     rule->expected_mask = expected_mask;
-    
-    // 为targets分配内存并复制内容
-    rule->targets = (action_target_array_t*)malloc(sizeof(action_target_array_t));
-    if (!rule->targets) {
-        pthread_mutex_unlock(manager->mutex);
-        return -1;
-    }
-    memcpy(rule->targets, targets, sizeof(action_target_array_t));
-    
+    rule->targets = targets;
     rule->active = 1;
     
     manager->rule_count++;
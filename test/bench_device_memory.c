@@ -0,0 +1,133 @@
+/**
+ * @file bench_device_memory.c
+ * @brief 设备内存地址解码微基准测试
+ *
+ * 对比 device_memory_find_region（最近命中缓存 + 二分查找）与原有的线性扫描，
+ * 区域数量分别为 3、32 和 256。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "device_memory.h"
+
+#define BENCH_LOOKUPS      (1 << 22)
+#define BENCH_REGION_SIZE  0x100   // 每个区域的字节数
+#define BENCH_REGION_GAP   0x100   // 区域之间的空洞
+
+// 防止编译器优化掉查找结果
+static volatile uintptr_t g_sink;
+
+// 原有实现：线性扫描所有区域
+static memory_region_t* linear_find_region(device_memory_t* mem, uint32_t addr) {
+    for (int i = 0; i < mem->region_count; i++) {
+        memory_region_t* region = &mem->regions[i];
+        uint32_t region_end = region->base_addr + (region->unit_size * region->length);
+        if (addr >= region->base_addr && addr < region_end) {
+            return region;
+        }
+    }
+    return NULL;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 创建包含 region_count 个区域的设备内存，区域按逆序传入以验证排序
+static device_memory_t* create_bench_memory(int region_count) {
+    memory_region_t* regions = (memory_region_t*)calloc(region_count, sizeof(memory_region_t));
+    if (!regions) return NULL;
+
+    for (int i = 0; i < region_count; i++) {
+        int slot = region_count - 1 - i;
+        regions[i].base_addr = slot * (BENCH_REGION_SIZE + BENCH_REGION_GAP);
+        regions[i].unit_size = 4;
+        regions[i].length = BENCH_REGION_SIZE / 4;
+    }
+
+    device_memory_t* mem = device_memory_create(regions, region_count, NULL, DEVICE_TYPE_FPGA, 0);
+    free(regions);
+    return mem;
+}
+
+// 生成地址序列：random=1 时随机分布在所有区域中，否则集中在同一区域（缓存命中路径）
+static uint32_t* create_addresses(int region_count, int random) {
+    uint32_t* addrs = (uint32_t*)malloc(BENCH_LOOKUPS * sizeof(uint32_t));
+    if (!addrs) return NULL;
+
+    uint32_t seed = 12345;
+    for (int i = 0; i < BENCH_LOOKUPS; i++) {
+        seed = seed * 1103515245 + 12345;
+        int slot = random ? (int)((seed >> 8) % region_count) : region_count / 2;
+        uint32_t offset = (seed >> 16) % BENCH_REGION_SIZE;
+        addrs[i] = slot * (BENCH_REGION_SIZE + BENCH_REGION_GAP) + offset;
+    }
+    return addrs;
+}
+
+static double run_linear(device_memory_t* mem, const uint32_t* addrs) {
+    double start = now_seconds();
+    for (int i = 0; i < BENCH_LOOKUPS; i++) {
+        g_sink += (uintptr_t)linear_find_region(mem, addrs[i]);
+    }
+    return (now_seconds() - start) * 1e9 / BENCH_LOOKUPS;
+}
+
+static double run_indexed(device_memory_t* mem, const uint32_t* addrs) {
+    double start = now_seconds();
+    for (int i = 0; i < BENCH_LOOKUPS; i++) {
+        g_sink += (uintptr_t)device_memory_find_region(mem, addrs[i]);
+    }
+    return (now_seconds() - start) * 1e9 / BENCH_LOOKUPS;
+}
+
+// 校验两种查找结果一致
+static int verify(device_memory_t* mem, const uint32_t* addrs) {
+    for (int i = 0; i < BENCH_LOOKUPS; i += 97) {
+        if (linear_find_region(mem, addrs[i]) != device_memory_find_region(mem, addrs[i])) {
+            printf("错误: 地址 0x%08X 的查找结果不一致\n", addrs[i]);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int main(void) {
+    const int region_counts[] = {3, 32, 256};
+    int ret = 0;
+
+    printf("%-8s %-8s %14s %14s %8s\n", "区域数", "访问模式", "线性扫描(ns)", "索引查找(ns)", "加速比");
+
+    for (size_t i = 0; i < sizeof(region_counts) / sizeof(region_counts[0]); i++) {
+        int count = region_counts[i];
+        device_memory_t* mem = create_bench_memory(count);
+        if (!mem) {
+            printf("错误: 无法创建 %d 个区域的设备内存\n", count);
+            return 1;
+        }
+
+        for (int random = 0; random <= 1; random++) {
+            uint32_t* addrs = create_addresses(count, random);
+            if (!addrs || verify(mem, addrs) != 0) {
+                free(addrs);
+                ret = 1;
+                continue;
+            }
+
+            double linear_ns = run_linear(mem, addrs);
+            double indexed_ns = run_indexed(mem, addrs);
+            printf("%-8d %-8s %14.2f %14.2f %7.1fx\n", count, random ? "random" : "same",
+                   linear_ns, indexed_ns, linear_ns / indexed_ns);
+            free(addrs);
+        }
+
+        device_memory_destroy(mem);
+    }
+
+    return ret;
+}
@@ -0,0 +1,1839 @@
+/**
+ * @file test_device_memory.c
+ * @brief 设备内存测试程序
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include "device_memory.h"
+#include "device_rule_configs.h"
+#include "action_manager.h"
+#include "action_dispatcher.h"
+
+static int g_failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("失败: %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        g_failures++; \
+    } \
+} while (0)
+
+// 与FPGA相同的布局：寄存器和配置区共享第0页，数据区从0x1000开始
+static const memory_region_t fpga_like_regions[] = {
+    { .base_addr = 0x1000, .unit_size = 4, .length = (0x10000 - 0x1000) / 4 },
+    { .base_addr = 0x00,   .unit_size = 4, .length = 16 },
+    { .base_addr = 0x100,  .unit_size = 4, .length = (0x1000 - 0x100) / 4 },
+};
+
+// 测试页表解码
+static void test_page_table_decode(void) {
+    printf("测试页表解码...\n");
+    device_memory_t* mem = device_memory_create(fpga_like_regions, 3, NULL, 0, 0);
+    CHECK(mem != NULL);
+    if (!mem) return;
+
+    CHECK(mem->page_table != NULL);
+    CHECK(mem->page_count == 16);
+    CHECK(mem->page_table[0] == PAGE_ENTRY_SHARED);
+
+    // 区域按基地址排序
+    CHECK(mem->regions[0].base_addr == 0x00);
+    CHECK(mem->regions[1].base_addr == 0x100);
+    CHECK(mem->regions[2].base_addr == 0x1000);
+
+    CHECK(device_memory_find_region(mem, 0x0C) == &mem->regions[0]);
+    CHECK(device_memory_find_region(mem, 0x40) == NULL);      // 寄存器区与配置区之间的空洞
+    CHECK(device_memory_find_region(mem, 0x100) == &mem->regions[1]);
+    CHECK(device_memory_find_region(mem, 0xFFF) == &mem->regions[1]);
+    CHECK(device_memory_find_region(mem, 0x1000) == &mem->regions[2]);
+    CHECK(device_memory_find_region(mem, 0xFFFF) == &mem->regions[2]);
+    CHECK(device_memory_find_region(mem, 0x10000) == NULL);   // 页表覆盖范围之外
+
+    uint32_t value = 0;
+    CHECK(device_memory_write(mem, 0x2000, 0xCAFEBABE) == 0);
+    CHECK(device_memory_read(mem, 0x2000, &value) == 0 && value == 0xCAFEBABE);
+
+    device_memory_destroy(mem);
+}
+
+// 测试稀疏地址空间回退到二分查找
+static void test_sparse_layout_fallback(void) {
+    printf("测试稀疏地址空间...\n");
+    const memory_region_t regions[] = {
+        { .base_addr = 0x00000000, .unit_size = 4, .length = 16 },
+        { .base_addr = 0x80000000, .unit_size = 4, .length = 16 },
+    };
+    device_memory_t* mem = device_memory_create(regions, 2, NULL, 0, 0);
+    CHECK(mem != NULL);
+    if (!mem) return;
+
+    CHECK(mem->page_table == NULL);
+    CHECK(device_memory_find_region(mem, 0x80000004) == &mem->regions[1]);
+    CHECK(device_memory_find_region(mem, 0x40000000) == NULL);
+
+    device_memory_destroy(mem);
+}
+
+// 测试重叠区域被拒绝
+static void test_overlapping_regions(void) {
+    printf("测试重叠区域...\n");
+    const memory_region_t regions[] = {
+        { .base_addr = 0x00, .unit_size = 4, .length = 16 },
+        { .base_addr = 0x20, .unit_size = 4, .length = 16 },
+    };
+    CHECK(device_memory_create(regions, 2, NULL, 0, 0) == NULL);
+}
+
+// 测试稀疏区域按页分配
+static void test_sparse_region(void) {
+    printf("测试稀疏区域...\n");
+    const memory_region_t regions[] = {
+        { .base_addr = 0x00,   .unit_size = 4, .length = 8 },
+        { .base_addr = 0x1000, .unit_size = 4, .length = (64 << 20) / 4,
+          .flags = MEMORY_REGION_SPARSE, .fill_value = 0xFF },
+    };
+    device_memory_t* mem = device_memory_create(regions, 2, NULL, 0, 0);
+    CHECK(mem != NULL);
+    if (!mem) return;
+
+    memory_region_t* data = &mem->regions[1];
+    CHECK(data->data == NULL && data->pages != NULL);
+    CHECK(device_memory_region_resident_bytes(data) == 0);
+    CHECK(device_memory_resident_bytes(mem) == 32);
+
+    // 读取未写入的页返回填充值且不分配
+    uint32_t value = 0;
+    CHECK(device_memory_read(mem, 0x200000, &value) == 0 && value == 0xFFFFFFFF);
+    CHECK(device_memory_region_resident_bytes(data) == 0);
+
+    // 写入填充值不分配
+    CHECK(device_memory_write_byte(mem, 0x300000, 0xFF) == 0);
+    CHECK(device_memory_region_resident_bytes(data) == 0);
+
+    // 跨页的未对齐写入分配两页
+    CHECK(device_memory_write(mem, 0x1000 + DEVICE_MEMORY_PAGE_SIZE - 2, 0x11223344) == 0);
+    CHECK(device_memory_region_resident_bytes(data) == 2 * DEVICE_MEMORY_PAGE_SIZE);
+    CHECK(device_memory_read(mem, 0x1000 + DEVICE_MEMORY_PAGE_SIZE - 2, &value) == 0 && value == 0x11223344);
+
+    uint8_t byte = 0;
+    CHECK(device_memory_read_byte(mem, 0x1000 + DEVICE_MEMORY_PAGE_SIZE - 3, &byte) == 0 && byte == 0xFF);
+
+    device_memory_destroy(mem);
+}
+
+// 测试文件映射区域
+static void test_file_backed_region(void) {
+    printf("测试文件映射区域...\n");
+    char path[] = "/tmp/test_device_memory_XXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    if (fd < 0) return;
+    close(fd);
+
+    memory_region_t regions[] = {
+        { .base_addr = 0x0000, .unit_size = 4, .length = 0x2000 / 4,
+          .flags = MEMORY_REGION_FILE_SHARED, .fill_value = 0xFF, .backing_file = path },
+    };
+
+    // MAP_SHARED：空文件扩展为区域大小并以填充值初始化，写入在重建后仍然存在
+    device_memory_t* mem = device_memory_create(regions, 1, NULL, 0, 0);
+    CHECK(mem != NULL);
+    if (!mem) { unlink(path); return; }
+    uint32_t value = 0;
+    CHECK(device_memory_read(mem, 0x1000, &value) == 0 && value == 0xFFFFFFFF);
+    CHECK(device_memory_write(mem, 0x1004, 0x12345678) == 0);
+    CHECK(device_memory_sync_range(mem, 0x1004, 4, DEVICE_MEMORY_SYNC_WAIT) == 0);
+    CHECK(device_memory_sync(mem, DEVICE_MEMORY_SYNC_ASYNC) == 0);
+    device_memory_destroy(mem);
+
+    mem = device_memory_create(regions, 1, NULL, 0, 0);
+    CHECK(mem != NULL);
+    if (!mem) { unlink(path); return; }
+    CHECK(device_memory_read(mem, 0x1004, &value) == 0 && value == 0x12345678);
+    device_memory_destroy(mem);
+
+    // MAP_PRIVATE：读取文件内容，写入不回写文件
+    regions[0].flags = MEMORY_REGION_FILE_PRIVATE;
+    mem = device_memory_create(regions, 1, NULL, 0, 0);
+    CHECK(mem != NULL);
+    if (!mem) { unlink(path); return; }
+    CHECK(device_memory_read(mem, 0x1004, &value) == 0 && value == 0x12345678);
+    CHECK(device_memory_write(mem, 0x1004, 0xDEADBEEF) == 0);
+    CHECK(device_memory_sync(mem, DEVICE_MEMORY_SYNC_WAIT) == 0);
+    device_memory_destroy(mem);
+
+    regions[0].flags = MEMORY_REGION_FILE_SHARED;
+    mem = device_memory_create(regions, 1, NULL, 0, 0);
+    CHECK(mem != NULL);
+    if (mem) {
+        CHECK(device_memory_read(mem, 0x1004, &value) == 0 && value == 0x12345678);
+        device_memory_destroy(mem);
+    }
+
+    unlink(path);
+}
+
+// 测试按宽度访问
+static void test_width_access(void) {
+    printf("测试按宽度访问...\n");
+    const memory_region_t regions[] = {
+        { .base_addr = 0x0000, .unit_size = 4, .length = 64 },
+        { .base_addr = 0x1000, .unit_size = 4, .length = 16, .flags = MEMORY_REGION_STRICT_WIDTH },
+        { .base_addr = 0x2000, .unit_size = 4, .length = 2 * DEVICE_MEMORY_PAGE_SIZE / 4,
+          .flags = MEMORY_REGION_SPARSE },
+    };
+    device_memory_t* mem = device_memory_create(regions, 3, NULL, 0, 0);
+    CHECK(mem != NULL);
+    if (!mem) return;
+
+    // 对齐64位写入，按小端拆分为低/高32位
+    uint64_t v64 = 0;
+    uint32_t v32 = 0;
+    uint16_t v16 = 0;
+    CHECK(device_memory_write64(mem, 0x10, 0x1122334455667788ULL) == 0);
+    CHECK(device_memory_read(mem, 0x10, &v32) == 0 && v32 == 0x55667788);
+    CHECK(device_memory_read(mem, 0x14, &v32) == 0 && v32 == 0x11223344);
+    CHECK(device_memory_read16(mem, 0x12, &v16) == 0 && v16 == 0x5566);
+
+    // 未对齐访问
+    CHECK(device_memory_write16(mem, 0x21, 0xBEEF) == 0);
+    CHECK(device_memory_read_width(mem, 0x21, 2, &v64) == 0 && v64 == 0xBEEF);
+    CHECK(device_memory_write64(mem, 0x33, 0x0102030405060708ULL) == 0);
+    CHECK(device_memory_read64(mem, 0x33, &v64) == 0 && v64 == 0x0102030405060708ULL);
+
+    // 越界与非法宽度
+    CHECK(device_memory_read64(mem, 0xFC, &v64) != 0);
+    CHECK(device_memory_read_width(mem, 0x10, 3, &v64) != 0);
+
+    // 严格宽度区域只接受unit_size宽度的对齐访问
+    CHECK(device_memory_write_width(mem, 0x1004, 4, 0xA5A5A5A5) == 0);
+    CHECK(device_memory_write16(mem, 0x1004, 0x1234) != 0);
+    CHECK(device_memory_write64(mem, 0x1008, 0) != 0);
+    CHECK(device_memory_read_width(mem, 0x1002, 4, &v64) != 0);
+    CHECK(device_memory_read_width(mem, 0x1004, 4, &v64) == 0 && v64 == 0xA5A5A5A5);
+
+    // 稀疏区域跨页的64位访问
+    uint32_t cross = 0x2000 + DEVICE_MEMORY_PAGE_SIZE - 4;
+    CHECK(device_memory_write64(mem, cross, 0xCAFEF00DDEADBEEFULL) == 0);
+    CHECK(device_memory_read64(mem, cross, &v64) == 0 && v64 == 0xCAFEF00DDEADBEEFULL);
+    CHECK(device_memory_region_resident_bytes(&mem->regions[2]) == 2 * DEVICE_MEMORY_PAGE_SIZE);
+
+    device_memory_destroy(mem);
+}
+
+// 测试分散/聚集访问
+static void test_vectored_io(void) {
+    printf("测试分散/聚集访问...\n");
+    device_memory_t* mem = device_memory_create(fpga_like_regions, 3, NULL, 0, 0);
+    CHECK(mem != NULL);
+    if (!mem) return;
+
+    uint8_t a[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    uint8_t b[4] = {0xAA, 0xBB, 0xCC, 0xDD};
+    device_iovec_t out[] = {
+        { .addr = 0x04,   .buffer = a, .length = sizeof(a) },
+        { .addr = 0x200,  .buffer = b, .length = sizeof(b) },
+        { .addr = 0x3000, .buffer = a, .length = 3 },
+    };
+    CHECK(device_memory_writev(mem, out, 3) == 0);
+
+    uint8_t ra[8] = {0}, rb[4] = {0}, rc[3] = {0};
+    device_iovec_t in[] = {
+        { .addr = 0x04,   .buffer = ra, .length = sizeof(ra) },
+        { .addr = 0x200,  .buffer = rb, .length = sizeof(rb) },
+        { .addr = 0x3000, .buffer = rc, .length = sizeof(rc) },
+    };
+    CHECK(device_memory_readv(mem, in, 3) == 0);
+    CHECK(memcmp(ra, a, sizeof(a)) == 0);
+    CHECK(memcmp(rb, b, sizeof(b)) == 0);
+    CHECK(memcmp(rc, a, sizeof(rc)) == 0);
+
+    // 任一段无效时不写入任何段
+    uint8_t z[4] = {0};
+    device_iovec_t bad[] = {
+        { .addr = 0x200, .buffer = z, .length = sizeof(z) },
+        { .addr = 0x40,  .buffer = z, .length = sizeof(z) },   // 区域间空洞
+    };
+    CHECK(device_memory_writev(mem, bad, 2) != 0);
+    uint32_t value = 0;
+    CHECK(device_memory_read(mem, 0x200, &value) == 0 && value == 0xDDCCBBAA);
+
+    // 超过栈数组的段数
+    device_iovec_t many[DEVICE_MEMORY_IOV_STACK * 2];
+    uint8_t regs[DEVICE_MEMORY_IOV_STACK * 2][4];
+    for (int i = 0; i < DEVICE_MEMORY_IOV_STACK * 2; i++) {
+        many[i].addr = 0x1000 + i * 0x40;
+        many[i].buffer = regs[i];
+        many[i].length = sizeof(regs[i]);
+    }
+    CHECK(device_memory_readv(mem, many, DEVICE_MEMORY_IOV_STACK * 2) == 0);
+
+    device_memory_destroy(mem);
+}
+
+// 测试跨区域批量访问
+static void test_spanning_buffer(void) {
+    printf("测试跨区域批量访问...\n");
+    device_memory_t* mem = device_memory_create(fpga_like_regions, 3, NULL, 0, 0);
+    CHECK(mem != NULL);
+    if (!mem) return;
+
+    // 配置区 0x100..0x1000 与数据区 0x1000.. 首尾相接，一次访问跨越两个区域
+    uint8_t out[0x200], in[0x200];
+    for (size_t i = 0; i < sizeof(out); i++) out[i] = (uint8_t)(i * 7 + 1);
+    CHECK(device_memory_write_buffer(mem, 0xF00, out, sizeof(out)) == 0);
+    memset(in, 0, sizeof(in));
+    CHECK(device_memory_read_buffer(mem, 0xF00, in, sizeof(in)) == 0);
+    CHECK(memcmp(in, out, sizeof(out)) == 0);
+    uint32_t value = 0;
+    CHECK(device_memory_read(mem, 0x1000, &value) == 0 && value == *(uint32_t*)(out + 0x100));
+
+    // 范围内有空洞时不写入任何数据，并报告空洞位置
+    uint8_t z[0x100] = {0};
+    CHECK(device_memory_write(mem, 0x20, 0x11223344) == 0);
+    CHECK(device_memory_write_buffer(mem, 0x20, z, sizeof(z)) == -1);
+    CHECK(device_memory_read(mem, 0x20, &value) == 0 && value == 0x11223344);
+    CHECK(device_memory_read_buffer(mem, 0x20, in, sizeof(z)) == -1);
+
+    uint32_t hole = 0;
+    size_t hole_length = 0;
+    CHECK(device_memory_find_hole(mem, 0x20, 0x100, &hole, &hole_length) == 1 && 
+          hole == 0x40 && hole_length == 0xC0);
+    CHECK(device_memory_find_hole(mem, 0x80, 0x100, &hole, &hole_length) == 1 && 
+          hole == 0x80 && hole_length == 0x80);
+    CHECK(device_memory_find_hole(mem, 0xFFF0, 0x20, &hole, &hole_length) == 1 && 
+          hole == 0x10000 && hole_length == 0x10);
+    CHECK(device_memory_find_hole(mem, 0x100, 0xFF00, NULL, NULL) == 0);
+    CHECK(device_memory_find_hole(mem, 0xFFFFFFF0, 0x20, NULL, NULL) == -1);
+
+    device_memory_destroy(mem);
+}
+
+// 测试快照与恢复
+static void test_snapshot_restore(void) {
+    printf("测试快照与恢复...\n");
+    const memory_region_t regions[] = {
+        { .base_addr = 0x00,   .unit_size = 4, .length = 4 * DEVICE_MEMORY_PAGE_SIZE / 4 },
+        { .base_addr = 0x100000, .unit_size = 4, .length = (1 << 20) / 4,
+          .flags = MEMORY_REGION_SPARSE, .fill_value = 0xFF },
+    };
+    device_memory_t* mem = device_memory_create(regions, 2, NULL, 0, 0);
+    CHECK(mem != NULL);
+    if (!mem) return;
+
+    uint32_t value = 0;
+    CHECK(device_memory_write(mem, 0x10, 0x11111111) == 0);
+    CHECK(device_memory_write(mem, 0x100000, 0x22222222) == 0);
+
+    device_memory_snapshot_t* snap = device_memory_snapshot(mem);
+    CHECK(snap != NULL);
+    if (!snap) { device_memory_destroy(mem); return; }
+
+    // 快照后稀疏区域页是共享的，写入触发写时复制，不影响快照
+    memory_region_t* sparse = &mem->regions[1];
+    uint8_t* shared_page = sparse->pages[0];
+    CHECK(device_memory_write(mem, 0x100004, 0x33333333) == 0);
+    CHECK(sparse->pages[0] != shared_page);
+    CHECK(device_memory_write(mem, 0x180000, 0x44444444) == 0);
+    CHECK(device_memory_write(mem, 0x10, 0x55555555) == 0);
+    CHECK(device_memory_write64(mem, 0x2000, 0x6666666666666666ULL) == 0);
+
+    // 多次恢复同一快照
+    for (int round = 0; round < 3; round++) {
+        CHECK(device_memory_restore(mem, snap) == 0);
+        CHECK(device_memory_read(mem, 0x10, &value) == 0 && value == 0x11111111);
+        CHECK(device_memory_read(mem, 0x2000, &value) == 0 && value == 0);
+        CHECK(device_memory_read(mem, 0x100000, &value) == 0 && value == 0x22222222);
+        CHECK(device_memory_read(mem, 0x100004, &value) == 0 && value == 0xFFFFFFFF);
+        CHECK(device_memory_read(mem, 0x180000, &value) == 0 && value == 0xFFFFFFFF);
+        CHECK(sparse->pages[0] == shared_page);
+        CHECK(device_memory_region_resident_bytes(sparse) == DEVICE_MEMORY_PAGE_SIZE);
+        CHECK(device_memory_write(mem, 0x10, 0x77777777) == 0);
+        CHECK(device_memory_write(mem, 0x100000, 0x88888888) == 0);
+    }
+
+    // 普通区域的新快照只复制写入过的页，其余页与上一个快照共享
+    memory_region_t* flat = &mem->regions[0];
+    uint8_t* written_page = flat->snap_pages[0];
+    uint8_t* untouched_page = flat->snap_pages[1];
+    device_memory_snapshot_t* snap2 = device_memory_snapshot(mem);
+    CHECK(snap2 != NULL);
+    CHECK(flat->snap_pages[0] != written_page && flat->snap_pages[1] == untouched_page);
+
+    // 恢复较旧的快照时只复制与之不同的页
+    CHECK(device_memory_restore(mem, snap) == 0);
+    CHECK(device_memory_read(mem, 0x10, &value) == 0 && value == 0x11111111);
+    CHECK(device_memory_restore(mem, snap2) == 0);
+    CHECK(device_memory_read(mem, 0x10, &value) == 0 && value == 0x77777777);
+    CHECK(device_memory_read(mem, 0x100000, &value) == 0 && value == 0x88888888);
+
+    // 快照可以在设备内存销毁后单独释放
+    device_memory_destroy(mem);
+    device_memory_snapshot_destroy(snap);
+    device_memory_snapshot_destroy(snap2);
+
+    // 布局不一致的内存拒绝恢复
+    mem = device_memory_create(fpga_like_regions, 3, NULL, 0, 0);
+    CHECK(mem != NULL);
+    if (!mem) return;
+    snap = device_memory_snapshot(mem);
+    device_memory_t* other = device_memory_create(regions, 2, NULL, 0, 0);
+    CHECK(other != NULL && device_memory_restore(other, snap) != 0);
+    device_memory_snapshot_destroy(snap);
+    device_memory_destroy(other);
+    device_memory_destroy(mem);
+}
+
+// 测试脏页跟踪
+static void test_dirty_tracking(void) {
+    printf("测试脏页跟踪...\n");
+    const memory_region_t regions[] = {
+        { .base_addr = 0x000000, .unit_size = 4, .length = 8 * DEVICE_MEMORY_PAGE_SIZE / 4 },
+        { .base_addr = 0x100000, .unit_size = 4, .length = 128 * DEVICE_MEMORY_PAGE_SIZE / 4,
+          .flags = MEMORY_REGION_SPARSE },
+    };
+    device_memory_t* mem = device_memory_create(regions, 2, NULL, 0, 0);
+    CHECK(mem != NULL);
+    if (!mem) return;
+
+    uint64_t bitmap[2] = {0};
+    CHECK(device_memory_dirty_words(&mem->regions[0]) == 1);
+    CHECK(device_memory_dirty_words(&mem->regions[1]) == 2);
+    CHECK(device_memory_fetch_clear_dirty(mem, 0, bitmap, 1) == 0 && bitmap[0] == 0);
+
+    // 各写入路径都会标记脏页，跨页写入标记两页
+    uint8_t buf[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    device_iovec_t iov = { .addr = 0x5000, .buffer = buf, .length = sizeof(buf) };
+    CHECK(device_memory_write(mem, 0x0000, 1) == 0);
+    CHECK(device_memory_write_byte(mem, 0x1001, 2) == 0);
+    CHECK(device_memory_write_buffer(mem, 0x3FFC, buf, sizeof(buf)) == 0);
+    CHECK(device_memory_writev(mem, &iov, 1) == 0);
+    CHECK(device_memory_fetch_clear_dirty(mem, 0, bitmap, 1) == 5);
+    CHECK(bitmap[0] == 0x3B);
+    CHECK(device_memory_fetch_clear_dirty(mem, 0, bitmap, 1) == 0 && bitmap[0] == 0);
+
+    // 稀疏区域：第100页
+    CHECK(device_memory_write64(mem, 0x100000 + 100 * DEVICE_MEMORY_PAGE_SIZE, 1) == 0);
+    CHECK(device_memory_fetch_clear_dirty(mem, 1, bitmap, 1) == -1);   // 缓冲区过小
+    CHECK(device_memory_fetch_clear_dirty(mem, 1, bitmap, 2) == 1);
+    CHECK(bitmap[0] == 0 && bitmap[1] == (1ULL << 36));
+
+    // 恢复快照修改的页同样标记为脏页
+    device_memory_snapshot_t* snap = device_memory_snapshot(mem);
+    CHECK(snap != NULL);
+    CHECK(device_memory_write(mem, 0x2000, 3) == 0);
+    CHECK(device_memory_fetch_clear_dirty(mem, 0, NULL, 0) == 1);
+    CHECK(device_memory_restore(mem, snap) == 0);
+    CHECK(device_memory_fetch_clear_dirty(mem, 0, bitmap, 1) == 1 && bitmap[0] == 0x04);
+    device_memory_snapshot_destroy(snap);
+
+    device_memory_destroy(mem);
+}
+
+// 测试单slab布局
+static void test_slab_layout(void) {
+    printf("测试单slab布局...\n");
+    device_memory_t* mem = device_memory_create(fpga_like_regions, 3, NULL, 0, 0);
+    CHECK(mem != NULL);
+    if (!mem) return;
+
+    uint8_t* begin = (uint8_t*)mem;
+    uint8_t* end = begin + mem->slab_size;
+    CHECK((uintptr_t)mem % DEVICE_MEMORY_SLAB_ALIGN == 0);
+    CHECK((uint8_t*)mem->regions > begin && (uint8_t*)mem->regions < end);
+    CHECK((uint8_t*)mem->spans > begin && (uint8_t*)mem->spans < end);
+    CHECK((uint8_t*)mem->page_table > begin && (uint8_t*)mem->page_table < end);
+
+    // 区域数据位于slab中，按缓存行对齐且按基地址顺序排列
+    for (int i = 0; i < mem->region_count; i++) {
+        const memory_region_t* region = &mem->regions[i];
+        CHECK(region->data > begin && region->data + region->unit_size * region->length <= end);
+        CHECK((uintptr_t)region->data % DEVICE_MEMORY_SLAB_ALIGN == 0);
+        if (i > 0) {
+            CHECK(region->data > mem->regions[i - 1].data);
+        }
+    }
+
+    // 寄存器区域与配置区数据相邻
+    const memory_region_t* regs = &mem->regions[0];
+    CHECK(mem->regions[1].data == regs->data + regs->unit_size * regs->length);
+
+    device_memory_destroy(mem);
+}
+
+// 测试memfd导出
+static void test_memfd_export(void) {
+    printf("测试memfd导出...\n");
+    const memory_region_t regions[] = {
+        { .base_addr = 0x1000,  .unit_size = 4, .length = 0x400 },
+        { .base_addr = 0x00,    .unit_size = 4, .length = 16, .flags = MEMORY_REGION_LOCKFREE },
+        { .base_addr = 0x10000, .unit_size = 4, .length = 0x4000, .flags = MEMORY_REGION_SPARSE },
+    };
+    device_memory_t* mem = device_memory_create(regions, 3, NULL, DEVICE_TYPE_I2C_BUS, 0);
+    CHECK(mem != NULL);
+    if (!mem) return;
+
+    CHECK(device_memory_write(mem, 0x04, 0xCAFEF00D) == 0);
+    CHECK(device_memory_write(mem, 0x1010, 0x12345678) == 0);
+
+    // 稀疏区域不导出；导出前写入的数据迁移到memfd中
+    device_memory_export_region_t layout[4];
+    int count = 0;
+    int fd = device_memory_export(mem, layout, 4, &count);
+    CHECK(fd >= 0 && count == 2);
+    if (fd < 0 || count != 2) {
+        device_memory_destroy(mem);
+        return;
+    }
+    long page_size = sysconf(_SC_PAGESIZE);
+    CHECK(layout[0].base_addr == 0x00 && layout[0].size == 64 && layout[0].offset == 0);
+    CHECK(layout[1].base_addr == 0x1000 && layout[1].size == 0x1000 && 
+          layout[1].offset % page_size == 0 && layout[1].offset > 0);
+    CHECK(layout[0].flags & MEMORY_REGION_LOCKFREE);
+
+    // 模拟监控进程：只读映射数据区，之后的写入无需复制即可看到
+    const uint32_t* view = (const uint32_t*)mmap(NULL, layout[1].size, PROT_READ, MAP_SHARED, 
+                                                 fd, (off_t)layout[1].offset);
+    CHECK(view != MAP_FAILED);
+    if (view != MAP_FAILED) {
+        CHECK(view[0x10 / 4] == 0x12345678);
+        CHECK(device_memory_write(mem, 0x1020, 0xA5A5A5A5) == 0);
+        CHECK(view[0x20 / 4] == 0xA5A5A5A5);
+        munmap((void*)view, layout[1].size);
+    }
+    uint32_t value = 0;
+    CHECK(device_memory_atomic_load32(mem, 0x04, &value) == 0 && value == 0xCAFEF00D);
+
+    // 大小已封住，消费者不能截断memfd
+    CHECK(ftruncate(fd, 0) != 0);
+#ifdef F_SEAL_FUTURE_WRITE
+    CHECK(mmap(NULL, layout[1].size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, (off_t)layout[1].offset) == MAP_FAILED);
+#endif
+
+    // 再次导出返回同一个memfd
+    CHECK(device_memory_export(mem, NULL, 0, &count) == fd && count == 2);
+
+    device_memory_destroy(mem);
+    CHECK(fcntl(fd, F_GETFD) == -1);
+}
+
+// 测试触发字位图
+static void test_trigger_bitmap(void) {
+    printf("测试触发字位图...\n");
+    const memory_region_t regions[] = {
+        { .base_addr = 0x1000, .unit_size = 4, .length = 0x400 },
+        { .base_addr = 0x00,   .unit_size = 4, .length = 16 },
+    };
+    device_memory_t* mem = device_memory_create(regions, 2, NULL, DEVICE_TYPE_FLASH, 0);
+    CHECK(mem != NULL);
+    if (!mem) return;
+
+    memory_region_t* regs = device_memory_find_region(mem, 0x00);
+    memory_region_t* data = device_memory_find_region(mem, 0x1000);
+    CHECK(regs && data);
+    if (!regs || !data) {
+        device_memory_destroy(mem);
+        return;
+    }
+
+    // 每条规则的触发字都在位图中，没有触发地址的数据区不分配位图
+    int rule_count = 0;
+    const rule_table_entry_t* rules = get_device_rules(DEVICE_TYPE_FLASH, &rule_count);
+    CHECK(rules != NULL && rule_count > 0);
+    uint64_t expected = 0;
+    for (int i = 0; i < rule_count; i++) {
+        uint32_t word = rules[i].trigger.trigger_addr / 4;
+        if (word < 16) expected |= 1ULL << word;
+    }
+    CHECK(regs->triggers != NULL && regs->triggers[0] == expected);
+    CHECK(data->triggers == NULL);
+
+    // 重建后结果不变
+    CHECK(device_memory_rebuild_triggers(mem) == 0);
+    CHECK(regs->triggers != NULL && regs->triggers[0] == expected);
+    CHECK(data->triggers == NULL);
+
+    device_memory_destroy(mem);
+}
+
+// 测试按触发字索引的规则查找
+static void test_rule_index(void) {
+    printf("测试规则索引...\n");
+    rule_index_t* index = rule_index_create();
+    CHECK(index != NULL);
+    if (!index) return;
+
+    const int* positions = NULL;
+    CHECK(rule_index_add(index, DEVICE_TYPE_FPGA, 0x08, 0) == 0);
+    CHECK(rule_index_add(index, DEVICE_TYPE_FPGA, 0x0A, 1) == 0);   // 未对齐，跨越0x08和0x0C两个字
+    CHECK(rule_index_add(index, DEVICE_TYPE_FLASH, 0x08, 2) == 0);
+    CHECK(rule_index_lookup(index, DEVICE_TYPE_FPGA, 0x0B, &positions) == 2 && 
+          positions[0] == 0 && positions[1] == 1);
+    CHECK(rule_index_lookup(index, DEVICE_TYPE_FPGA, 0x0C, &positions) == 1 && positions[0] == 1);
+    CHECK(rule_index_lookup(index, DEVICE_TYPE_FLASH, 0x08, &positions) == 1 && positions[0] == 2);
+    CHECK(rule_index_lookup(index, DEVICE_TYPE_FPGA, 0x10, &positions) == 0);
+    rule_index_destroy(index);
+
+    // 动作管理器的索引随规则增删重建
+    action_manager_t* am = action_manager_create();
+    CHECK(am != NULL);
+    if (!am) return;
+
+    rule_table_entry_t table[3];
+    memset(table, 0, sizeof(table));
+    table[0].trigger = rule_trigger_create(0x04, 1, 1);
+    table[0].device_type = DEVICE_TYPE_FPGA;
+    table[1].trigger = rule_trigger_create(0x04, 2, 2);
+    table[1].device_type = DEVICE_TYPE_FLASH;
+    table[2].trigger = rule_trigger_create(0x104, 1, 1);
+    table[2].device_type = DEVICE_TYPE_FPGA;
+    CHECK(action_manager_add_rules_from_table(am, table, 3) == 0);
+
+    int token = action_manager_read_begin(am);
+    const action_rule_table_t* rules = action_manager_rules(am);
+    int removed = rules->rules[0].rule_id;
+    int moved = rules->rules[2].rule_id;
+    action_manager_read_end(am, token);
+
+    int ids[4];
+    CHECK(action_manager_find_rules(am, DEVICE_TYPE_FPGA, 0x04, ids, 4) == 1 && ids[0] == removed);
+    CHECK(action_manager_find_rules(am, DEVICE_TYPE_FPGA, 0x106, ids, 4) == 1 && ids[0] == moved);
+    CHECK(action_manager_find_rules(am, DEVICE_TYPE_FLASH, 0x104, ids, 4) == 0);
+
+    action_manager_remove_rule(am, removed);
+    CHECK(action_manager_find_rules(am, DEVICE_TYPE_FPGA, 0x04, ids, 4) == 0);
+    CHECK(action_manager_find_rules(am, DEVICE_TYPE_FPGA, 0x104, ids, 4) == 1 && ids[0] == moved);
+
+    action_rule_t rule;
+    memset(&rule, 0, sizeof(rule));
+    rule.rule_id = 1000;
+    rule.trigger = rule_trigger_create(0x104, 4, 4);
+    rule.device_type = DEVICE_TYPE_FPGA;
+    CHECK(action_manager_add_rule(am, &rule) == 0);
+    CHECK(action_manager_find_rules(am, DEVICE_TYPE_FPGA, 0x104, ids, 4) == 2 && ids[0] == moved && ids[1] == 1000);
+
+    action_manager_destroy(am);
+}
+
+#define RULE_SWAP_READERS  2
+#define RULE_SWAP_ROUNDS   300
+
+static volatile int g_rule_swap_done = 0;
+static int g_rule_swap_torn = 0;
+
+// 读者：同一快照内的规则必须属于同一个规则集（规则数等于每条规则的priority）
+static void* rule_swap_reader_thread(void* arg) {
+    action_manager_t* am = (action_manager_t*)arg;
+    while (!__atomic_load_n(&g_rule_swap_done, __ATOMIC_ACQUIRE)) {
+        int token = action_manager_read_begin(am);
+        const action_rule_table_t* table = action_manager_rules(am);
+        const int* positions = NULL;
+        int count = rule_index_lookup(table->index, DEVICE_TYPE_FPGA, 0x20, &positions);
+        if (count != table->rule_count) {
+            __atomic_add_fetch(&g_rule_swap_torn, 1, __ATOMIC_RELAXED);
+        }
+        for (int i = 0; i < count; i++) {
+            if (table->rules[positions[i]].priority != table->rule_count) {
+                __atomic_add_fetch(&g_rule_swap_torn, 1, __ATOMIC_RELAXED);
+            }
+        }
+        action_manager_read_end(am, token);
+    }
+    return NULL;
+}
+
+// 测试规则表替换：读者不加锁使用快照，旧快照在宽限期后才释放
+static void test_rule_table_swap(void) {
+    printf("测试规则表替换...\n");
+    action_manager_t* am = action_manager_create();
+    CHECK(am != NULL);
+    if (!am) return;
+
+    action_rule_t rules[4];
+    memset(rules, 0, sizeof(rules));
+    for (int i = 0; i < 4; i++) {
+        rules[i].rule_id = 100 + i;
+        rules[i].name = "规则替换测试";
+        rules[i].trigger = rule_trigger_create(0x20, 1, 1);
+        rules[i].device_type = DEVICE_TYPE_FPGA;
+    }
+
+    int token = action_manager_read_begin(am);
+    const action_rule_table_t* before = action_manager_rules(am);
+    uint64_t version = before->version;
+    CHECK(before->rule_count == 0);
+    // 读侧临界区内不能更新规则，否则会等待自己
+    CHECK(action_manager_replace_rules(am, rules, 1) == -1);
+    action_manager_read_end(am, token);
+
+    rules[0].priority = 1;
+    CHECK(action_manager_replace_rules(am, rules, 1) == 0);
+    token = action_manager_read_begin(am);
+    CHECK(action_manager_rules(am)->version == version + 1);
+    CHECK(action_manager_rules(am)->rule_count == 1);
+    action_manager_read_end(am, token);
+
+    g_rule_swap_done = 0;
+    g_rule_swap_torn = 0;
+    pthread_t readers[RULE_SWAP_READERS];
+    for (int i = 0; i < RULE_SWAP_READERS; i++) {
+        pthread_create(&readers[i], NULL, rule_swap_reader_thread, am);
+    }
+    for (int round = 0; round < RULE_SWAP_ROUNDS; round++) {
+        int count = round % 4 + 1;
+        for (int i = 0; i < count; i++) {
+            rules[i].priority = count;
+        }
+        if (action_manager_replace_rules(am, rules, count) != 0) {
+            g_rule_swap_torn++;
+        }
+    }
+    __atomic_store_n(&g_rule_swap_done, 1, __ATOMIC_RELEASE);
+    for (int i = 0; i < RULE_SWAP_READERS; i++) {
+        pthread_join(readers[i], NULL);
+    }
+    CHECK(g_rule_swap_torn == 0);
+    CHECK(am->grace_periods >= RULE_SWAP_ROUNDS);
+
+    int ids[4];
+    CHECK(action_manager_find_rules(am, DEVICE_TYPE_FPGA, 0x20, ids, 4) == (RULE_SWAP_ROUNDS - 1) % 4 + 1);
+    CHECK(ids[0] == 100);
+    action_manager_remove_rule(am, 100);
+    CHECK(action_manager_find_rules(am, DEVICE_TYPE_FPGA, 0x20, ids, 4) == (RULE_SWAP_ROUNDS - 1) % 4);
+    CHECK(action_manager_replace_rules(am, NULL, 0) == 0);
+    CHECK(action_manager_find_rules(am, DEVICE_TYPE_FPGA, 0x20, ids, 4) == 0);
+
+    action_manager_destroy(am);
+}
+
+// 记录测试设备收到的写入
+static uint32_t g_deferred_writes[8];
+static int g_deferred_write_count = 0;
+static action_rule_t g_cascade_rule;
+
+// 测试设备写入：写0x10时再匹配一条级联规则
+static int deferred_test_write(device_instance_t* instance, uint32_t addr, uint32_t value) {
+    (void)instance;
+    (void)value;
+    action_manager_defer_begin();
+    if (g_deferred_write_count < 8) {
+        g_deferred_writes[g_deferred_write_count++] = addr;
+    }
+    if (addr == 0x10) {
+        action_manager_submit_rule(action_manager_get_instance(), &g_cascade_rule, device_manager_get_instance());
+    }
+    action_manager_defer_end();
+    return 0;
+}
+
+// 构造写测试设备的规则
+static void deferred_test_rule(action_rule_t* rule, const uint32_t* addrs, int count) {
+    memset(rule, 0, sizeof(*rule));
+    rule->name = "deferred_test";
+    for (int i = 0; i < count; i++) {
+        action_target_t target;
+        memset(&target, 0, sizeof(target));
+        target.type = ACTION_TYPE_WRITE;
+        target.device_type = DEVICE_TYPE_I2C_BUS;
+        target.device_id = 1;
+        target.target_addr = addrs[i];
+        action_target_add_to_array(&rule->targets, &target);
+    }
+}
+
+// 测试延迟执行规则
+static void test_deferred_rules(void) {
+    printf("测试延迟执行规则...\n");
+    device_manager_t* dm = device_manager_get_instance();
+    action_manager_t* am = action_manager_get_instance();
+    CHECK(dm != NULL && am != NULL);
+    if (!dm || !am) return;
+
+    device_ops_t ops;
+    memset(&ops, 0, sizeof(ops));
+    ops.write = deferred_test_write;
+    CHECK(device_type_register(dm, DEVICE_TYPE_I2C_BUS, "DEFER_TEST", &ops) == 0);
+    CHECK(device_create(dm, DEVICE_TYPE_I2C_BUS, 1) != NULL);
+
+    action_rule_t first, second;
+    const uint32_t first_addrs[] = { 0x10, 0x14 };
+    const uint32_t second_addrs[] = { 0x18 };
+    const uint32_t cascade_addrs[] = { 0x20 };
+    deferred_test_rule(&first, first_addrs, 2);
+    deferred_test_rule(&second, second_addrs, 1);
+    deferred_test_rule(&g_cascade_rule, cascade_addrs, 1);
+
+    // 延迟期间只入队；最外层结束时按匹配顺序执行，级联规则排在已匹配的规则之后
+    g_deferred_write_count = 0;
+    action_manager_defer_begin();
+    action_manager_defer_begin();
+    CHECK(action_manager_submit_rule(am, &first, dm) == 0);
+    action_manager_defer_end();
+    CHECK(action_manager_submit_rule(am, &second, dm) == 0);
+    CHECK(g_deferred_write_count == 0);
+    action_manager_defer_end();
+    CHECK(g_deferred_write_count == 4);
+    CHECK(g_deferred_writes[0] == 0x10 && g_deferred_writes[1] == 0x14 && 
+          g_deferred_writes[2] == 0x18 && g_deferred_writes[3] == 0x20);
+
+    // 没有延迟时立即执行
+    g_deferred_write_count = 0;
+    action_manager_submit_rule(am, &second, dm);
+    CHECK(g_deferred_write_count == 1 && g_deferred_writes[0] == 0x18);
+
+    device_destroy(dm, DEVICE_TYPE_I2C_BUS, 1);
+}
+
+#define CASCADE_TEST_LENGTH  2000
+
+// 级联测试设备：chain模式下每次写入匹配一条写下一个地址的规则，否则0x30与0x34互相触发
+static int g_cascade_chain = 0;
+static int g_cascade_write_count = 0;
+
+// 构造触发地址为trigger_addr、写测试设备target_addr的规则
+static void cascade_test_rule(action_rule_t* rule, uint32_t trigger_addr, uint32_t target_addr) {
+    memset(rule, 0, sizeof(*rule));
+    rule->name = "cascade_test";
+    rule->device_type = DEVICE_TYPE_I2C_BUS;
+    rule->device_id = 1;
+    rule->trigger = rule_trigger_create(trigger_addr, 0, 0);
+    action_target_t target = { ACTION_TYPE_WRITE, DEVICE_TYPE_I2C_BUS, 1, target_addr, 0, 0, NULL, NULL, NULL };
+    action_target_add_to_array(&rule->targets, &target);
+}
+
+static int cascade_test_write(device_instance_t* instance, uint32_t addr, uint32_t value) {
+    (void)instance;
+    (void)value;
+    g_cascade_write_count++;
+    action_rule_t next;
+    if (g_cascade_chain) {
+        cascade_test_rule(&next, addr, addr + 4);
+    } else {
+        cascade_test_rule(&next, addr, addr == 0x30 ? 0x34 : 0x30);
+    }
+    action_manager_submit_rule(action_manager_get_instance(), &next, device_manager_get_instance());
+    return 0;
+}
+
+// 测试规则级联的深度上限与循环检测
+static void test_rule_cascade(void) {
+    printf("测试规则级联...\n");
+    device_manager_t* dm = device_manager_get_instance();
+    action_manager_t* am = action_manager_get_instance();
+    CHECK(dm != NULL && am != NULL);
+    if (!dm || !am) return;
+
+    device_ops_t ops;
+    memset(&ops, 0, sizeof(ops));
+    ops.write = cascade_test_write;
+    CHECK(device_type_register(dm, DEVICE_TYPE_I2C_BUS, "CASCADE_TEST", &ops) == 0);
+    CHECK(device_create(dm, DEVICE_TYPE_I2C_BUS, 1) != NULL);
+
+    action_cascade_stats_t before, after;
+    action_rule_t root;
+
+    // 0x30 -> 0x34 -> 0x30 构成循环，第二次匹配同一规则时截断
+    action_manager_get_cascade_stats(&before);
+    g_cascade_chain = 0;
+    g_cascade_write_count = 0;
+    cascade_test_rule(&root, 0x34, 0x30);
+    CHECK(action_manager_submit_rule(am, &root, dm) == 0);
+    action_manager_get_cascade_stats(&after);
+    CHECK(g_cascade_write_count == 2);
+    CHECK(after.cycle_truncated == before.cycle_truncated + 1);
+
+    // 无限长的链在深度上限处截断
+    CHECK(action_manager_set_cascade_limit(5) == 0);
+    g_cascade_chain = 1;
+    g_cascade_write_count = 0;
+    cascade_test_rule(&root, 0, 0x100);
+    CHECK(action_manager_submit_rule(am, &root, dm) == 0);
+    action_manager_get_cascade_stats(&after);
+    CHECK(g_cascade_write_count == 6);
+    CHECK(after.depth_truncated == before.depth_truncated + 1);
+
+    // 很长的级联在队列中迭代执行，栈深度不随级联长度增长
+    CHECK(action_manager_set_cascade_limit(CASCADE_TEST_LENGTH) == 0);
+    g_cascade_write_count = 0;
+    CHECK(action_manager_submit_rule(am, &root, dm) == 0);
+    action_manager_get_cascade_stats(&after);
+    CHECK(g_cascade_write_count == CASCADE_TEST_LENGTH + 1);
+    CHECK(after.max_depth >= CASCADE_TEST_LENGTH);
+
+    CHECK(action_manager_set_cascade_limit(-1) == -1);
+    action_manager_set_cascade_limit(ACTION_CASCADE_DEFAULT_MAX_DEPTH);
+    device_destroy(dm, DEVICE_TYPE_I2C_BUS, 1);
+}
+
+// 记录绑定测试设备最近一次收到写入的实例
+static device_instance_t* g_binding_last_write = NULL;
+
+static int binding_test_write(device_instance_t* instance, uint32_t addr, uint32_t value) {
+    (void)addr;
+    (void)value;
+    g_binding_last_write = instance;
+    return 0;
+}
+
+// 测试目标绑定：首次执行时绑定，之后不再查找，拓扑变化后重新解析
+static void test_target_binding(void) {
+    printf("测试目标绑定...\n");
+    device_manager_t* dm = device_manager_get_instance();
+    action_manager_t* am = action_manager_get_instance();
+    CHECK(dm != NULL && am != NULL);
+    if (!dm || !am) return;
+
+    device_ops_t ops;
+    memset(&ops, 0, sizeof(ops));
+    ops.write = binding_test_write;
+    CHECK(device_type_register(dm, DEVICE_TYPE_I2C_BUS, "BINDING_TEST", &ops) == 0);
+    device_instance_t* first = device_create(dm, DEVICE_TYPE_I2C_BUS, 1);
+    device_instance_t* second = device_create(dm, DEVICE_TYPE_I2C_BUS, 2);
+    CHECK(first != NULL && second != NULL);
+
+    action_binding_t binding = { NULL, 0 };
+    action_rule_t rule;
+    memset(&rule, 0, sizeof(rule));
+    action_target_t target = { ACTION_TYPE_WRITE, DEVICE_TYPE_I2C_BUS, 1, 0x40, 0, 0, NULL, NULL, &binding };
+    action_target_add_to_array(&rule.targets, &target);
+
+    CHECK(action_manager_execute_rule(am, &rule, dm) == 0);
+    CHECK(g_binding_last_write == first && binding.device == first);
+    CHECK(binding.generation == device_manager_topology_generation(dm));
+
+    // 绑定有效时直接使用绑定的实例，不按类型和ID查找
+    binding.device = second;
+    CHECK(action_manager_execute_rule(am, &rule, dm) == 0);
+    CHECK(g_binding_last_write == second);
+
+    // 销毁设备使绑定失效，重新解析到目标设备
+    device_destroy(dm, DEVICE_TYPE_I2C_BUS, 2);
+    CHECK(binding.generation != device_manager_topology_generation(dm));
+    CHECK(action_manager_execute_rule(am, &rule, dm) == 0);
+    CHECK(g_binding_last_write == first && binding.device == first);
+    CHECK(binding.generation == device_manager_topology_generation(dm));
+
+    // 重新创建目标设备后绑定到新实例
+    device_destroy(dm, DEVICE_TYPE_I2C_BUS, 1);
+    first = device_create(dm, DEVICE_TYPE_I2C_BUS, 1);
+    CHECK(action_manager_execute_rule(am, &rule, dm) == 0);
+    CHECK(g_binding_last_write == first && binding.device == first);
+
+    device_destroy(dm, DEVICE_TYPE_I2C_BUS, 1);
+}
+
+// 测试目标池：相同的目标序列只存一份，规则触发按引用执行目标动作
+static void test_target_pool(void) {
+    printf("测试目标池...\n");
+    device_manager_t* dm = device_manager_get_instance();
+    action_manager_t* am = action_manager_get_instance();
+    CHECK(dm != NULL && am != NULL);
+    if (!dm || !am) return;
+
+    action_memory_report_t before;
+    action_manager_get_memory_report(&before);
+    CHECK(before.compact_rule_bytes < before.embedded_rule_bytes);
+
+    // 目标未指定设备，执行时继承触发设备
+    action_target_array_t targets;
+    memset(&targets, 0, sizeof(targets));
+    action_target_t target = { ACTION_TYPE_WRITE, 0, 0, 0x44, 0x5A, 0, NULL, NULL, NULL };
+    action_target_add_to_array(&targets, &target);
+    target.target_addr = 0x48;
+    action_target_add_to_array(&targets, &target);
+
+    action_target_ref_t first, second, other;
+    CHECK(action_target_pool_intern(targets.targets, targets.count, &first) == 0 && first.count == 2);
+    CHECK(action_target_pool_intern(targets.targets, targets.count, &second) == 0);
+    CHECK(first.offset == second.offset && first.count == second.count);
+    CHECK(action_target_pool_intern(targets.targets, 1, &other) == 0 && other.count == 1);
+    CHECK(other.offset != first.offset);
+
+    const action_target_t* pooled = action_target_pool_get(first);
+    CHECK(pooled != NULL && memcmp(pooled, targets.targets, 2 * sizeof(action_target_t)) == 0);
+    CHECK(action_target_pool_intern(NULL, 0, &other) == 0 && action_target_pool_get(other) == NULL);
+
+    action_memory_report_t after;
+    action_manager_get_memory_report(&after);
+    CHECK(after.interned == before.interned + 3);
+    CHECK(after.deduplicated == before.deduplicated + 1);
+
+    // 规则表项只保存引用
+    rule_table_entry_t* entry = rule_table_entry_create("目标池测试", rule_trigger_create(0x40, 1, 1), &targets, 1);
+    CHECK(entry != NULL);
+    if (entry) {
+        CHECK(entry->targets.offset == first.offset && entry->targets.count == 2);
+        rule_table_entry_destroy(entry);
+    }
+    CHECK(action_target_pool_get(first) == pooled);
+
+    device_ops_t ops;
+    memset(&ops, 0, sizeof(ops));
+    ops.write = binding_test_write;
+    CHECK(device_type_register(dm, DEVICE_TYPE_I2C_BUS, "BINDING_TEST", &ops) == 0);
+    device_instance_t* device = device_create(dm, DEVICE_TYPE_I2C_BUS, 3);
+    CHECK(device != NULL);
+
+    action_binding_t bindings[2];
+    memset(bindings, 0, sizeof(bindings));
+    action_firing_t firing;
+    memset(&firing, 0, sizeof(firing));
+    firing.name = "目标池测试";
+    firing.device_type = DEVICE_TYPE_I2C_BUS;
+    firing.device_id = 3;
+    firing.targets = pooled;
+    firing.target_count = 2;
+    firing.bindings = bindings;
+    firing.inherit_device = 1;
+
+    g_binding_last_write = NULL;
+    CHECK(action_manager_submit_firing(am, &firing, dm) == 0);
+    CHECK(g_binding_last_write == device);
+    CHECK(bindings[0].device == device && bindings[1].device == device);
+    // 池中的目标动作保持不变
+    CHECK(memcmp(pooled, targets.targets, 2 * sizeof(action_target_t)) == 0);
+
+    action_manager_print_memory_report();
+    device_destroy(dm, DEVICE_TYPE_I2C_BUS, 3);
+}
+
+// 规则触发次数（每次触发都是一次新的级联）
+static uint64_t rule_firings(void) {
+    action_cascade_stats_t stats;
+    action_manager_get_cascade_stats(&stats);
+    return stats.cascades;
+}
+
+// 测试边沿/变化触发：重复写入相同的值不再重复触发
+static void test_trigger_modes(void) {
+    printf("测试规则触发方式...\n");
+    int rule_count = 0;
+    rule_table_entry_t* rules = (rule_table_entry_t*)get_device_rules(DEVICE_TYPE_FLASH, &rule_count);
+    CHECK(rules != NULL && rule_count > 0 && rules[0].trigger.trigger_addr == 0);
+    if (!rules || rule_count <= 0 || rules[0].trigger.trigger_addr != 0) return;
+    uint32_t expected = rules[0].trigger.expected_value;
+    uint32_t mask = rules[0].trigger.expected_mask;
+
+    // 建立设备内存时以当前内容（0）作为初始值
+    rules[0].trigger.mode = RULE_TRIGGER_RISING;
+    const memory_region_t regions[] = { { .base_addr = 0x00, .unit_size = 4, .length = 16 } };
+    device_memory_t* mem = device_memory_create(regions, 1, NULL, DEVICE_TYPE_FLASH, 77);
+    CHECK(mem != NULL);
+    if (!mem) {
+        rules[0].trigger.mode = RULE_TRIGGER_LEVEL;
+        return;
+    }
+
+    uint64_t fired = rule_firings();
+    CHECK(device_memory_write(mem, 0x00, expected) == 0);
+    CHECK(rule_firings() == fired + 1);
+    CHECK(device_memory_write(mem, 0x00, expected) == 0);
+    CHECK(device_memory_write(mem, 0x00, expected | ~mask) == 0);   // 掩码外的位变化
+    CHECK(rule_firings() == fired + 1);
+    CHECK(device_memory_write(mem, 0x00, ~expected & mask) == 0);   // 离开匹配
+    CHECK(rule_firings() == fired + 1);
+    CHECK(device_memory_write(mem, 0x00, expected) == 0);           // 再次进入匹配
+    CHECK(rule_firings() == fired + 2);
+
+    // 变化触发不要求匹配，只比较掩码值
+    rules[0].trigger.mode = RULE_TRIGGER_CHANGE;
+    CHECK(device_memory_write(mem, 0x00, expected) == 0);
+    CHECK(rule_firings() == fired + 2);
+    CHECK(device_memory_write(mem, 0x00, expected ^ 1) == 0);
+    CHECK(rule_firings() == fired + 3);
+    CHECK(device_memory_write(mem, 0x00, (expected ^ 1) | ~mask) == 0);
+    CHECK(rule_firings() == fired + 3);
+    CHECK(device_memory_write16(mem, 0x00, (uint16_t)expected) == 0);        // 窄写入改变触发字
+    CHECK(rule_firings() == fired + 4);
+
+    // 电平触发：每次匹配的写入都触发
+    rules[0].trigger.mode = RULE_TRIGGER_LEVEL;
+    CHECK(device_memory_write(mem, 0x00, expected) == 0);
+    CHECK(device_memory_write(mem, 0x00, expected) == 0);
+    CHECK(rule_firings() == fired + 6);
+
+    device_memory_destroy(mem);
+}
+
+// 规则合并测试使用的虚拟时间（微秒）
+static uint64_t g_virtual_now = 0;
+
+static uint64_t virtual_clock(void) {
+    return g_virtual_now;
+}
+
+// 测试规则触发合并：按次数或时间窗口限制执行，被合并的触发以最后的值补发
+static void test_rule_coalescing(void) {
+    printf("测试规则触发合并...\n");
+    int rule_count = 0;
+    const rule_table_entry_t* rules = get_device_rules(DEVICE_TYPE_FLASH, &rule_count);
+    CHECK(rules != NULL && rule_count > 0 && rules[0].trigger.trigger_addr == 0);
+    if (!rules || rule_count <= 0 || rules[0].trigger.trigger_addr != 0) return;
+    uint32_t expected = rules[0].trigger.expected_value;
+    uint32_t mask = rules[0].trigger.expected_mask;
+
+    const memory_region_t regions[] = { { .base_addr = 0x00, .unit_size = 4, .length = 16 } };
+    device_memory_t* mem = device_memory_create(regions, 1, NULL, DEVICE_TYPE_FLASH, 78);
+    CHECK(mem != NULL);
+    if (!mem) return;
+    g_virtual_now = 0;
+    device_memory_set_clock(virtual_clock);
+
+    // 每4次触发最多执行一次：第1、5、9次执行
+    CHECK(set_device_rule_coalescing(DEVICE_TYPE_FLASH, 0x00, 4, 0) == 1);
+    CHECK(set_device_rule_coalescing(DEVICE_TYPE_FLASH, 0x1234, 4, 0) == 0);
+    uint64_t fired = rule_firings();
+    for (int i = 0; i < 10; i++) {
+        CHECK(device_memory_write(mem, 0x00, expected) == 0);
+    }
+    CHECK(rule_firings() == fired + 3);
+    device_memory_coalesce_stats_t stats;
+    CHECK(device_memory_coalesce_stats(mem, &stats) == 0);
+    CHECK(stats.fired == 3 && stats.suppressed == 7 && stats.pending == 1);
+    // 最后一次被合并的触发补发一次
+    CHECK(device_memory_flush_coalesced(mem, 0) == 1);
+    CHECK(rule_firings() == fired + 4);
+    CHECK(device_memory_flush_coalesced(mem, 0) == 0);
+
+    // 每1000微秒最多执行一次
+    CHECK(set_device_rule_coalescing(DEVICE_TYPE_FLASH, 0x00, 0, 1000) == 1);
+    g_virtual_now = 5000;
+    CHECK(device_memory_write(mem, 0x00, expected) == 0);
+    CHECK(rule_firings() == fired + 5);
+    g_virtual_now = 5500;
+    CHECK(device_memory_write(mem, 0x00, expected) == 0);
+    CHECK(device_memory_write(mem, 0x00, expected) == 0);
+    CHECK(device_memory_flush_coalesced(mem, 0) == 0);       // 窗口未结束
+    CHECK(rule_firings() == fired + 5);
+    // 最后的值已不满足条件，窗口结束后不补发
+    CHECK(device_memory_write(mem, 0x00, ~expected & mask) == 0);
+    g_virtual_now = 6500;
+    CHECK(device_memory_flush_coalesced(mem, 0) == 0);
+    CHECK(rule_firings() == fired + 5);
+    g_virtual_now = 7000;
+    CHECK(device_memory_write(mem, 0x00, expected) == 0);
+    CHECK(rule_firings() == fired + 6);
+    CHECK(device_memory_write(mem, 0x00, expected) == 0);
+    CHECK(device_memory_flush_coalesced(mem, 1) == 1);       // 强制补发
+    CHECK(rule_firings() == fired + 7);
+
+    CHECK(device_memory_coalesce_stats(mem, &stats) == 0);
+    CHECK(stats.suppressed == 7 + 3 && stats.flushed == 2 && stats.pending == 0);
+
+    CHECK(set_device_rule_coalescing(DEVICE_TYPE_FLASH, 0x00, 0, 0) == 1);
+    device_memory_set_clock(NULL);
+    device_memory_destroy(mem);
+}
+
+#define RANGE_TEST_INTERVALS  1000
+
+// 测试区间树：嵌套、相邻区间以及与逐个比较的结果一致
+static void test_range_index(void) {
+    printf("测试范围规则索引...\n");
+    rule_range_index_t* index = rule_range_index_create();
+    CHECK(index != NULL);
+    if (!index) return;
+
+    int positions[RANGE_TEST_INTERVALS];
+    CHECK(rule_range_index_add(index, DEVICE_TYPE_FPGA, 0x100, 0x200, 0) == 0);
+    CHECK(rule_range_index_add(index, DEVICE_TYPE_FPGA, 0x140, 0x150, 1) == 0);   // 嵌套
+    CHECK(rule_range_index_add(index, DEVICE_TYPE_FPGA, 0x200, 0x210, 2) == 0);   // 相邻
+    CHECK(rule_range_index_add(index, DEVICE_TYPE_FLASH, 0x100, 0x200, 3) == 0);
+    CHECK(rule_range_index_add(index, DEVICE_TYPE_FPGA, 0x20, 0x10, 4) != 0);     // 空区间
+    // 建树之前查询不到
+    CHECK(rule_range_index_query(index, DEVICE_TYPE_FPGA, 0x144, 0x148, positions, 4) == 0);
+    CHECK(rule_range_index_build(index) == 0);
+    CHECK(rule_range_index_query(index, DEVICE_TYPE_FPGA, 0x144, 0x148, positions, 4) == 2 &&
+          positions[0] == 0 && positions[1] == 1);
+    CHECK(rule_range_index_query(index, DEVICE_TYPE_FPGA, 0x1FC, 0x200, positions, 4) == 1 && positions[0] == 0);
+    CHECK(rule_range_index_query(index, DEVICE_TYPE_FPGA, 0x200, 0x204, positions, 4) == 1 && positions[0] == 2);
+    CHECK(rule_range_index_query(index, DEVICE_TYPE_FPGA, 0x1FC, 0x204, positions, 1) == 2 && positions[0] == 0);
+    CHECK(rule_range_index_query(index, DEVICE_TYPE_FPGA, 0x210, 0x300, positions, 4) == 0);
+    CHECK(rule_range_index_query(index, DEVICE_TYPE_TEMP_SENSOR, 0x100, 0x200, positions, 4) == 0);
+    rule_range_index_destroy(index);
+
+    // 随机区间与逐个比较
+    index = rule_range_index_create();
+    CHECK(index != NULL);
+    if (!index) return;
+    static uint32_t starts[RANGE_TEST_INTERVALS];
+    static uint32_t ends[RANGE_TEST_INTERVALS];
+    uint32_t seed = 12345;
+    for (int i = 0; i < RANGE_TEST_INTERVALS; i++) {
+        seed = seed * 1103515245 + 12345;
+        starts[i] = (seed >> 8) % 0x10000;
+        seed = seed * 1103515245 + 12345;
+        ends[i] = starts[i] + 1 + (seed >> 8) % ((i % 10) ? 0x40 : 0x4000);
+        CHECK(rule_range_index_add(index, DEVICE_TYPE_FPGA, starts[i], ends[i], i) == 0);
+        // 前一半登记后先建一次树，再追加的区间在第二次建树时合并
+        if (i == RANGE_TEST_INTERVALS / 2) {
+            CHECK(rule_range_index_build(index) == 0);
+        }
+    }
+    CHECK(rule_range_index_build(index) == 0);
+    int mismatches = 0;
+    for (int q = 0; q < 200; q++) {
+        seed = seed * 1103515245 + 12345;
+        uint32_t start = (seed >> 8) % 0x10400;
+        uint32_t end = start + 1 + q % 0x100;
+        int expected = 0;
+        for (int i = 0; i < RANGE_TEST_INTERVALS; i++) {
+            if (starts[i] < end && ends[i] > start) expected++;
+        }
+        int count = rule_range_index_query(index, DEVICE_TYPE_FPGA, start, end, positions, RANGE_TEST_INTERVALS);
+        if (count != expected) mismatches++;
+        for (int i = 0; i < count && i < RANGE_TEST_INTERVALS; i++) {
+            int p = positions[i];
+            if (!(starts[p] < end && ends[p] > start) || (i > 0 && starts[positions[i - 1]] > starts[p])) {
+                mismatches++;
+            }
+        }
+    }
+    CHECK(mismatches == 0);
+    rule_range_index_destroy(index);
+}
+
+// 测试范围触发：写入与范围重叠且写入的字满足条件时触发一次
+static void test_range_triggers(void) {
+    printf("测试范围触发...\n");
+    int rule_count = 0;
+    const rule_table_entry_t* rules = get_device_rules(DEVICE_TYPE_FLASH, &rule_count);
+    CHECK(rules != NULL && rule_count > 0);
+    if (!rules || rule_count <= 0) return;
+
+    // 先创建设备内存：追加规则后不需要手动重建触发状态
+    const memory_region_t regions[] = { { .base_addr = 0x100, .unit_size = 4, .length = 16 } };
+    device_memory_t* mem = device_memory_create(regions, 1, NULL, DEVICE_TYPE_FLASH, 79);
+    CHECK(mem != NULL);
+    if (!mem) return;
+
+    // 复用第一条Flash规则的目标动作
+    action_target_array_t targets;
+    memset(&targets, 0, sizeof(targets));
+    action_target_add_to_array(&targets, action_target_pool_get(rules[0].targets));
+    uint64_t generation = device_rules_generation();
+    int position = add_device_rule(DEVICE_TYPE_FLASH, "Flash_Range_Rule",
+                                   rule_trigger_create_range(0x110, 0x120, 0xA5, 0xFF), &targets, 100);
+    CHECK(position >= 0);
+    CHECK(device_rules_generation() > generation);
+    if (position < 0) {
+        device_memory_destroy(mem);
+        return;
+    }
+
+    int found = 0;
+    CHECK(get_device_range_rules(DEVICE_TYPE_FLASH, 0x11C, 0x124, &position, 1, &found) != NULL && found == 1);
+    uint64_t fired = rule_firings();
+    CHECK(device_memory_write(mem, 0x10C, 0xA5) == 0);         // 范围之前
+    CHECK(device_memory_write(mem, 0x120, 0xA5) == 0);         // 范围结束地址不含
+    CHECK(rule_firings() == fired);
+    CHECK(device_memory_write(mem, 0x114, 0x12A5) == 0);
+    CHECK(rule_firings() == fired + 1);
+    CHECK(device_memory_write(mem, 0x118, 0x00) == 0);         // 只比较写入的字
+    CHECK(rule_firings() == fired + 1);
+    CHECK(device_memory_write_width(mem, 0x11C, 8, 0xA5) == 0); // 跨出范围的写入
+    CHECK(rule_firings() == fired + 2);
+    CHECK(device_memory_write16(mem, 0x110, 0x00A5) == 0);
+    CHECK(rule_firings() == fired + 3);
+
+    // 删除后已创建的设备内存不再触发，规则表恢复原样
+    generation = device_rules_generation();
+    CHECK(remove_device_rule(DEVICE_TYPE_FLASH, "Flash_Range_Rule") == 0);
+    CHECK(remove_device_rule(DEVICE_TYPE_FLASH, "Flash_Range_Rule") == -1);
+    CHECK(device_rules_generation() > generation);
+    CHECK(device_memory_write(mem, 0x114, 0xA5) == 0);
+    CHECK(rule_firings() == fired + 3);
+    CHECK(get_device_range_rules(DEVICE_TYPE_FLASH, 0x110, 0x120, &position, 1, &found) == NULL);
+    int count = 0;
+    get_device_rules(DEVICE_TYPE_FLASH, &count);
+    CHECK(count == rule_count);
+    device_memory_destroy(mem);
+}
+
+#define RULE_UPDATE_WRITERS  2
+#define RULE_UPDATE_RULES    12
+
+static int g_rule_update_done = 0;
+
+// 写者：不断写入被增删规则覆盖的地址，写入的值不满足规则条件
+static void* rule_update_writer_thread(void* arg) {
+    device_memory_t* mem = (device_memory_t*)arg;
+    uint32_t value = 0;
+    while (!__atomic_load_n(&g_rule_update_done, __ATOMIC_ACQUIRE)) {
+        device_memory_write(mem, 0x200 + (value % 16) * 4, value & 0xFF);
+        value++;
+    }
+    return NULL;
+}
+
+// 测试运行时增删规则：规则表容量不受限制，可以与写入并发
+static void test_rule_table_updates(void) {
+    printf("测试运行时增删规则...\n");
+    int rule_count = 0;
+    get_device_rules(DEVICE_TYPE_FPGA, &rule_count);
+
+    // 读侧临界区内不能修改规则表，否则会等待自己
+    int token = device_rules_read_begin();
+    CHECK(add_device_rule(DEVICE_TYPE_FPGA, "规则增删测试", rule_trigger_create(0x200, 0xDEAD, 0xFFFF), NULL, 0) == -1);
+    device_rules_read_end(token);
+    CHECK(add_device_rule(DEVICE_TYPE_OPTICAL_MODULE, "规则增删测试", rule_trigger_create(0x200, 0, 0), NULL, 0) == -1);
+
+    const memory_region_t regions[] = { { .base_addr = 0x200, .unit_size = 4, .length = 16 } };
+    device_memory_t* mem = device_memory_create(regions, 1, NULL, DEVICE_TYPE_FPGA, 80);
+    CHECK(mem != NULL);
+    if (!mem) return;
+
+    g_rule_update_done = 0;
+    uint64_t fired = rule_firings();
+    pthread_t writers[RULE_UPDATE_WRITERS];
+    for (int i = 0; i < RULE_UPDATE_WRITERS; i++) {
+        pthread_create(&writers[i], NULL, rule_update_writer_thread, mem);
+    }
+    char name[32];
+    for (int i = 0; i < RULE_UPDATE_RULES; i++) {
+        snprintf(name, sizeof(name), "规则增删测试_%d", i);
+        rule_trigger_t trigger = i % 2 ? rule_trigger_create(0x200 + i * 4, 0xDEAD, 0xFFFF)
+                                       : rule_trigger_create_range(0x200, 0x240, 0xDEAD, 0xFFFF);
+        CHECK(add_device_rule(DEVICE_TYPE_FPGA, name, trigger, NULL, 0) == rule_count + i);
+    }
+    for (int i = 0; i < RULE_UPDATE_RULES; i++) {
+        snprintf(name, sizeof(name), "规则增删测试_%d", i);
+        CHECK(remove_device_rule(DEVICE_TYPE_FPGA, name) == 0);
+    }
+    __atomic_store_n(&g_rule_update_done, 1, __ATOMIC_RELEASE);
+    for (int i = 0; i < RULE_UPDATE_WRITERS; i++) {
+        pthread_join(writers[i], NULL);
+    }
+    CHECK(rule_firings() == fired);
+
+    int count = 0;
+    get_device_rules(DEVICE_TYPE_FPGA, &count);
+    CHECK(count == rule_count);
+    device_memory_destroy(mem);
+}
+
+// 延迟销毁测试：延迟执行的线程与销毁设备内存的线程之间的同步
+static int g_defer_destroy_queued = 0;
+static int g_defer_destroy_started = 0;
+static int g_defer_destroy_done = 0;
+static int g_defer_destroy_blocked = 0;
+
+// 在延迟执行范围内写入触发规则，销毁开始后才结束延迟执行
+static void* defer_destroy_thread(void* arg) {
+    device_memory_t* mem = (device_memory_t*)arg;
+    action_manager_defer_begin();
+    device_memory_write(mem, 0x140, 0x5A);
+    __atomic_store_n(&g_defer_destroy_queued, 1, __ATOMIC_RELEASE);
+    while (!__atomic_load_n(&g_defer_destroy_started, __ATOMIC_ACQUIRE)) {
+        sched_yield();
+    }
+    usleep(20000);
+    g_defer_destroy_blocked = !__atomic_load_n(&g_defer_destroy_done, __ATOMIC_ACQUIRE);
+    // 待执行的触发使用规则状态中的绑定单元
+    action_manager_defer_end();
+    return NULL;
+}
+
+// 测试销毁设备内存时等待其他线程延迟执行的规则
+static void test_deferred_destroy(void) {
+    printf("测试延迟执行期间销毁设备内存...\n");
+    int rule_count = 0;
+    const rule_table_entry_t* rules = get_device_rules(DEVICE_TYPE_FLASH, &rule_count);
+    CHECK(rules != NULL && rule_count > 0);
+    if (!rules || rule_count <= 0) return;
+
+    action_target_array_t targets;
+    memset(&targets, 0, sizeof(targets));
+    action_target_add_to_array(&targets, action_target_pool_get(rules[0].targets));
+    CHECK(add_device_rule(DEVICE_TYPE_FLASH, "Flash_Defer_Destroy", rule_trigger_create(0x140, 0x5A, 0xFF),
+                          &targets, 100) >= 0);
+
+    const memory_region_t regions[] = { { .base_addr = 0x140, .unit_size = 4, .length = 4 } };
+    device_memory_t* mem = device_memory_create(regions, 1, NULL, DEVICE_TYPE_FLASH, 81);
+    CHECK(mem != NULL);
+    if (mem) {
+        uint64_t fired = rule_firings();
+        g_defer_destroy_queued = g_defer_destroy_started = g_defer_destroy_done = g_defer_destroy_blocked = 0;
+        pthread_t thread;
+        pthread_create(&thread, NULL, defer_destroy_thread, mem);
+        while (!__atomic_load_n(&g_defer_destroy_queued, __ATOMIC_ACQUIRE)) {
+            sched_yield();
+        }
+        // 销毁等到另一个线程的队列清空后才释放规则状态
+        __atomic_store_n(&g_defer_destroy_started, 1, __ATOMIC_RELEASE);
+        device_memory_destroy(mem);
+        __atomic_store_n(&g_defer_destroy_done, 1, __ATOMIC_RELEASE);
+        pthread_join(thread, NULL);
+        CHECK(g_defer_destroy_blocked);
+        CHECK(rule_firings() == fired + 1);
+    }
+
+    // 自己的队列非空时无法等待
+    action_manager_defer_begin();
+    CHECK(action_manager_defer_wait() == 0);
+    action_rule_t rule;
+    memset(&rule, 0, sizeof(rule));
+    CHECK(action_manager_submit_rule(action_manager_get_instance(), &rule, device_manager_get_instance()) == 0);
+    CHECK(action_manager_defer_wait() == -1);
+    action_manager_defer_end();
+    CHECK(action_manager_defer_wait() == 0);
+
+    CHECK(remove_device_rule(DEVICE_TYPE_FLASH, "Flash_Defer_Destroy") == 0);
+}
+
+#define ASYNC_TEST_DEVICES  4
+#define ASYNC_TEST_ROUNDS   200
+
+// 记录每个异步测试设备收到的写入顺序
+static uint32_t g_async_writes[ASYNC_TEST_DEVICES + 1][ASYNC_TEST_ROUNDS + 1];
+static int g_async_write_count[ASYNC_TEST_DEVICES + 1];
+static int g_async_concurrent[ASYNC_TEST_DEVICES + 1];
+static int g_async_overlap = 0;
+
+// 异步测试设备写入：写0x40时向同一设备级联一次0x44
+static int async_test_write(device_instance_t* instance, uint32_t addr, uint32_t value) {
+    int id = instance->dev_id;
+    if (__atomic_add_fetch(&g_async_concurrent[id], 1, __ATOMIC_ACQ_REL) != 1) {
+        __atomic_store_n(&g_async_overlap, 1, __ATOMIC_RELAXED);
+    }
+    if (g_async_write_count[id] <= ASYNC_TEST_ROUNDS) {
+        g_async_writes[id][g_async_write_count[id]++] = value;
+    }
+    __atomic_sub_fetch(&g_async_concurrent[id], 1, __ATOMIC_ACQ_REL);
+
+    if (addr == 0x40) {
+        action_rule_t cascade;
+        memset(&cascade, 0, sizeof(cascade));
+        action_target_t target = { ACTION_TYPE_WRITE, DEVICE_TYPE_OPTICAL_MODULE, id, 0x44, 0xFFFF, 0, NULL, NULL, NULL };
+        action_target_add_to_array(&cascade.targets, &target);
+        action_manager_execute_rule(action_manager_get_instance(), &cascade, device_manager_get_instance());
+    }
+    return 0;
+}
+
+// 异步测试设备销毁：提交一个按地址查找的动作并等待它完成，
+// 与 device_memory_destroy 等待工作线程的情形相同
+static int g_async_destroy_flushed = 0;
+
+static void async_test_destroy(device_instance_t* instance) {
+    (void)instance;
+    action_rule_t rule;
+    memset(&rule, 0, sizeof(rule));
+    action_target_t target = { ACTION_TYPE_WRITE, DEVICE_TYPE_OPTICAL_MODULE, 0, 0x20, 0, 0, NULL, NULL, NULL };
+    action_target_add_to_array(&rule.targets, &target);
+    action_manager_execute_rule(action_manager_get_instance(), &rule, device_manager_get_instance());
+    if (action_manager_flush(action_manager_get_instance()) == 0) {
+        g_async_destroy_flushed++;
+    }
+}
+
+// 测试异步分发目标处理动作
+static void test_async_dispatch(void) {
+    printf("测试异步分发目标处理动作...\n");
+    device_manager_t* dm = device_manager_get_instance();
+    action_manager_t* am = action_manager_get_instance();
+    CHECK(dm != NULL && am != NULL);
+    if (!dm || !am) return;
+
+    device_ops_t ops;
+    memset(&ops, 0, sizeof(ops));
+    ops.write = async_test_write;
+    ops.destroy = async_test_destroy;
+    CHECK(device_type_register(dm, DEVICE_TYPE_OPTICAL_MODULE, "ASYNC_TEST", &ops) == 0);
+    for (int id = 1; id <= ASYNC_TEST_DEVICES; id++) {
+        CHECK(device_create(dm, DEVICE_TYPE_OPTICAL_MODULE, id) != NULL);
+    }
+
+    memset(g_async_write_count, 0, sizeof(g_async_write_count));
+    CHECK(action_manager_flush(am) == 0);
+    CHECK(action_manager_start_async(am, 4) == 0);
+
+    // 每条规则写全部设备；最后一轮写0x40触发级联
+    for (int round = 0; round < ASYNC_TEST_ROUNDS; round++) {
+        action_rule_t rule;
+        memset(&rule, 0, sizeof(rule));
+        for (int id = 1; id <= ASYNC_TEST_DEVICES; id++) {
+            uint32_t addr = (round == ASYNC_TEST_ROUNDS - 1) ? 0x40 : 0x20;
+            action_target_t target = { ACTION_TYPE_WRITE, DEVICE_TYPE_OPTICAL_MODULE, id, addr, (uint32_t)round, 0, NULL, NULL, NULL };
+            action_target_add_to_array(&rule.targets, &target);
+        }
+        CHECK(action_manager_execute_rule(am, &rule, dm) == 0);
+    }
+
+    // flush等待包括级联动作在内的全部动作
+    CHECK(action_manager_flush(am) == 0);
+    for (int id = 1; id <= ASYNC_TEST_DEVICES; id++) {
+        CHECK(g_async_write_count[id] == ASYNC_TEST_ROUNDS + 1);
+        int ordered = 1;
+        for (int i = 0; i < ASYNC_TEST_ROUNDS; i++) {
+            if (g_async_writes[id][i] != (uint32_t)i) ordered = 0;
+        }
+        CHECK(ordered && g_async_writes[id][ASYNC_TEST_ROUNDS] == 0xFFFF);
+    }
+    CHECK(g_async_overlap == 0);
+
+    // 工作线程解析的目标设备写回提交者的绑定单元
+    action_binding_t binding;
+    memset(&binding, 0, sizeof(binding));
+    action_target_t bound = { ACTION_TYPE_WRITE, DEVICE_TYPE_OPTICAL_MODULE, 1, 0x20, 0, 0, NULL, NULL, NULL };
+    action_firing_t firing;
+    memset(&firing, 0, sizeof(firing));
+    firing.name = "异步绑定测试";
+    firing.targets = &bound;
+    firing.target_count = 1;
+    firing.bindings = &binding;
+    CHECK(action_manager_submit_firing(am, &firing, dm) == 0);
+    CHECK(action_manager_flush(am) == 0);
+    CHECK(binding.device == device_get(dm, DEVICE_TYPE_OPTICAL_MODULE, 1) && binding.generation != 0);
+    // 队列清空的strand已经释放
+    CHECK(action_dispatcher_strand_count(am->dispatcher) == 0);
+
+    // 销毁回调等待工作线程时不持有类型锁，按地址查找的动作可以完成
+    g_async_destroy_flushed = 0;
+    device_destroy(dm, DEVICE_TYPE_OPTICAL_MODULE, ASYNC_TEST_DEVICES);
+    CHECK(g_async_destroy_flushed == 1);
+    CHECK(device_get(dm, DEVICE_TYPE_OPTICAL_MODULE, ASYNC_TEST_DEVICES) == NULL);
+
+    action_manager_stop_async(am);
+    CHECK(am->dispatcher == NULL);
+    for (int id = 1; id < ASYNC_TEST_DEVICES; id++) {
+        device_destroy(dm, DEVICE_TYPE_OPTICAL_MODULE, id);
+    }
+}
+
+// 记录写入事件观察函数收到的事件
+static write_event_t g_tap_events[8];
+static int g_tap_count = 0;
+static int g_tap_entered = 0;
+static int g_tap_release = 0;
+
+// 写入事件观察函数：第一个事件阻塞到测试放行，用来填满队列
+static void events_test_tap(const write_event_t* event, void* context) {
+    (void)context;
+    if (g_tap_count < 8) {
+        g_tap_events[g_tap_count] = *event;
+    }
+    g_tap_count++;
+    __atomic_store_n(&g_tap_entered, 1, __ATOMIC_RELEASE);
+    while (!__atomic_load_n(&g_tap_release, __ATOMIC_ACQUIRE)) {
+        usleep(100);
+    }
+}
+
+// 测试写入事件队列
+static void test_write_events(void) {
+    printf("测试写入事件队列...\n");
+    const memory_region_t regions[] = {
+        { .base_addr = 0x00, .unit_size = 4, .length = 16 },
+    };
+    device_memory_t* mem = device_memory_create(regions, 1, NULL, DEVICE_TYPE_I2C_BUS, 3);
+    CHECK(mem != NULL);
+    if (!mem) return;
+
+    write_event_queue_stats_t stats;
+    CHECK(device_memory_events_stats(&stats) == -1);
+    CHECK(device_memory_events_start(4, events_test_tap, NULL) == 0);
+
+    // 消费者阻塞在第一个事件上，随后4个事件填满队列，第6次写入溢出后同步检查规则
+    CHECK(device_memory_write(mem, 0x00, 0x11) == 0);
+    while (!__atomic_load_n(&g_tap_entered, __ATOMIC_ACQUIRE)) {
+        usleep(100);
+    }
+    for (uint32_t i = 1; i <= 4; i++) {
+        CHECK(device_memory_write(mem, i * 4, 0x11 * (i + 1)) == 0);
+    }
+    CHECK(device_memory_write(mem, 0x00, 0x66) == 0);
+    CHECK(device_memory_events_stats(&stats) == 0);
+    CHECK(stats.capacity == 4 && stats.published == 5 && stats.overflows == 1);
+
+    __atomic_store_n(&g_tap_release, 1, __ATOMIC_RELEASE);
+    CHECK(device_memory_events_flush() == 0);
+    CHECK(g_tap_count == 5);
+    CHECK(device_memory_write_width(mem, 0x02, 2, 0xABCD) == 0);
+    CHECK(device_memory_events_flush() == 0);
+    CHECK(g_tap_count == 6);
+    CHECK(g_tap_events[0].device_type == DEVICE_TYPE_I2C_BUS && g_tap_events[0].device_id == 3);
+    CHECK(g_tap_events[0].addr == 0x00 && g_tap_events[0].old_value == 0 && g_tap_events[0].new_value == 0x11);
+    CHECK(g_tap_events[4].addr == 0x10 && g_tap_events[4].new_value == 0x55);
+    // 溢出的写入不产生事件，之后的事件看到它写入的值
+    CHECK(g_tap_events[5].addr == 0x02 && g_tap_events[5].width == 2 && 
+          g_tap_events[5].old_value == 0 && g_tap_events[5].new_value == 0xABCD);
+
+    CHECK(device_memory_events_stats(&stats) == 0);
+    CHECK(stats.published == 6 && stats.consumed == 6 && stats.high_watermark >= 4);
+
+    device_memory_events_stop();
+    CHECK(device_memory_events_stats(&stats) == -1);
+    device_memory_destroy(mem);
+}
+
+// 测试写入事件按事件记录的值检查规则：消费者处理事件前触发字已被覆盖
+static void test_event_rule_values(void) {
+    printf("测试写入事件的规则检查...\n");
+    int rule_count = 0;
+    const rule_table_entry_t* rules = get_device_rules(DEVICE_TYPE_FLASH, &rule_count);
+    CHECK(rules != NULL && rule_count > 0 && rules[0].trigger.trigger_addr == 0);
+    if (!rules || rule_count <= 0 || rules[0].trigger.trigger_addr != 0) return;
+    uint32_t expected = rules[0].trigger.expected_value;
+    uint32_t mask = rules[0].trigger.expected_mask;
+
+    const memory_region_t regions[] = { { .base_addr = 0x00, .unit_size = 4, .length = 16 } };
+    device_memory_t* mem = device_memory_create(regions, 1, NULL, DEVICE_TYPE_FLASH, 81);
+    CHECK(mem != NULL);
+    if (!mem) return;
+
+    g_tap_count = 0;
+    g_tap_entered = 0;
+    g_tap_release = 0;
+    CHECK(device_memory_events_start(16, events_test_tap, NULL) == 0);
+    uint64_t fired = rule_firings();
+    CHECK(device_memory_write(mem, 0x00, ~expected & mask) == 0);
+    while (!__atomic_load_n(&g_tap_entered, __ATOMIC_ACQUIRE)) {
+        usleep(100);
+    }
+    // 满足条件的写入在处理前被覆盖，仍按它写入的值触发一次
+    CHECK(device_memory_write(mem, 0x00, expected) == 0);
+    CHECK(device_memory_write(mem, 0x00, ~expected & mask) == 0);
+    __atomic_store_n(&g_tap_release, 1, __ATOMIC_RELEASE);
+    CHECK(device_memory_events_flush() == 0);
+    CHECK(g_tap_count == 3);
+    CHECK(rule_firings() == fired + 1);
+
+    device_memory_events_stop();
+    device_memory_destroy(mem);
+}
+
+#define ATOMIC_TEST_THREADS     4
+#define ATOMIC_TEST_ITERATIONS  20000
+
+// 无锁计数线程：CAS循环递增计数寄存器
+static void* atomic_counter_thread(void* arg) {
+    device_memory_t* mem = (device_memory_t*)arg;
+    for (int i = 0; i < ATOMIC_TEST_ITERATIONS; i++) {
+        uint32_t expected = 0;
+        device_memory_atomic_load32(mem, 0x04, &expected);
+        while (device_memory_atomic_cas32(mem, 0x04, &expected, expected + 1) == 1) {
+        }
+    }
+    return NULL;
+}
+
+#define GRACE_TEST_SWAPS  200
+
+// 按插件快速路径的方式发布的设备内存
+static device_memory_t* g_grace_memory = NULL;
+static device_memory_grace_t g_grace;
+static volatile int g_grace_done = 0;
+static int g_grace_bad = 0;
+
+// 无锁读者：宽限期内加载内存指针并读取寄存器（每块内存的寄存器值都是0x5A）
+static void* grace_reader_thread(void* arg) {
+    (void)arg;
+    while (!__atomic_load_n(&g_grace_done, __ATOMIC_ACQUIRE)) {
+        uint32_t value = 0;
+        int token = device_memory_grace_enter(&g_grace);
+        device_memory_t* mem = __atomic_load_n(&g_grace_memory, __ATOMIC_ACQUIRE);
+        if (device_memory_atomic_load32(mem, 0x00, &value) != 0 || value != 0x5A) {
+            __atomic_store_n(&g_grace_bad, 1, __ATOMIC_RELAXED);
+        }
+        device_memory_grace_exit(&g_grace, token);
+    }
+    return NULL;
+}
+
+// 测试无锁寄存器访问
+static void test_lockfree_registers(void) {
+    printf("测试无锁寄存器访问...\n");
+    const memory_region_t regions[] = {
+        { .base_addr = 0x00, .unit_size = 4, .length = 8, .flags = MEMORY_REGION_LOCKFREE },
+        { .base_addr = 0x100, .unit_size = 4, .length = 8 },
+    };
+    device_memory_t* mem = device_memory_create(regions, 2, NULL, 0, 0);
+    CHECK(mem != NULL);
+    if (!mem) return;
+
+    uint32_t value = 0, old = 0;
+    CHECK(device_memory_atomic_store32(mem, 0x00, 0x04) == 0);
+    CHECK(device_memory_atomic_fetch_or32(mem, 0x00, 0x10, &old) == 0 && old == 0x04);
+    CHECK(device_memory_atomic_fetch_and32(mem, 0x00, ~0x04u, &old) == 0 && old == 0x14);
+    CHECK(device_memory_atomic_load32(mem, 0x00, &value) == 0 && value == 0x10);
+    CHECK(device_memory_read(mem, 0x00, &value) == 0 && value == 0x10);
+
+    uint32_t expected = 0;
+    CHECK(device_memory_atomic_cas32(mem, 0x00, &expected, 1) == 1 && expected == 0x10);
+    CHECK(device_memory_atomic_cas32(mem, 0x00, &expected, 1) == 0);
+
+    // 不满足条件时返回-1，调用者回退到加锁路径
+    CHECK(device_memory_atomic_load32(mem, 0x02, &value) == -1);    // 未对齐
+    CHECK(device_memory_atomic_load32(mem, 0x100, &value) == -1);   // 非无锁区域
+    CHECK(device_memory_atomic_load32(mem, 0x80, &value) == -1);    // 空洞
+
+    // 无锁写入同样标记脏页
+    CHECK(device_memory_fetch_clear_dirty(mem, 0, NULL, 0) == 1);
+
+    // 多线程CAS递增不丢失更新
+    pthread_t threads[ATOMIC_TEST_THREADS];
+    for (int i = 0; i < ATOMIC_TEST_THREADS; i++) {
+        pthread_create(&threads[i], NULL, atomic_counter_thread, mem);
+    }
+    for (int i = 0; i < ATOMIC_TEST_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    CHECK(device_memory_atomic_load32(mem, 0x04, &value) == 0 && 
+          value == ATOMIC_TEST_THREADS * ATOMIC_TEST_ITERATIONS);
+
+    // 替换内存后等待宽限期再销毁，无锁读者不会访问已释放的内存
+    CHECK(device_memory_atomic_store32(mem, 0x00, 0x5A) == 0);
+    g_grace_memory = mem;
+    memset(&g_grace, 0, sizeof(g_grace));
+    g_grace_done = 0;
+    for (int i = 0; i < ATOMIC_TEST_THREADS; i++) {
+        pthread_create(&threads[i], NULL, grace_reader_thread, NULL);
+    }
+    for (int round = 0; round < GRACE_TEST_SWAPS; round++) {
+        device_memory_t* next = device_memory_create(regions, 2, NULL, 0, 0);
+        CHECK(next != NULL);
+        if (!next) break;
+        device_memory_atomic_store32(next, 0x00, 0x5A);
+        device_memory_t* old_memory = g_grace_memory;
+        __atomic_store_n(&g_grace_memory, next, __ATOMIC_RELEASE);
+        device_memory_grace_wait(&g_grace);
+        device_memory_destroy(old_memory);
+    }
+    __atomic_store_n(&g_grace_done, 1, __ATOMIC_RELEASE);
+    for (int i = 0; i < ATOMIC_TEST_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    CHECK(g_grace_bad == 0);
+    device_memory_destroy(g_grace_memory);
+}
+
+#define SEQLOCK_TEST_READERS     2
+#define SEQLOCK_TEST_ITERATIONS  20000
+
+static volatile int g_seqlock_done = 0;
+static int g_seqlock_torn = 0;
+
+// 一致性写入线程：状态寄存器为n，数据寄存器为~n
+static void* seqlock_writer_thread(void* arg) {
+    device_memory_t* mem = (device_memory_t*)arg;
+    const uint32_t addrs[2] = { 0x00, 0x0C };
+    for (uint32_t n = 1; n <= SEQLOCK_TEST_ITERATIONS; n++) {
+        const uint32_t values[2] = { n, ~n };
+        device_memory_write_consistent(mem, addrs, values, 2);
+    }
+    __atomic_store_n(&g_seqlock_done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+// 一致性读取线程：两个寄存器必须始终配对
+static void* seqlock_reader_thread(void* arg) {
+    device_memory_t* mem = (device_memory_t*)arg;
+    const uint32_t addrs[2] = { 0x00, 0x0C };
+    uint32_t values[2];
+    while (!__atomic_load_n(&g_seqlock_done, __ATOMIC_ACQUIRE)) {
+        if (device_memory_read_consistent(mem, addrs, values, 2) != 0 || values[1] != ~values[0]) {
+            __atomic_add_fetch(&g_seqlock_torn, 1, __ATOMIC_RELAXED);
+        }
+    }
+    return NULL;
+}
+
+// 测试顺序锁一致性读取
+static void test_consistent_read(void) {
+    printf("测试一致性多寄存器读取...\n");
+    const memory_region_t regions[] = {
+        { .base_addr = 0x00, .unit_size = 4, .length = 8, .flags = MEMORY_REGION_LOCKFREE },
+        { .base_addr = 0x100, .unit_size = 4, .length = 8, .flags = MEMORY_REGION_SPARSE },
+    };
+    // 使用没有规则表的设备类型，避免并发写入触发规则动作
+    device_memory_t* mem = device_memory_create(regions, 2, NULL, DEVICE_TYPE_I2C_BUS, 0);
+    CHECK(mem != NULL);
+    if (!mem) return;
+
+    const uint32_t addrs[2] = { 0x00, 0x0C };
+    const uint32_t init[2] = { 0, ~0u };
+    uint32_t values[2] = { 1, 1 };
+    CHECK(device_memory_write_consistent(mem, addrs, init, 2) == 0);
+    CHECK(device_memory_read_consistent(mem, addrs, values, 2) == 0 && values[0] == 0 && values[1] == ~0u);
+
+    // 普通写入同样推进序号
+    CHECK(device_memory_write(mem, 0x0C, 0x1234) == 0);
+    CHECK(device_memory_read_consistent(mem, addrs, values, 2) == 0 && values[1] == 0x1234);
+    CHECK(mem->write_begin == mem->write_end && mem->write_begin == 2);
+
+    // 未对齐、稀疏区域和空洞地址被拒绝，且不写入任何数据
+    const uint32_t bad[3][2] = { { 0x00, 0x02 }, { 0x00, 0x100 }, { 0x00, 0x80 } };
+    for (int i = 0; i < 3; i++) {
+        CHECK(device_memory_read_consistent(mem, bad[i], values, 2) == -1);
+        CHECK(device_memory_write_consistent(mem, bad[i], init, 2) == -1);
+    }
+    CHECK(mem->write_begin == 2);
+
+    // 并发写入时读取者看到的寄存器对始终一致
+    CHECK(device_memory_write_consistent(mem, addrs, init, 2) == 0);
+    g_seqlock_done = 0;
+    g_seqlock_torn = 0;
+    pthread_t writer, readers[SEQLOCK_TEST_READERS];
+    for (int i = 0; i < SEQLOCK_TEST_READERS; i++) {
+        pthread_create(&readers[i], NULL, seqlock_reader_thread, mem);
+    }
+    pthread_create(&writer, NULL, seqlock_writer_thread, mem);
+    pthread_join(writer, NULL);
+    for (int i = 0; i < SEQLOCK_TEST_READERS; i++) {
+        pthread_join(readers[i], NULL);
+    }
+    CHECK(g_seqlock_torn == 0);
+    CHECK(device_memory_read_consistent(mem, addrs, values, 2) == 0 && 
+          values[0] == SEQLOCK_TEST_ITERATIONS && values[1] == ~(uint32_t)SEQLOCK_TEST_ITERATIONS);
+
+    device_memory_destroy(mem);
+}
+
+int main(void) {
+    test_page_table_decode();
+    test_sparse_layout_fallback();
+    test_overlapping_regions();
+    test_sparse_region();
+    test_file_backed_region();
+    test_width_access();
+    test_vectored_io();
+    test_spanning_buffer();
+    test_snapshot_restore();
+    test_dirty_tracking();
+    test_slab_layout();
+    test_memfd_export();
+    test_trigger_bitmap();
+    test_rule_index();
+    test_rule_table_swap();
+    test_deferred_rules();
+    test_rule_cascade();
+    test_target_binding();
+    test_target_pool();
+    test_trigger_modes();
+    test_rule_coalescing();
+    test_async_dispatch();
+    test_write_events();
+    test_event_rule_values();
+    test_lockfree_registers();
+    test_consistent_read();
+    test_range_index();
+    test_range_triggers();
+    test_rule_table_updates();
+    test_deferred_destroy();
+
+    if (g_failures) {
+        printf("设备内存测试失败: %d 项检查未通过\n", g_failures);
+        return 1;
+    }
+    printf("设备内存测试通过\n");
+    return 0;
+}
@@ -142,9 +142,10 @@ int test_temp_sensor_rule_config() {
                tv.tv_sec, tv.tv_usec, i, rule->addr, rule->expected_value, rule->expected_mask);
         
         // 打印规则的目标动作
-        if (rule->targets) {
-            for (int j = 0; j < rule->targets->count; j++) {
-                action_target_t* target = &rule->targets->targets[j];
+        const action_target_t* targets = action_target_pool_get(rule->targets);
+        if (targets) {
+            for (int j = 0; j < (int)rule->targets.count; j++) {
+                const action_target_t* target = &targets[j];
                 printf("[%ld.%06d]   目标[%d]: 类型=%d, 设备类型=%d, 设备ID=%d, 地址=0x%08X, 值=0x%08X\n",
                        tv.tv_sec, tv.tv_usec, j, target->type, target->device_type, 
                        target->device_id, target->target_addr, target->target_value);
@@ -199,8 +200,8 @@ int test_temp_sensor_rule_config() {
     uint32_t target_addr = 0;
     uint32_t expected_value = 0;
     
-    if (test_rule->targets && test_rule->targets->count > 0) {
-        action_target_t* target = &test_rule->targets->targets[0];
+    const action_target_t* target = action_target_pool_get(test_rule->targets);
+    if (target) {
         target_addr = target->target_addr;
         expected_value = target->target_value;
     }